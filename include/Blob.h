@@ -2,35 +2,63 @@
 #define BLOB_H
 
 #include<string>
+#include<utility>
+#include<vector>
+#include"ObjectId.h"
+
+class ObjectStore;
 
 class Blob{
 private:
-    std::string id;         // SHA1码
+    ObjectId id;            // SHA1码
     std::string content;    // 文件内容
 public:
     //通过文件内容构造blob对象
     explicit Blob(const std::string& content);
 
     //通过文件内容和id构造blob对象
-    Blob(const std::string& id,const std::string& content);
+    Blob(const ObjectId& id,std::string content);
 
     //获取blob的id
-    std::string getId() const;
+    ObjectId getId() const;
 
     //获取blob的内容
-    std::string getContent() const;
+    const std::string& getContent() const;
+
+    //将blob写入对象库
+    void write(const ObjectStore& store) const;
 
-    //将blob写入objects目录
-    void write(const std::string& path) const;
+    //从对象库读取blob
+    static Blob load(const ObjectStore& store,const ObjectId& id);
 
-    //从objects目录读取blob
-    static Blob load(const std::string& path,const std::string& id);
+    //创建blob对象并写入对象库
+    static Blob create(const ObjectStore& store,const std::string& content);
 
-    //创建blob对象并写入objects目录
-    static Blob create(const std::string& path,const std::string& content);
+    //从文件流式创建blob并写入对象库，返回blob id；内存占用与文件大小无关
+    static ObjectId createFromFile(const ObjectStore& store,const std::string& filepath);
 
     //获取blob的sha1码
-    static std::string generateId(const std::string& content);
+    static ObjectId generateId(const std::string& content);
+
+    //直接从文件流式计算blob的sha1码，不把整个文件读进内存
+    static ObjectId generateIdFromFile(const std::string& filepath);
+
+    // 大文件分块存储：blob id仍然是整个内容的sha1，对象库里这个id下存的是块清单，
+    // 每个块按自己内容的sha1作为独立的blob对象存放，相同的块只存一份
+    // 块清单: "GLCHUNKS" 块数(varint) | 每块: id(20) 长度(varint)
+    static const size_t CHUNK_THRESHOLD=1024*1024;
+
+    //判断对象库中id下存的数据是不是块清单（以magic开头且内容的sha1不等于id）
+    static bool isChunkList(const ObjectId& id,const std::string& data);
+    static std::vector<std::pair<ObjectId,size_t>> parseChunkList(const std::string& data);
+    //blob引用的块ID，没有分块时为空；只读对象开头判断，不读整个内容
+    static std::vector<ObjectId> chunkIds(const ObjectStore& store,const ObjectId& id);
+
+    //把blob内容写到工作区文件，分块的blob逐块写出，不拼出整个内容
+    static void writeToFile(const ObjectStore& store,const ObjectId& id,const std::string& filepath);
+
+    //把blob从一个对象库复制到另一个，分块的blob只复制目标中缺少的块
+    static void copyObject(const ObjectStore& from,const ObjectStore& to,const ObjectId& id);
 };
 
-#endif // BLOB_H
\ No newline at end of file
+#endif // BLOB_H
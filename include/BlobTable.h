@@ -0,0 +1,43 @@
+#ifndef BLOB_TABLE_H
+#define BLOB_TABLE_H
+
+#include<map>
+#include<string>
+#include<string_view>
+#include<utility>
+#include<vector>
+#include"ObjectId.h"
+
+// commit里的文件表：按文件名排好序的(文件名, blob id)数组，查找用二分
+// 只读接口和std::map一致（begin/end/find/count/size），遍历时元素也是std::pair，
+// 解析commit时只需要一次reserve，不用为每个文件分配一个树节点
+class BlobTable{
+public:
+    using Entry=std::pair<std::string,ObjectId>;
+    using const_iterator=std::vector<Entry>::const_iterator;
+
+private:
+    std::vector<Entry> entries;
+
+public:
+    BlobTable()=default;
+    //从map构造（已经有序）；允许隐式转换，构造commit时可以直接传map
+    BlobTable(const std::map<std::string,ObjectId>& blobs);
+    //从任意顺序的条目构造，文件名重复时保留第一个
+    explicit BlobTable(std::vector<Entry> unsorted);
+
+    const_iterator begin() const {return entries.begin();}
+    const_iterator end() const {return entries.end();}
+    size_t size() const {return entries.size();}
+    bool empty() const {return entries.empty();}
+
+    const_iterator find(std::string_view name) const;
+    size_t count(std::string_view name) const {return find(name)!=end()?1:0;}
+    //文件对应的blob id，不存在时返回空ID
+    ObjectId lookup(std::string_view name) const;
+
+    //需要增删文件时（commit、merge）转成map再改
+    std::map<std::string,ObjectId> toMap() const;
+};
+
+#endif // BLOB_TABLE_H
@@ -3,6 +3,7 @@
 
 #include<string>
 #include<set>
+#include"ObjectId.h"
 
 class RepositoryCore;
 
@@ -11,7 +12,7 @@ private:
     RepositoryCore* core;
 
     std::set<std::string> getAllBranches();
-    std::string findSplitPoint(const std::string& branch1,const std::string& branch2);
+    ObjectId findSplitPoint(const ObjectId& branch1,const ObjectId& branch2);
 
 public:
     BranchManager(RepositoryCore* repoCore);
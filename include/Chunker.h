@@ -0,0 +1,22 @@
+#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+// 基于内容的分块（FastCDC）：用gear滚动哈希找切分点，
+// 文件中间插入或删除内容只会影响附近一两个块，其余块的ID不变可以去重
+namespace Chunker {
+    const size_t MIN_SIZE=64*1024;      // 最小块，前MIN_SIZE字节不判断切分点
+    const size_t AVG_SIZE=256*1024;     // 期望的平均块大小
+    const size_t MAX_SIZE=1024*1024;    // 最大块，到这里强制切分
+
+    //返回从data开始的第一个块的长度（不超过length）
+    size_t nextBoundary(const uint8_t* data,size_t length);
+
+    //把整段数据切成块，返回每块的长度
+    std::vector<size_t> split(const uint8_t* data,size_t length);
+}
+
+#endif // CHUNKER_H
@@ -4,50 +4,106 @@
 #include<cstring>
 #include<ctime>
 #include<map>
+#include<memory>
 #include<vector>
 #include<sstream>
+#include<string_view>
 #include<unistd.h>
+#include"BlobTable.h"
+#include"ObjectId.h"
 
+class ObjectStore;
+
+// commit对象的存储格式（二进制）：
+//   "\0GLC" 版本(1) | 时间(8) | 父commit数(varint) 父id(20)... | 信息长度(varint) 信息 |
+//   merge信息长度(varint) merge信息 | 版本1: 文件表 / 版本2: 根tree的id(20)
+// 版本1的文件表: 文件数(varint) | 条目: 文件名偏移(4) blob id(20)... | 文件名区
+// 整数均为大端。条目按文件名排序、定长，文件名依次拼在最后，第i个文件名到第i+1个的偏移为止，
+// 可以直接在数据上二分查找；文件名里可以有任何字符
+// 新commit用版本2，只引用根目录的tree（见Tree），没有改动的子树和上一个commit共用；
+// 版本1的commit（包括初始commit）和旧版本写入的文本格式（"Message:..."开头，每个字段一行）仍然可以读取
+//
+// 从对象库load时只解析头部（时间、父commit、信息），文件表留在原始数据里，第一次getBlobs时才解码；
+// log、找分割点、远程同步这类只看父commit的遍历不会构造文件表。getBlobId不解码整个表：
+// 版本1直接在原始数据上二分，版本2沿路径读出几个tree。解码会改动内部状态，同一个对象不能在多个线程里同时用
 class Commit {
 private:
-    std::string id;                           // 提交的信息
+    ObjectId id;                              // 提交的信息
     std::string message;                      // 提交信息  
     std::time_t timestamp;                    // 提交的时间戳
-    std::vector<std::string> parents;         // 父提交的ID列表
-    std::map<std::string, std::string> blobs; // 存储文件名到blob id的映射
+    std::vector<ObjectId> parents;            // 父提交的ID列表
+    mutable BlobTable blobs;                  // 按文件名排序的文件名到blob id的映射，按需解码
+    ObjectId tree;                            // 根目录的tree，版本1的commit为空
     std::string merge_info;                   // merge commit的额外信息
 
+    // 还没解码的文件表在哪里
+    enum TableSource : uint8_t { TABLE_READY=0,TABLE_BINARY=1,TABLE_TEXT=2,TABLE_TREE=3 };
+    mutable TableSource table_source;
+    mutable std::shared_ptr<const std::string> raw;  // 原始数据，TABLE_BINARY/TABLE_TEXT时文件表从table_pos开始
+    size_t table_pos;
+    const ObjectStore* store;                 // TABLE_TREE时从这里展开tree
+
     //辅助函数
-    static std::string generateId(const std::string& message, 
-                                 const std::time_t& timestamp,
-                                 const std::vector<std::string>& parents,
-                                 const std::map<std::string, std::string>& blobs);
+    static ObjectId generateId(const std::string& message, 
+                               const std::time_t& timestamp,
+                               const std::vector<ObjectId>& parents,
+                               const BlobTable& blobs);
+    static ObjectId generateId(const std::string& message,
+                               const std::time_t& timestamp,
+                               const std::vector<ObjectId>& parents,
+                               const ObjectId& tree);
     static std::string timeToString(const std::time_t& timestamp);
     static std::time_t stringToTime(const std::string& timeStr);
+
+    //knownId非空时（按id从对象库读出）直接用作commit id，不再对所有字段重新计算哈希，文件表也留到用时再解码
+    static Commit deserializeBinary(std::shared_ptr<const std::string> data,const ObjectId* knownId);
+    static Commit deserializeText(std::shared_ptr<const std::string> data,const ObjectId* knownId);
+    static BlobTable decodeBinaryTable(std::string_view data,size_t pos);
+    static BlobTable decodeTextTable(std::string_view line);
+    static ObjectId findInBinaryTable(std::string_view data,size_t pos,std::string_view filename);
 public:
+    static const char BINARY_MAGIC[4];
+    static const uint8_t FORMAT_VERSION=1;          // 内嵌文件表
+    static const uint8_t TREE_FORMAT_VERSION=2;     // 引用根tree
+
     Commit();
     Commit(const std::string& message, const std::time_t& timestamp, 
-           const std::vector<std::string>& parents,
-           const std::map<std::string, std::string>& blobs);
+           const std::vector<ObjectId>& parents,
+           BlobTable blobs);
+    //引用根tree的commit；这样构造出来的对象不带展开的文件表，需要时从对象库load
+    Commit(const std::string& message, const std::time_t& timestamp,
+           const std::vector<ObjectId>& parents,
+           const ObjectId& tree);
     
     //获取器
-    std::string getId() const;
+    ObjectId getId() const;
     std::string getMessage() const;
     std::time_t getTimestamp() const;
-    std::vector<std::string> getParents() const;
-    std::map<std::string, std::string> getBlobs() const;
+    const std::vector<ObjectId>& getParents() const;
+    const BlobTable& getBlobs() const;
+    const ObjectId& getTree() const;
     std::string getMergeInfo() const;
 
+    //查找某个文件的blob id，不存在时返回空ID
+    ObjectId getBlobId(const std::string& filename) const;
+
     //把merge信息给到这个commit
     void setMergeInfo(const std::string& info);
 
-    //序列化与反序列化
+    //序列化与反序列化：写出二进制格式，读取时两种格式都接受
     std::string serialize() const;
-    static Commit deserialize(const std::string& data);
+    //不访问对象库，版本2的commit只有tree、没有展开的文件表
+    static Commit deserialize(std::string_view data);
+    static Commit deserialize(std::string&& data);
+    //数据是否是commit（二进制或旧文本格式的开头），不做完整校验
+    static bool isCommitData(std::string_view data);
     static Commit fromFile(const std::string& filename);
+    //从对象库读取，只解析头部；版本2的commit在getBlobs时从store展开tree，store要比commit活得久
+    static Commit load(const ObjectStore& store,const ObjectId& id);
 
     //部分辅助函数
     std::string getFormattedTimestamp() const;
+    static std::string formatTimestamp(std::time_t timestamp);
     bool isMergeCommit() const;
     std::string getShortId() const;
 };
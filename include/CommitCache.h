@@ -0,0 +1,41 @@
+#ifndef COMMIT_CACHE_H
+#define COMMIT_CACHE_H
+
+#include<cstddef>
+#include<list>
+#include<memory>
+#include<unordered_map>
+#include"Commit.h"
+#include"ObjectId.h"
+
+class ObjectStore;
+
+// 解析好的commit的LRU缓存，同一条命令里反复访问的commit只解析一次
+// 缓存的commit以shared_ptr<const Commit>交出，被淘汰后调用方手里的仍然有效
+class CommitCache{
+private:
+    typedef std::pair<ObjectId,std::shared_ptr<const Commit>> Entry;
+
+    const ObjectStore& store;
+    size_t capacity;
+    std::list<Entry> entries;   // 最近使用的在前
+    std::unordered_map<ObjectId,std::list<Entry>::iterator> entry_map;
+    size_t hits;
+    size_t misses;
+
+public:
+    static const size_t DEFAULT_CAPACITY=1024;
+
+    explicit CommitCache(const ObjectStore& objectStore,size_t capacity=DEFAULT_CAPACITY);
+
+    //取commit，不在缓存里时从对象库加载；commit不存在时抛出GitliteException
+    std::shared_ptr<const Commit> get(const ObjectId& id);
+
+    //对象库被改动（比如gc）后清空
+    void clear();
+
+    size_t getHits() const {return hits;}
+    size_t getMisses() const {return misses;}
+};
+
+#endif // COMMIT_CACHE_H
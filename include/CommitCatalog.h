@@ -0,0 +1,85 @@
+#ifndef COMMIT_CATALOG_H
+#define COMMIT_CATALOG_H
+
+#include<cstdint>
+#include<ctime>
+#include<functional>
+#include<memory>
+#include<string>
+#include<string_view>
+#include<unordered_set>
+#include<vector>
+#include"MappedFile.h"
+#include"MessageIndex.h"
+#include"ObjectId.h"
+
+class Commit;
+class ObjectStore;
+
+// commit目录：只追加的commit清单，global-log和find直接顺序读它，不用把每个对象都当commit解析一遍
+//
+// commit-catalog:  "GLCCAT1\n" | 每个commit一条定长记录:
+//                  id(20) 时间(8) 父commit(20) 第二父commit(20) 信息偏移(8) 信息长度(4)
+// commit-messages: 提交信息依次拼接，每条后面跟一个换行
+// 整数均为大端，没有的父commit记为全0。先写信息再写记录，末尾不完整的记录读取时忽略
+class CommitCatalog{
+private:
+    const ObjectStore& store;   // 重建目录时扫描的对象库
+    std::string catalog_file;
+    std::string messages_file;
+    MessageIndex message_index; // 提交信息索引，随目录一起追加和重建
+
+    //用临时文件换掉目录和信息文件，再重建信息索引（序号变了），返回commit数
+    size_t install(const std::string& records,const std::string& messages);
+
+public:
+    static const size_t RECORD_SIZE=2*8+4+3*ObjectId::RAW_LENGTH;
+
+    struct Entry{
+        ObjectId id;
+        std::time_t timestamp;
+        ObjectId parents[2];
+        std::string_view message;   // 指向映射的信息文件，只在遍历回调里有效
+
+        bool isMergeCommit() const {return !parents[1].isNull();}
+    };
+
+    // find的匹配方式
+    enum MatchMode { MATCH_EXACT,MATCH_TOKENS,MATCH_SUBSTRING };
+
+    // 映射目录和信息文件，按序号随机访问
+    class Reader{
+    private:
+        MappedFile catalog;
+        std::unique_ptr<MappedFile> messages;
+        size_t count;
+    public:
+        explicit Reader(const CommitCatalog& owner);
+        size_t size() const {return count;}
+        //第i条记录；信息没写完整的记录（写入中途失败）id为空
+        Entry at(size_t i) const;
+    };
+
+    CommitCatalog(const std::string& gitliteDir,const ObjectStore& objectStore);
+
+    //目录文件是否存在（旧仓库第一次使用时需要rebuild）
+    bool exists() const;
+
+    //追加一个新写入的commit；目录尚未建立时什么也不做，等第一次使用时整体重建
+    void append(const Commit& commit);
+
+    //扫描对象库重建目录和信息索引，只收录重新计算ID能对上的真正的commit，按时间排列，返回commit数
+    //每个对象先只读开头几个字节判断像不像commit，blob不会被整个解压
+    size_t rebuild();
+
+    //从目录中去掉这些commit（gc删除对象之后），其余记录保持原来的顺序，不重新扫描对象库；返回剩下的commit数
+    size_t remove(const std::unordered_set<ObjectId>& ids);
+
+    //按写入顺序遍历所有commit，目录不存在时先重建
+    void forEach(const std::function<void(const Entry&)>& visit);
+
+    //按提交信息查找commit，结果按目录顺序排列；候选由信息索引给出，再用原文核对
+    std::vector<ObjectId> find(const std::string& query,MatchMode mode);
+};
+
+#endif // COMMIT_CATALOG_H
@@ -0,0 +1,76 @@
+#ifndef COMMIT_GRAPH_H
+#define COMMIT_GRAPH_H
+
+#include<cstdint>
+#include<ctime>
+#include<memory>
+#include<string>
+#include<unordered_map>
+#include<vector>
+#include"ObjectId.h"
+
+class Commit;
+class CommitCatalog;
+class MappedFile;
+
+// commit图：每个commit的父commit、时间和世代号，merge-base和祖先判断只查这张表，不用逐个读出commit对象
+//
+// commit-graph:     "GLCGRPH1" commit数(4) fanout[256](4) | 按id排序: id(20)... |
+//                   同样顺序的记录: 父commit序号(4) 第二父commit序号(4) 世代号(4) 时间(8)...
+// commit-graph.log: 记录: id(20) 父commit(20) 第二父commit(20) 世代号(4) 时间(8)（追加写入）
+// 整数均为大端，没有的父commit序号为NONE、id为全0。世代号：没有父commit时为1，否则为父commit世代号的最大值加1，
+// 祖先的世代号总是小于后代，按世代号从大到小遍历时可以提前停止
+// 和前缀索引一样分两层：新commit先追加到日志，日志超过COMPACT_THRESHOLD条后从commit目录整体重建
+class CommitGraph{
+private:
+    CommitCatalog& catalog;     // 重建时的数据来源
+    std::string graph_file;
+    std::string log_file;
+
+    struct Node{
+        uint32_t parents[2];
+        uint32_t generation;
+        std::time_t timestamp;
+    };
+
+    // 查询时主文件只映射一次；节点序号: 主文件的在前，日志里的接在后面
+    mutable std::unique_ptr<MappedFile> mapped;
+    mutable uint32_t count;
+    mutable bool loaded;
+    mutable std::vector<ObjectId> log_ids;
+    mutable std::vector<Node> log_nodes;
+    mutable std::unordered_map<ObjectId,uint32_t> log_map;
+
+    bool load() const;
+    void unload() const;
+    uint32_t find(const ObjectId& id) const;
+    Node node(uint32_t index) const;
+    ObjectId idAt(uint32_t index) const;
+    //查不到时重建一次再查；仍然查不到抛出GitliteException
+    uint32_t require(const ObjectId& id);
+
+public:
+    static const uint32_t NONE=0xFFFFFFFF;
+    static const size_t RECORD_SIZE=4+4+4+8;
+    static const size_t LOG_RECORD_SIZE=3*ObjectId::RAW_LENGTH+4+8;
+    static const size_t COMPACT_THRESHOLD=1024;
+
+    CommitGraph(const std::string& gitliteDir,CommitCatalog& commitCatalog);
+    ~CommitGraph();
+
+    bool exists() const;
+
+    //追加一个新写入的commit；图尚未建立时什么也不做，父commit不在图里时删掉图，等下次查询时重建
+    void append(const Commit& commit);
+
+    //按commit目录重建，返回commit数
+    size_t rebuild();
+
+    //最近的公共祖先（merge-base），没有公共祖先时返回空ID
+    ObjectId mergeBase(const ObjectId& a,const ObjectId& b);
+
+    //ancestor是否是descendant自己或它的祖先
+    bool isAncestor(const ObjectId& ancestor,const ObjectId& descendant);
+};
+
+#endif // COMMIT_GRAPH_H
@@ -4,7 +4,10 @@
 #include<string>
 #include<vector>
 #include<map>
+#include<memory>
 #include"Commit.h"
+#include"CommitCatalog.h"
+#include"ObjectId.h"
 
 class RepositoryCore;
 
@@ -17,24 +20,28 @@ public:
     // 提交
     void commit(const std::string& message);    
     void saveCommit(const Commit& commit);
-    Commit getCommit(const std::string& commitId);
+    std::shared_ptr<const Commit> getCommit(const ObjectId& commitId);
+    //在baseCommitId的文件上应用改动（文件名到blob id，空id表示删除），返回新commit的根tree
+    //只重写改动路径上的tree；base是没有tree的旧commit时按它的完整文件表建一次
+    ObjectId buildTree(const ObjectId& baseCommitId,const std::map<std::string,ObjectId>& changes);
 
     //日志和查找
     void log();
     void globalLog();
-    void find(const std::string& commitMessage);
+    void find(const std::string& query,CommitCatalog::MatchMode mode=CommitCatalog::MATCH_EXACT);
 
     //辅助函数
-    std::string getFileBlobId(const std::string& filename,const std::string& commitId);
-    bool fileExistsInCommit(const std::string& filename,const std::string& commitId);
-    void copyFileFromCommit(const std::string& filename,const std::string& commitId);
-    std::map<std::string, std::string> getTrackedFiles(const std::string& commitId);
-    std::string getFullCommitId(const std::string& shortId);
+    ObjectId getFileBlobId(const std::string& filename,const ObjectId& commitId);
+    bool fileExistsInCommit(const std::string& filename,const ObjectId& commitId);
+    void copyFileFromCommit(const std::string& filename,const ObjectId& commitId);
+    BlobTable getTrackedFiles(const ObjectId& commitId);
+    //把用户输入的（可能是缩写的）id解析为完整ID，找不到时返回空ID
+    ObjectId getFullCommitId(const std::string& shortId);
 
     //当前提交
-    std::string getCurrentCommitId();
-    Commit getHeadCommit();
-    std::vector<std::string> getFiles(const std::string& commitId);
+    ObjectId getCurrentCommitId();
+    std::shared_ptr<const Commit> getHeadCommit();
+    std::vector<std::string> getFiles(const ObjectId& commitId);
 
     //重置
     void reset(const std::string& commitId);
@@ -0,0 +1,32 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include<cstddef>
+#include<string>
+#include<string_view>
+
+// 对象压缩，使用LZ4块格式（仓库内自带实现，不依赖外部库）
+//
+// 数据按FRAME_SIZE切成互相独立的帧，每帧: 长度标记(varint) 数据
+//   长度标记 = 存储长度<<1 | 是否原样存储
+// 压缩后没有变小的帧原样存储；每帧原始长度由总长度推出，不单独记录
+namespace Compression {
+    const size_t FRAME_SIZE=64*1024;
+
+    //LZ4块压缩，返回压缩后的数据
+    std::string lz4Compress(const char* src,size_t length);
+
+    //LZ4块解压，解出的长度必须正好是dstLength，否则返回false
+    bool lz4Decompress(const char* src,size_t srcLength,char* dst,size_t dstLength);
+
+    //压缩一帧（不超过FRAME_SIZE）追加到out
+    void appendFrame(std::string& out,const char* raw,size_t length);
+
+    //按帧压缩整段数据
+    std::string compressFrames(const std::string& raw);
+
+    //解压从data[pos]开始的帧，总原始长度为rawLength，数据损坏时抛出GitliteException
+    std::string decompressFrames(std::string_view data,size_t pos,size_t rawLength);
+}
+
+#endif // COMPRESSION_H
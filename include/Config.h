@@ -0,0 +1,33 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include<map>
+#include<string>
+
+// 仓库配置（.gitlite/config），每行一个 key=value
+class Config{
+private:
+    std::string config_file;
+    std::map<std::string,std::string> values;
+
+public:
+    explicit Config(const std::string& gitliteDir);
+
+    //重新读取配置文件，文件不存在时为空配置
+    void reload();
+
+    bool has(const std::string& key) const;
+    std::string get(const std::string& key,const std::string& defaultValue="") const;
+
+    //设置并立即写回文件
+    void set(const std::string& key,const std::string& value);
+
+    static bool isKnownKey(const std::string& key);
+    //配置项的默认值，未知配置项返回空串
+    static std::string defaultValue(const std::string& key);
+
+    //检查key是否是支持的配置项、value是否合法，不合法时返回错误信息
+    static std::string validate(const std::string& key,const std::string& value);
+};
+
+#endif // CONFIG_H
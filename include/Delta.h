@@ -0,0 +1,29 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include<cstdint>
+#include<functional>
+#include<string>
+
+// 二进制差量编码，用于pack中相近的blob版本互相引用
+//
+// 格式: 基准长度(varint) 结果长度(varint) 指令...
+//   0x01-0x7f       插入：后面跟着这么多字节的字面数据
+//   0x80 off len    复制：从基准的off处复制len字节（off、len均为varint）
+namespace Delta {
+    // 复制指令的最短长度，也是基准建索引的块大小
+    const size_t BLOCK_SIZE=16;
+
+    //生成把base变成target的差量
+    std::string create(const std::string& base,const std::string& target);
+
+    //把差量应用到base上，差量损坏或与base不匹配时抛出GitliteException
+    std::string apply(const std::string& base,const std::string& delta);
+
+    //只还原结果中从offset开始的length字节（超出结果的部分截掉），不用拿到整个base：
+    //复制指令用到的那段基准由readBase(基准中的偏移, 长度)取得
+    std::string applyRange(const std::string& delta,uint64_t offset,uint64_t length,
+                           const std::function<std::string(uint64_t,uint64_t)>& readBase);
+}
+
+#endif // DELTA_H
@@ -0,0 +1,28 @@
+#ifndef DIRECTORY_WALKER_H
+#define DIRECTORY_WALKER_H
+
+#include<cstddef>
+#include<string>
+#include<vector>
+
+// 递归列出工作区里的全部普通文件
+// 根目录只打开一次，子目录都相对它用openat打开，用getdents64整块读目录项；
+// 每个子目录作为一个任务交给线程池，兄弟子树并行遍历，最后统一排序
+// 符号链接和其他特殊文件不算在内，名为.gitlite的目录整个跳过
+class DirectoryWalker{
+private:
+    size_t threads;
+
+public:
+    //threads为0时使用ThreadPool::defaultThreads()
+    explicit DirectoryWalker(size_t threads=0);
+
+    //root下全部普通文件的路径，按字节序排好；root为"."时是相对路径（"d/e/f"），否则带上"root/"前缀
+    //root不是目录时返回空列表，子目录打不开时跳过
+    std::vector<std::string> walk(const std::string& root) const;
+
+    //用默认线程数遍历
+    static std::vector<std::string> listFiles(const std::string& root);
+};
+
+#endif // DIRECTORY_WALKER_H
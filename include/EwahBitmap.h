@@ -0,0 +1,42 @@
+#ifndef EWAH_BITMAP_H
+#define EWAH_BITMAP_H
+
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<string_view>
+#include<vector>
+
+// EWAH压缩的位图：连续的全0或全1字压成一个游程，其余的字原样保存
+// 压缩后是一串"标记字 + 若干原样字"：
+//   标记字: 第0位为游程的值 | 第1-32位为游程的字数 | 第33-63位为后面跟着的原样字数
+// 可达性位图里同一时期写入的对象大多连在一起，压缩后通常只有原来的一小部分
+// 运算时先解压成普通的字数组，按字做与、或、与非
+class EwahBitmap{
+private:
+    std::vector<uint64_t> words;    // 压缩后的字
+    size_t plain_words;             // 解压后的字数
+
+public:
+    static const uint64_t MAX_RUN=(uint64_t(1)<<32)-1;
+    static const uint64_t MAX_LITERALS=(uint64_t(1)<<31)-1;
+
+    EwahBitmap();
+
+    //压缩一个普通的字数组
+    static EwahBitmap compress(const std::vector<uint64_t>& plain);
+    //解压成普通的字数组
+    std::vector<uint64_t> decompress() const;
+    //把位图按位或到plain上，plain不够长时补0
+    void orInto(std::vector<uint64_t>& plain) const;
+
+    size_t compressedWords() const {return words.size();}
+    size_t plainWords() const {return plain_words;}
+
+    //序列化：解压后字数(varint) 压缩字数(varint) 压缩字(8)...，整数均为大端
+    void serialize(std::string& out) const;
+    //从data的pos处读一个位图，格式不对时抛出GitliteException
+    static EwahBitmap deserialize(std::string_view data,size_t& pos);
+};
+
+#endif // EWAH_BITMAP_H
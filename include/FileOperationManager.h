@@ -4,6 +4,8 @@
 #include<string>
 #include<map>
 #include<set>
+#include<vector>
+#include"ObjectId.h"
 
 class RepositoryCore;
 class CommitManager;
@@ -13,15 +15,18 @@ private:
     RepositoryCore* core;
     CommitManager* commitManager;
 
-    bool isFileModified(const std::string& filename,const std::string& commitId);
+    bool isFileModified(const std::string& filename,const ObjectId& commitId);
     std::map<std::string,std::string> getModifiedFiles();
+    //把add的参数展开为文件列表：目录递归展开，通配符按shell规则匹配；顺带去掉参数上的删除标记
+    std::vector<std::string> expandPaths(const std::vector<std::string>& paths);
 
 public:
     std::set<std::string> getUntrackedFiles();
     FileOperationManager(RepositoryCore* core,CommitManager* commitManager);
 
     //文件操作
-    void add(const std::string& filename);
+    //添加文件、目录或通配符匹配的文件：并行计算哈希和写入对象库，最后只保存一次暂存区
+    void add(const std::vector<std::string>& paths);
     void rm(const std::string& filename);
     void checkoutFile(const std::string& filename);
     void checkoutFileInCommit(const std::string& commitId, const std::string& filename);
@@ -0,0 +1,41 @@
+#ifndef GARBAGE_COLLECTOR_H
+#define GARBAGE_COLLECTOR_H
+
+#include<ctime>
+#include<unordered_set>
+#include<vector>
+#include"ObjectId.h"
+#include"ThreadPool.h"
+
+class ObjectStore;
+
+// 标记-清除式的垃圾回收
+// 标记：从根commit出发按层并行遍历，每层的commit分给线程池解析，收集父commit、根tree和blob，
+//       再按层遍历tree，最后并行检查blob是否分块，把块也标记上
+// 清除：不可达且超过宽限期的对象才删除；松散对象直接删文件，打包的对象要重写pack
+class GarbageCollector{
+private:
+    const ObjectStore& store;
+    ThreadPool pool;
+
+public:
+    struct Plan{
+        std::vector<ObjectId> loose;            // 可以直接删除的松散对象
+        std::unordered_set<ObjectId> packed;    // 在pack里、要重写pack才能删除的对象
+        size_t recent=0;                        // 不可达但还在宽限期内的对象数
+    };
+
+    //threads为0时使用硬件线程数
+    explicit GarbageCollector(const ObjectStore& objectStore,size_t threads=0);
+
+    //标记从commits和blobs可达的全部对象（commit、tree、blob和块）；根或其引用的对象缺失时抛出GitliteException
+    std::unordered_set<ObjectId> mark(const std::vector<ObjectId>& commits,const std::vector<ObjectId>& blobs);
+
+    //找出不可达的对象，最后写入时间不晚于cutoff的才列入清除
+    Plan plan(const std::unordered_set<ObjectId>& reachable,std::time_t cutoff) const;
+
+    //删除plan中的松散对象，并清掉空了的分片目录
+    void removeLoose(const Plan& plan) const;
+};
+
+#endif // GARBAGE_COLLECTOR_H
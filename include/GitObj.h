@@ -9,12 +9,13 @@ private:
 
 public:
     void init();
-    void add(const std::string& filename);
+    void add(const std::vector<std::string>& paths);
     void commit(const std::string& message);
     void rm(const std::string& filename);
     void log();
     void globalLog();
     void find(const std::string& commitMessage);
+    void find(const std::string& option,const std::string& query);
     void checkoutFile(const std::string& filename);
     void checkoutFileInCommit(const std::string& commitId,const std::string& filename);
     void checkoutBranch(const std::string& branchName);
@@ -28,6 +29,13 @@ public:
     void push(const std::string& remoteName,const std::string& remoteBranchName);
     void fetch(const std::string& remoteName,const std::string& remoteBranchName);
     void pull(const std::string& remoteName,const std::string& remoteBranchName);
+    void migrate();
+    void repack();
+    void reindex();
+    void gc(bool dryRun);
+    void fsck();
+    void config(const std::string& key);
+    void config(const std::string& key,const std::string& value);
 };
 
 #endif // GITOBJ_H
\ No newline at end of file
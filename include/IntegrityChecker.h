@@ -0,0 +1,41 @@
+#ifndef INTEGRITY_CHECKER_H
+#define INTEGRITY_CHECKER_H
+
+#include<cstdint>
+#include<map>
+#include<string>
+#include<vector>
+#include"ObjectId.h"
+#include"ThreadPool.h"
+
+class ObjectStore;
+
+// fsck：重新计算每个对象的哈希，并检查commit、tree、块清单和分支引用的对象是否都在
+// 所有对象分给线程池（work stealing，大文件和小commit混在一起也能均匀分摊），每个对象流式读取、边读边算sha1
+// blob和tree的id是内容的sha1；commit的id由各字段算出，按字段重新计算；块清单按顺序读出所有块算整个文件的sha1
+class IntegrityChecker{
+private:
+    const ObjectStore& store;
+    ThreadPool pool;
+
+public:
+    struct Report{
+        size_t objects=0;
+        size_t commits=0;
+        size_t trees=0;
+        size_t blobs=0;
+        uint64_t bytes=0;               // 读出并计算哈希的字节数（包括块清单引用的块）
+        double seconds=0;
+        size_t threads=0;
+        std::vector<std::string> problems;  // 损坏、缺失和类型不对的对象，每条一行
+        std::vector<std::string> dangling;  // 没有被任何分支、暂存区或其他对象引用的对象
+    };
+
+    //threads为0时使用硬件线程数
+    explicit IntegrityChecker(const ObjectStore& objectStore,size_t threads=0);
+
+    //branches为分支名到commit的映射，staged为暂存区里文件名到blob的映射
+    Report check(const std::map<std::string,ObjectId>& branches,const std::map<std::string,ObjectId>& staged);
+};
+
+#endif // INTEGRITY_CHECKER_H
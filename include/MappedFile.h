@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include<cstddef>
+#include<string>
+#include<string_view>
+
+// 只读的文件视图：大文件用mmap映射，零拷贝；小文件直接read进缓冲区，省掉建立映射的开销
+// 内容通过view()取得，视图在MappedFile销毁前一直有效
+class MappedFile{
+private:
+    const char* data_ptr;
+    size_t length;
+    bool mapped;            // data_ptr指向映射区域还是buffer
+    std::string buffer;
+
+    void release();
+
+public:
+    // 读取方式的提示，映射时转成madvise
+    enum Access { SEQUENTIAL,RANDOM };
+
+    static const size_t MMAP_THRESHOLD=64*1024;    // 小于这个大小的文件不做映射
+
+    //打开并映射文件，失败时抛出std::invalid_argument
+    explicit MappedFile(const std::string& filepath,Access access=SEQUENTIAL);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&)=delete;
+    MappedFile& operator=(const MappedFile&)=delete;
+
+    const char* data() const {return data_ptr;}
+    size_t size() const {return length;}
+    std::string_view view() const {return std::string_view(data_ptr,length);}
+};
+
+#endif // MAPPED_FILE_H
@@ -3,6 +3,7 @@
 
 #include<string>
 #include<set>
+#include"ObjectId.h"
 
 class RepositoryCore;
 class CommitManager;
@@ -16,7 +17,7 @@ private:
     FileOperationManager* fileOpManager;
     BranchManager* branchManager;
 
-    std::string findSplitPoint(const std::string& branch1,const std::string& branch2);
+    ObjectId findSplitPoint(const ObjectId& branch1,const ObjectId& branch2);
     std::set<std::string> getAllBranches();
 
 public:
@@ -32,8 +33,8 @@ public:
     void performFastForwardMerge(const std::string& branchName);
 
     //三方合并
-    void performThreeWayMerge(const std::string& branchName,const std::string& currentCommitId,
-                            const std::string& givenCommitId,const std::string& splitPointId);
+    void performThreeWayMerge(const std::string& branchName,const ObjectId& currentCommitId,
+                            const ObjectId& givenCommitId,const ObjectId& splitPointId);
 };
 
 #endif // MERGE_MANAGER_H
\ No newline at end of file
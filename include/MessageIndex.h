@@ -0,0 +1,78 @@
+#ifndef MESSAGE_INDEX_H
+#define MESSAGE_INDEX_H
+
+#include<cstdint>
+#include<functional>
+#include<memory>
+#include<string>
+#include<string_view>
+#include<vector>
+
+class MappedFile;
+
+// 提交信息索引，给find用：完整信息的哈希、分词后的词、以及字节三元组，都映射到commit目录中的序号
+// 和前缀索引一样分两层：主文件按(key,序号)排好序，可以在映射上二分查找；
+// 新commit的记录先追加到日志文件，日志超过COMPACT_THRESHOLD条后合并回主文件
+//
+// message-index:     "GLMIDX1\n" 已索引的commit数(4) | 记录: key(8) 序号(4)
+// message-index.log: 记录: key(8) 序号(4)（追加写入，未排序）
+// 整数均为大端。key的最高两位是类型，哈希冲突由调用方用原文核对
+class MessageIndex{
+private:
+    std::string index_file;
+    std::string log_file;
+
+    struct Posting{
+        uint64_t key;
+        uint32_t ordinal;
+        bool operator<(const Posting& other) const {
+            return key!=other.key?key<other.key:ordinal<other.ordinal;
+        }
+    };
+
+    // 查询时只映射一次主文件、读一次日志
+    mutable std::unique_ptr<MappedFile> mapped;
+    mutable bool log_loaded;
+    mutable std::vector<Posting> log_postings;
+
+    const MappedFile* getMapped() const;
+    const std::vector<Posting>& getLog() const;
+    void writeSorted(const std::vector<Posting>& postings,uint32_t covered);
+
+public:
+    static const size_t RECORD_SIZE=12;
+    static const size_t COMPACT_THRESHOLD=4096;
+
+    explicit MessageIndex(const std::string& gitliteDir);
+    ~MessageIndex();
+
+    bool exists() const;
+
+    //三种key
+    static uint64_t exactKey(std::string_view message);
+    static uint64_t tokenKey(std::string_view token);
+    static uint64_t trigramKey(const char* p);
+
+    //分词：连续的字母数字（以及非ASCII字节）为一个词，统一转为小写
+    static std::vector<std::string> tokenize(std::string_view message);
+
+    //一条信息产生的全部key（已去重）
+    static std::vector<uint64_t> keysOf(std::string_view message);
+
+    //记录序号为ordinal的新commit；索引尚未建立时什么也不做
+    void add(uint32_t ordinal,std::string_view message);
+
+    //用线程池并行地为count条信息重建索引，messageAt(i)返回第i条信息
+    void rebuild(size_t count,const std::function<std::string_view(size_t)>& messageAt);
+
+    //把日志合并进主文件
+    void compact();
+
+    //含有key的commit序号（有序、去重）
+    std::vector<uint32_t> lookup(uint64_t key) const;
+
+    //索引覆盖了目录中前多少个commit，之后的需要调用方直接扫描
+    uint32_t coveredCount() const;
+};
+
+#endif // MESSAGE_INDEX_H
@@ -0,0 +1,63 @@
+#ifndef OBJECT_ID_H
+#define OBJECT_ID_H
+
+#include<array>
+#include<cstdint>
+#include<cstring>
+#include<functional>
+#include<string>
+#include<string_view>
+
+// 20字节的二进制对象ID，只在序列化、打印和文件路径这些边界处转成十六进制
+class ObjectId{
+public:
+    static const int RAW_LENGTH=20;
+    static const int HEX_LENGTH=40;
+
+private:
+    std::array<uint8_t,RAW_LENGTH> bytes;   // 全0表示空ID
+
+public:
+    //空ID
+    ObjectId();
+
+    //从20字节的原始摘要构造
+    static ObjectId fromRaw(const uint8_t* raw);
+
+    //从40位十六进制串构造，格式不对时抛出GitliteException
+    static ObjectId fromHex(std::string_view hex);
+
+    //判断是否是合法的40位十六进制ID
+    static bool isValidHex(std::string_view hex);
+
+    //转换为40位十六进制串
+    std::string toHex() const;
+
+    //把40位十六进制写入out，不分配内存
+    void writeHex(char* out) const;
+
+    //前length位十六进制，用于log中显示缩写
+    std::string toShortHex(size_t length=7) const;
+
+    bool isNull() const;
+    const uint8_t* data() const {return bytes.data();}
+
+    bool operator==(const ObjectId& other) const {return bytes==other.bytes;}
+    bool operator!=(const ObjectId& other) const {return bytes!=other.bytes;}
+    bool operator<(const ObjectId& other) const {
+        return std::memcmp(bytes.data(),other.bytes.data(),RAW_LENGTH)<0;
+    }
+};
+
+namespace std {
+    // ID本身就是均匀分布的哈希值，直接取前8个字节
+    template<> struct hash<ObjectId> {
+        size_t operator()(const ObjectId& id) const noexcept {
+            size_t h;
+            std::memcpy(&h,id.data(),sizeof(h));
+            return h;
+        }
+    };
+}
+
+#endif // OBJECT_ID_H
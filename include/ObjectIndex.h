@@ -0,0 +1,45 @@
+#ifndef OBJECT_INDEX_H
+#define OBJECT_INDEX_H
+
+#include<string>
+#include<vector>
+#include"ObjectId.h"
+
+// 对象ID前缀索引，用于解析缩写的commit id
+// 主文件是排好序的20字节ID数组，可以二分查找；新写入的对象先追加到日志文件，
+// 日志超过COMPACT_THRESHOLD条后合并回主文件
+class ObjectIndex{
+private:
+    std::string index_file;     // 排好序的ID（头部为magic和条数）
+    std::string log_file;       // 追加写入、未排序的ID
+
+    bool loaded;
+    std::vector<ObjectId> sorted_ids;
+    std::vector<ObjectId> log_ids;
+
+    //读取日志文件，末尾不完整的记录直接忽略
+    void loadLog();
+    void writeSorted(const std::vector<ObjectId>& ids);
+
+public:
+    static const size_t COMPACT_THRESHOLD=1024;
+
+    explicit ObjectIndex(const std::string& gitliteDir);
+
+    //读取索引文件，索引不存在或已损坏时返回false
+    bool load();
+
+    //记录一个新写入的对象；索引尚未建立时什么也不做，等第一次查找时整体重建
+    void add(const ObjectId& id);
+
+    //用完整的对象列表重建索引
+    void rebuild(std::vector<ObjectId> ids);
+
+    //把日志合并进主文件
+    void compact();
+
+    //返回所有以hexPrefix开头的ID（有序），调用前需要load成功
+    std::vector<ObjectId> lookup(const std::string& hexPrefix) const;
+};
+
+#endif // OBJECT_INDEX_H
@@ -0,0 +1,132 @@
+#ifndef OBJECT_STORE_H
+#define OBJECT_STORE_H
+
+#include<ctime>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<string_view>
+#include<unordered_set>
+#include<vector>
+#include"ObjectId.h"
+#include"ObjectIndex.h"
+#include"PackFile.h"
+
+// 对象类型，记录在松散对象的头部里；旧版本写入的没有头部的对象为OBJ_UNKNOWN
+enum ObjectType : uint8_t { OBJ_UNKNOWN=0,OBJ_BLOB=1,OBJ_COMMIT=2,OBJ_CHUNK_LIST=3,OBJ_TREE=4 };
+
+// 打包时的排列提示：同一路径的blob排在一起，并建议父commit中同一路径的blob作为delta基准
+struct PackHint{
+    ObjectId id;
+    std::string path;   // blob所在路径
+    ObjectId base;      // 建议的delta基准，可以为空
+};
+
+// 对象库：负责对象在.gitlite/objects下的存放位置与读写
+// 格式版本1起使用两级目录（objects/ab/cdef...），没有版本标记的旧仓库仍按平铺目录读写
+// 读取时先找松散对象，再到objects/pack下的pack里找
+// 松散对象: "\0GLO" 类型(1) 压缩方式(1) 原始长度(varint) 数据；没有这个头部的按原始内容读取
+class ObjectStore{
+private:
+    std::string gitlite_dir;    // 所属仓库的.gitlite目录
+    std::string objects_dir;    // gitlite_dir/objects
+    bool fanout;                // 是否使用两级目录布局
+    uint8_t codec;              // 写松散对象时的压缩方式，由core.compression配置
+    bool chunking;              // 大文件是否分块存储，由core.chunking配置
+    mutable ObjectIndex index;  // 缩写ID的前缀索引，随写入更新
+    mutable std::vector<std::unique_ptr<PackFile>> packs;
+    mutable bool packs_loaded;  // pack目录只在第一次需要时扫描
+    mutable std::mutex packs_mutex; // 读对象可以在多个线程里进行，第一次扫描pack目录时加锁
+    mutable std::mutex write_mutex; // 多个线程写对象时，临时文件编号、放入对象目录和前缀索引的追加加锁
+
+    const std::vector<std::unique_ptr<PackFile>>& getPacks() const;
+
+    std::string flatPath(const ObjectId& id) const;
+    std::string fanoutPath(const ObjectId& id) const;
+    //决定对象修改时间的文件：松散文件，或者所在的pack；不存在时为空串
+    std::string modifiedPath(const ObjectId& id) const;
+
+    //列出某个分片目录里的对象
+    void listShard(const std::string& shard,std::vector<ObjectId>& ids) const;
+    //列出平铺存放在objects目录下的对象
+    void listFlat(const std::string& hexPrefix,std::vector<ObjectId>& ids) const;
+    //列出全部松散对象（平铺和分片目录）
+    void listLoose(const std::string& hexPrefix,std::vector<ObjectId>& ids) const;
+
+public:
+    static const int FORMAT_VERSION=1;  // 当前仓库格式版本
+
+    // 松散对象的压缩方式
+    enum Codec : uint8_t { CODEC_NONE=0,CODEC_LZ4=1 };
+
+    static const char LOOSE_MAGIC[4];
+
+    //松散对象头部：magic 类型 压缩方式 原始长度
+    static std::string looseHeader(ObjectType type,uint8_t codec,uint64_t rawLength);
+    //给内容加上对象头并按codec压缩
+    static std::string encodeLoose(const std::string& content,ObjectType type,uint8_t codec);
+    //解出松散对象的内容；没有对象头的旧对象原样返回，type为OBJ_UNKNOWN
+    static std::string decodeLoose(std::string_view data,ObjectType* type=nullptr);
+
+    explicit ObjectStore(const std::string& gitliteDir);
+
+    //重新读取仓库格式和配置（init、migrate或修改配置之后调用）
+    void reload();
+
+    const std::string& getObjectsDir() const;
+    bool isFanout() const;
+    bool isChunkingEnabled() const;
+    uint8_t getCodec() const;
+
+    //对象文件路径
+    std::string objectPath(const ObjectId& id) const;
+    std::string getPackDir() const;
+
+    //松散对象的实际路径，不存在（或只在pack里）时返回空串
+    std::string loosePath(const ObjectId& id) const;
+
+    bool exists(const ObjectId& id) const;
+    //对象是否在某个pack里（同一对象可能同时有松散文件）
+    bool isPacked(const ObjectId& id) const;
+    //对象最后写入的时间：松散对象取文件的mtime，打包的对象取pack的mtime；不存在时返回0
+    std::time_t modifiedTime(const ObjectId& id) const;
+    //写入对象：先写临时文件再改名，新对象同时记入前缀索引；已有的对象不重写，只更新修改时间
+    void write(const ObjectId& id,const std::string& content,ObjectType type) const;
+    //读取对象内容，对象不存在时抛出GitliteException
+    std::string read(const ObjectId& id) const;
+    //读取对象内容的前length字节，用来判断对象的种类：松散对象只解压第一帧，pack里的delta只还原用到的部分
+    std::string readPrefix(const ObjectId& id,size_t length) const;
+
+    //流式写入用：objects目录下的临时文件路径，以及把写好的临时文件改名为对象id
+    std::string makeTempPath() const;
+    void installObject(const std::string& tmpPath,const ObjectId& id) const;
+    //更新已有对象（松散文件或所在的pack）的修改时间，gc的宽限期从这次写入重新算起
+    void freshen(const ObjectId& id) const;
+
+    //列出全部对象ID（有序，包括打包的对象）
+    std::vector<ObjectId> list() const;
+    //列出以hexPrefix开头的对象ID（有序），只扫描对应的分片目录
+    std::vector<ObjectId> listWithPrefix(const std::string& hexPrefix) const;
+
+    //通过前缀索引查找以hexPrefix开头的对象ID（有序）
+    //索引缺失时先重建；索引里查不到时再扫描分片目录兜底（比如对象由旧版本程序写入）
+    std::vector<ObjectId> resolvePrefix(const std::string& hexPrefix) const;
+    //按objects目录的实际内容重建前缀索引
+    void rebuildIndex() const;
+
+    static const size_t DELTA_WINDOW=10;    // 打包时和前面多少个对象尝试做delta
+
+    //把全部对象（松散的和已有pack里的）重写进一个新pack，删除松散文件和旧pack
+    //按hints的顺序排列对象，相近的blob之间存为delta；返回写入的对象数，没有需要整理的返回0
+    //drop中的对象不写进新pack，随旧pack和松散文件一起删除（gc清理不可达对象时使用）
+    int repack(const std::vector<PackHint>& hints,const std::unordered_set<ObjectId>& drop={});
+
+    //把平铺目录中的对象迁移到两级目录，返回迁移的对象数
+    int migrateToFanout();
+
+    //仓库格式版本标记（.gitlite/format），没有标记时为0
+    static int readFormatVersion(const std::string& gitliteDir);
+    static void writeFormatVersion(const std::string& gitliteDir,int version);
+};
+
+#endif // OBJECT_STORE_H
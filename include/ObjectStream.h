@@ -0,0 +1,78 @@
+#ifndef OBJECT_STREAM_H
+#define OBJECT_STREAM_H
+
+#include<cstdint>
+#include<cstdio>
+#include<string>
+#include"ObjectId.h"
+#include"ObjectStore.h"
+#include"Utils.h"
+
+// 流式读写对象，内存占用只有固定大小的缓冲区，与对象大小无关
+const size_t STREAM_BUFFER_SIZE=64*1024;
+
+// 顺序写一个松散对象：边写边算sha1、按帧压缩，写进objects下的临时文件，finish时改名
+class ObjectWriter{
+private:
+    const ObjectStore& store;
+    std::string tmp_path;
+    FILE* out;
+    uint8_t codec;
+    uint64_t expected_size;     // 对象头里要先写原始长度，所以需要预先知道
+    uint64_t written;
+    SHA1::SHA hasher;
+    std::string frame;          // 还没凑满一帧的数据
+    std::string encoded;
+
+    void put(const std::string& data);
+    void flushFrame();
+
+public:
+    ObjectWriter(const ObjectStore& objectStore,ObjectType type,uint64_t size);
+    ~ObjectWriter();
+
+    ObjectWriter(const ObjectWriter&)=delete;
+    ObjectWriter& operator=(const ObjectWriter&)=delete;
+
+    void write(const char* data,size_t length);
+
+    //写完后改名为对象文件并返回对象id（内容的sha1）
+    //id非空时按给定的id存放（块清单就存在整个文件的id下）
+    ObjectId finish(const ObjectId& id=ObjectId());
+};
+
+// 顺序读一个对象：松散对象逐帧解压；pack中的对象由PackFile整体解出
+class ObjectReader{
+private:
+    FILE* in;
+    uint8_t codec;
+    uint64_t total_size;
+    uint64_t consumed;          // 已经交给调用方的字节数
+    std::string pending;        // 读头部时多读的数据
+    size_t pending_pos;
+    std::string frame;          // 当前解压出来的帧
+    size_t frame_pos;
+    std::string whole;          // pack中的对象
+    size_t whole_pos;
+
+    size_t readInput(char* buffer,size_t length);
+    bool readInputVarint(uint64_t& value);
+    void nextFrame();
+
+public:
+    //打开对象，不存在时抛出GitliteException
+    ObjectReader(const ObjectStore& store,const ObjectId& id);
+    ~ObjectReader();
+
+    ObjectReader(const ObjectReader&)=delete;
+    ObjectReader& operator=(const ObjectReader&)=delete;
+
+    uint64_t size() const {return total_size;}
+
+    //读出最多length字节，返回实际读到的字节数，读完返回0
+    size_t read(char* buffer,size_t length);
+    //读出剩余的全部内容（只用于已知很小的对象）
+    std::string readAll();
+};
+
+#endif // OBJECT_STREAM_H
@@ -0,0 +1,113 @@
+#ifndef PACK_FILE_H
+#define PACK_FILE_H
+
+#include<cstdint>
+#include<cstdio>
+#include<list>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<unordered_map>
+#include<vector>
+#include"ObjectId.h"
+#include"Utils.h"
+
+// 打包存储：许多对象顺序拼接在一个.pack文件里，配套的.idx按ID排序记录(id,offset,length)
+//
+// .pack: "GLPK" 版本(4) | 每个对象: 类型(1) 数据 | 前面所有字节的SHA-1(20)
+//        类型为ENTRY_DELTA时数据是 基准id(20) 差量，基准必须在同一个pack里
+// .idx:  "GLIX" 版本(4) | fanout[256](4) | 条目: id(20) offset(8) length(8) | pack的SHA-1(20)
+// 整数均为大端；fanout[b]是首字节<=b的条目数，先缩小范围再二分查找
+class PackFile{
+private:
+    std::string pack_path;
+    const uint8_t* idx_data;
+    size_t idx_size;
+    const uint8_t* pack_data;
+    size_t pack_size;
+    uint32_t count;
+
+    // 最近解出来的delta基准，同一条链上的对象往往连续读取
+    // gc等会在多个线程里读同一个pack，缓存由base_cache_mutex保护（解码本身不加锁）
+    mutable std::mutex base_cache_mutex;
+    mutable std::list<std::pair<ObjectId,std::string>> base_cache;
+    mutable std::unordered_map<ObjectId,std::list<std::pair<ObjectId,std::string>>::iterator> base_cache_map;
+    mutable size_t base_cache_bytes;
+
+    PackFile();
+
+    const uint8_t* entryAt(size_t i) const;
+    //二分查找，找不到返回-1
+    long find(const ObjectId& id) const;
+    //解出第i个条目的内容，depth用来防止损坏的pack形成环
+    std::string readEntry(size_t i,int depth) const;
+    //只解出第i个条目内容中从offset开始的length字节，delta条目只还原用到的那段基准
+    std::string readEntryRange(size_t i,uint64_t offset,uint64_t length,int depth) const;
+    //取delta基准的内容，优先查缓存
+    std::string readBase(const ObjectId& id,int depth) const;
+    void cacheBase(const ObjectId& id,const std::string& content) const;
+
+public:
+    static const uint32_t VERSION=1;
+    static const size_t ENTRY_SIZE=ObjectId::RAW_LENGTH+16;
+    static const int MAX_DELTA_DEPTH=16;            // 写入时delta链的最大长度
+    static const size_t BASE_CACHE_LIMIT=32<<20;    // delta基准缓存的字节上限
+
+    // pack中对象的存储类型
+    enum EntryType : uint8_t { ENTRY_FULL=0,ENTRY_DELTA=1 };
+
+    //映射.idx和对应的.pack，文件缺失或格式不对时返回nullptr
+    static std::unique_ptr<PackFile> open(const std::string& idxPath);
+    ~PackFile();
+
+    PackFile(const PackFile&)=delete;
+    PackFile& operator=(const PackFile&)=delete;
+
+    const std::string& getPath() const {return pack_path;}
+    size_t size() const {return count;}
+    ObjectId idAt(size_t i) const;
+
+    bool contains(const ObjectId& id) const;
+    //读取对象内容，不在这个pack里时返回false
+    bool read(const ObjectId& id,std::string& content) const;
+    //读取对象内容的前length字节（对象更短时是整个内容），不在这个pack里时返回false
+    bool readPrefix(const ObjectId& id,size_t length,std::string& content) const;
+    //把以hexPrefix开头的ID追加到ids
+    void listWithPrefix(const std::string& hexPrefix,std::vector<ObjectId>& ids) const;
+};
+
+// 顺序写一个新的pack：对象边写边算校验和，finish时写出.idx并原子地改名
+class PackWriter{
+private:
+    struct Entry{
+        ObjectId id;
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    std::string pack_dir;
+    std::string tmp_path;
+    FILE* out;
+    uint64_t offset;
+    SHA1::SHA hasher;
+    std::vector<Entry> entries;
+
+    void put(const void* data,size_t length);
+
+public:
+    explicit PackWriter(const std::string& packDir);
+    ~PackWriter();
+
+    PackWriter(const PackWriter&)=delete;
+    PackWriter& operator=(const PackWriter&)=delete;
+
+    void add(const ObjectId& id,const std::string& content);
+    //写入相对base的差量，base必须也写进这个pack
+    void addDelta(const ObjectId& id,const ObjectId& base,const std::string& delta);
+    size_t size() const {return entries.size();}
+
+    //写出pack和idx，返回pack的名字（pack-<sha1>）
+    std::string finish();
+};
+
+#endif // PACK_FILE_H
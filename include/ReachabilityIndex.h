@@ -0,0 +1,74 @@
+#ifndef REACHABILITY_INDEX_H
+#define REACHABILITY_INDEX_H
+
+#include<cstdint>
+#include<memory>
+#include<string>
+#include<unordered_map>
+#include<utility>
+#include<vector>
+#include"EwahBitmap.h"
+#include"ObjectId.h"
+#include"ObjectStore.h"
+
+// 可达性位图索引：建索引时把对象库里的全部对象排成一个固定的顺序，再给每个分支头各存一张位图，
+// 第i位表示顺序中第i个对象是否从这个commit可达
+// "从A可达但从B不可达的对象"就是两张位图的与非，push、fetch和gc都用它代替逐个commit遍历历史
+// 建索引之后才写入的commit照常遍历，遍历到有位图的commit时整张并入；不在顺序里的新对象另外记录
+//
+// bitmaps: "GLBITMP1" 对象数(4) | 按id排序: id(20)... | 同样顺序: 类型(1)... |
+//          位图数(4) | 每张: commit id(20) EWAH位图（见EwahBitmap）
+// 整数均为大端。类型为OBJ_COMMIT、OBJ_TREE或OBJ_BLOB（块清单和块都记为blob），没有被任何位图覆盖的对象为OBJ_UNKNOWN
+class ReachabilityIndex{
+public:
+    typedef std::pair<ObjectId,ObjectType> Object;
+
+    // 一组对象：索引顺序里的用位表示，其余的（建索引之后写入的）单独记下
+    struct ObjectSet{
+        std::vector<uint64_t> bits;
+        std::unordered_map<ObjectId,ObjectType> extra;
+    };
+
+private:
+    // 一份索引的内容；重建时先在内存里建好新的一份再写出
+    struct Snapshot{
+        std::vector<ObjectId> ids;      // 有序
+        std::vector<uint8_t> types;
+        std::unordered_map<ObjectId,EwahBitmap> bitmaps;
+
+        uint32_t position(const ObjectId& id) const;
+    };
+
+    const ObjectStore& store;
+    std::string index_file;
+    mutable std::unique_ptr<Snapshot> loaded;
+
+    const Snapshot& snapshot() const;
+
+    //从roots出发遍历，把可达的对象加入result；exclude里的对象及其引用的对象不再展开
+    //types非空时记下遍历到的对象的类型（重建时用）
+    void walk(const Snapshot& snap,const std::vector<Object>& roots,const ObjectSet* exclude,
+              ObjectSet& result,std::vector<uint8_t>* types) const;
+
+public:
+    static const uint32_t NONE=0xFFFFFFFF;
+
+    ReachabilityIndex(const std::string& gitliteDir,const ObjectStore& objectStore);
+    ~ReachabilityIndex();
+
+    bool exists() const;
+
+    //从commits和blobs可达的全部对象；对象缺失时抛出GitliteException
+    ObjectSet reachable(const std::vector<ObjectId>& commits,const std::vector<ObjectId>& blobs={}) const;
+
+    //从want可达、从have不可达的对象，按写入顺序排好：blob在前，tree和commit都排在它引用的对象之后
+    std::vector<Object> missing(const std::vector<ObjectId>& want,const std::vector<ObjectId>& have) const;
+
+    //集合里的全部对象ID
+    std::vector<ObjectId> idsOf(const ObjectSet& set) const;
+
+    //按当前对象库的内容重建，给commits各建一张位图，返回位图数
+    size_t rebuild(const std::vector<ObjectId>& commits);
+};
+
+#endif // REACHABILITY_INDEX_H
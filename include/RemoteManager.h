@@ -3,9 +3,13 @@
 
 #include<string>
 #include<map>
+#include<vector>
+#include"ReachabilityIndex.h"
 
 class RepositoryCore;
 class MergeManager;
+class CommitCatalog;
+class CommitGraph;
 
 class RemoteManager{
 private:
@@ -13,6 +17,9 @@ private:
 
     std::map<std::string,std::string> getRemotes();
     void saveRemotes(const std::map<std::string,std::string>& remotes);
+    //按ReachabilityIndex::missing排好的顺序复制对象，目标已有的跳过，复制的commit登记到目标的commit目录和commit图
+    void copyObjects(const ObjectStore& from,const ObjectStore& to,const std::vector<ReachabilityIndex::Object>& objects,
+                     CommitCatalog& catalog,CommitGraph& graph);
     
 public:
     RemoteManager(RepositoryCore* repoCore);
@@ -35,12 +35,15 @@ public:
     static std::string getGitliteDir();
 
     void init();
-    void add(const std::string& filename);
+    //添加文件、目录或通配符匹配的文件到暂存区
+    void add(const std::vector<std::string>& paths);
     void commit(const std::string& message);
     void rm(const std::string& filename);
     void log();
     void globalLog();
     void find(const std::string& commitMessage);
+    //option为--token（按词，全部命中）或--substring（子串）
+    void find(const std::string& option,const std::string& query);
     void checkoutFile(const std::string& filename);
     void checkoutFileInCommit(const std::string& commitId,const std::string& filename);
     void checkoutBranch(const std::string& branchName);
@@ -54,9 +57,16 @@ public:
     void push(const std::string& remoteName,const std::string& remoteBranchName);
     void fetch(const std::string& remoteName,const std::string& remoteBranchName);
     void pull(const std::string& remoteName,const std::string& remoteBranchName);
+    void migrate();
+    void repack();
+    void reindex();
+    void gc(bool dryRun);
+    void fsck();
+    void config(const std::string& key);
+    void config(const std::string& key,const std::string& value);
 
     std::string getCurrentBranch();
-    std::string getCurrentCommitId();
+    ObjectId getCurrentCommitId();
     void setCurrentBranch(const std::string& branchName);
     void clearStagingArea();
     std::set<std::string> getConflictFiles();
@@ -64,7 +74,7 @@ public:
     void clearConflictFiles();
 
     Commit getHeadCommit();
-    std::vector<std::string> getFiles(const std::string& commitId);
+    std::vector<std::string> getFiles(const ObjectId& commitId);
 };
 
 #endif // REPOSITORY_H
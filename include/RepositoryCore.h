@@ -1,39 +1,99 @@
 #ifndef REPOSITORY_CORE_H
 #define REPOSITORY_CORE_H
 
+#include<map>
+#include<memory>
 #include<string>
 #include"StagingArea.h"
+#include"Commit.h"
+#include"CommitCache.h"
+#include"CommitCatalog.h"
+#include"CommitGraph.h"
+#include"ObjectId.h"
+#include"ObjectStore.h"
+#include"ReachabilityIndex.h"
 
 class RepositoryCore{
 private:
     StagingArea stagingArea;
+    ObjectStore objectStore;
+    CommitCache commitCache;    // 所有manager共用，必须在objectStore之后构造
+    CommitCatalog commitCatalog;
+    CommitGraph commitGraph;    // 从commitCatalog重建，必须在它之后构造
+    ReachabilityIndex reachabilityIndex;
+
+    //打包提示：按路径分组的blob，以及父commit中同一路径的blob作为delta基准
+    std::vector<PackHint> packHints();
+
+    //branches下所有分支（包括子目录里的远程跟踪分支）指向的commit，键为相对branches的名字
+    std::map<std::string,ObjectId> allBranchHeads();
+    //allBranchHeads中的commit ID
+    std::vector<ObjectId> branchHeadIds();
 
 protected:
     static const std::string gitlite_dir;
     static const std::string objects_dir;
     static const std::string branches_dir;
-    static const std::string staging_area_file;
+    static const std::string index_file;
+    static const std::string staging_area_file;     // 旧版本的暂存区文件，第一次保存索引时删除
     static const std::string removed_file;
     static const std::string head_file;
     static const std::string remotes_file;
+    static const std::string format_file;
 
 public:
     RepositoryCore();
+    //设置了GITLITE_COMMIT_CACHE_STATS时在退出前打印commit缓存的命中情况
+    ~RepositoryCore();
     
     static bool isInitialized();
     static std::string getGitliteDir();
 
     void init();
 
+    //把旧仓库的平铺对象目录迁移为两级目录
+    void migrate();
+
+    //把松散对象打包，并给各分支头重建可达性位图
+    void repack();
+
+    //并行重建前缀索引、commit目录、提交信息索引和commit图，再重建可达性位图
+    void reindex();
+
+    //删除从分支和暂存区都不可达、且超过gc.graceperiod的对象；dryRun时只列出
+    void gc(bool dryRun);
+
+    //并行校验全部对象的哈希和引用，报告损坏、缺失和悬空的对象
+    void fsck();
+
+    //查看、修改仓库配置
+    void showConfig(const std::string& key);
+    void setConfig(const std::string& key,const std::string& value);
+
     //分支操作
     std::string getCurrentBranch();
     void setCurrentBranch(const std::string& branchName);
-    std::string getBranchHead(const std::string& branchName);
-    void setBranchHead(const std::string& branchName,const std::string& commitId);
+    ObjectId getBranchHead(const std::string& branchName);
+    void setBranchHead(const std::string& branchName,const ObjectId& commitId);
 
     //暂存区操作
     void clearStagingArea();
     StagingArea& getStagingArea();
+
+    //对象库
+    const ObjectStore& getObjectStore() const;
+
+    //按ID取解析好的commit（经过LRU缓存），不存在时抛出GitliteException
+    std::shared_ptr<const Commit> getCommit(const ObjectId& commitId);
+
+    //commit目录
+    CommitCatalog& getCommitCatalog();
+
+    //commit图，merge-base和祖先判断用
+    CommitGraph& getCommitGraph();
+
+    //可达性位图，push、fetch和gc用
+    ReachabilityIndex& getReachabilityIndex();
     
     //复制文件
     void copyFile(const std::string& source,const std::string& destination);
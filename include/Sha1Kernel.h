@@ -0,0 +1,40 @@
+#ifndef SHA1_KERNEL_H
+#define SHA1_KERNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace SHA1 {
+    // 压缩函数：把连续的count个64字节块依次压缩进state[5]
+    typedef void (*CompressFunc)(uint32_t state[5], const uint8_t* blocks, size_t count);
+
+    // 可移植的参考实现（逐轮调用kt/ft），也是其它实现的对照基准
+    void compressPortable(uint32_t state[5], const uint8_t* blocks, size_t count);
+
+    // 展开轮函数的标量实现，适用于任何平台
+    void compressScalar(uint32_t state[5], const uint8_t* blocks, size_t count);
+
+#if defined(__x86_64__) || defined(__i386__)
+    // SSSE3计算消息扩展，标量执行80轮
+    void compressSsse3(uint32_t state[5], const uint8_t* blocks, size_t count);
+
+    // AVX2一次为两个块计算消息扩展
+    void compressAvx2(uint32_t state[5], const uint8_t* blocks, size_t count);
+
+    // x86 SHA扩展指令（SHA-NI）
+    void compressShaNi(uint32_t state[5], const uint8_t* blocks, size_t count);
+#endif
+
+    // 启动时通过cpuid选出当前CPU上最快的实现
+    // 可以用环境变量GITLITE_SHA1_IMPL=portable|scalar|ssse3|avx2|shani强制指定
+    CompressFunc selectCompress();
+
+    // 当前选中实现的名字
+    std::string compressName();
+
+    // 用固定的输入分别跑选中的实现和compressPortable，结果一致时返回true（fsck调用）
+    bool selfCheck();
+}
+
+#endif // SHA1_KERNEL_H
@@ -1,44 +1,116 @@
 #ifndef STAGINGAREA_H
 #define STAGINGAREA_H
 
+#include<cstdint>
 #include<string>
-#include<map>   
+#include<map>
 #include<set>
+#include"ObjectId.h"
 
+// 暂存区和工作区文件的stat缓存，一起存在二进制的索引文件里（取代旧的.gitlite/staging和.gitlite/removed）
+// index: "GLINDEX3" 条目数(4) 代数(8) | 按路径排序的条目: 标志(1) 路径长度(varint) 路径 |
+//        [暂存] blob id(20) | [缓存] blob id(20) mtime(8) ctime(8) 大小(8) inode(8) 取stat的时间(8)
+// 标志: 1为已暂存，2为标记删除，4为有stat缓存；时间为纳秒，整数均为大端
+// 缓存条目只在修改时间早于取stat的时间时可信，这个时间跟着条目保存，重写索引不会让racy的条目变成可信的
+//
+// add、rm等的改动不重写整个索引，而是作为一批记录追加到日志（.gitlite/index.log），读取时在主文件上重放
+// 日志条数超过COMPACT_THRESHOLD且超过主文件条目数时合并回主文件，均摊下来每次改动的I/O和索引大小无关
+// index.log: 每批: 记录长度(4) 代数(8) 记录... 校验(4，代数和记录的sha1前4字节)
+//   记录: 操作(1) 路径长度(varint) 路径 | [暂存] blob id(20) | [缓存] blob id(20) mtime(8) ctime(8) 大小(8) inode(8) 取stat的时间(8)
+// 写到一半中断的批次校验不过，读取时连同后面的内容一起忽略，下次保存时合并回主文件；
+// 每批带上写入时主文件的代数，合并时写出更大的代数，先rename主文件再删日志；
+// 中间中断时留下的旧批次代数比新主文件小，重放时跳过，不会把旧改动盖到新的主文件上
 class StagingArea{
+public:
+    // 工作区文件的stat信息，和文件内容一起变化
+    struct FileStat{
+        int64_t mtime;
+        int64_t ctime;
+        uint64_t size;
+        uint64_t inode;
+        int64_t checked;        // 取stat之前的时间（纳秒），不参与比较
+
+        bool operator==(const FileStat& other) const {
+            return mtime==other.mtime&&ctime==other.ctime&&size==other.size&&inode==other.inode;
+        }
+    };
+
 private:
-    std::map<std::string,std::string> staging_map;//文件名到blob id的映射
+    struct CachedFile{
+        FileStat stat;
+        ObjectId id;
+        int64_t recorded;       // 算blob id之前取stat的时间，修改时间不早于它的条目是racy的；0为不可信
+    };
+
+    // 日志记录的操作
+    enum Op : uint8_t { OP_STAGE=1,OP_UNSTAGE=2,OP_REMOVE=3,OP_UNREMOVE=4,OP_CACHE_V1=5,OP_UNCACHE=6,OP_CLEAR=7,OP_CACHE=8 };
+
+    std::map<std::string,ObjectId> staging_map;   //文件名到blob id的映射
     std::set<std::string> removed_files;          //被删除的文件名集合
-    const std::string staging_file_path;          //文件存储路径(.gitlite/staging)
-    const std::string removed_file_path;          //被删除文件存储路径(.gitlite/removed)
+    std::map<std::string,CachedFile> stat_cache;  //文件名到上次算出的blob id和当时的stat
+    FileStat index_stat;                          //读入时主文件的stat，reload时判断主文件有没有被改写
+    mutable std::string pending;                  //还没写出的日志记录
+    mutable size_t pending_records;
+    mutable uint64_t log_offset;                  //日志中已经读入或写出的长度
+    mutable size_t log_records;
+    mutable bool log_damaged;                     //日志末尾有写坏的批次，下次保存时合并
+    mutable uint64_t generation;                  //主文件的代数，旧版本的索引为0
+    const std::string index_file_path;            //索引文件路径(.gitlite/index)
+    const std::string log_file_path;              //日志路径(.gitlite/index.log)
+    const std::string staging_file_path;          //旧版本的暂存区文件(.gitlite/staging)
+    const std::string removed_file_path;          //旧版本的删除列表(.gitlite/removed)
 
-    //从文件里读取暂存区文件
+    //从索引文件和日志读取，索引不存在时读旧版本的两个文本文件
+    void load();
+    void loadIndex();
+    //从日志的log_offset处往后重放
+    void replayLog();
     void loadStagingMap();
-
-    //从文件里读取被删除的文件
     void loadRemovedFiles();
-   
+
+    //记一条改动，保存时追加到日志
+    void journal(Op op,const std::string& path,const ObjectId& id=ObjectId(),const FileStat* stat=nullptr);
+    //写出完整的主文件并删掉日志
+    void writeIndex() const;
+
 public:
-    StagingArea(const std::string&,const std::string&);
+    static const size_t COMPACT_THRESHOLD=1024;
+
+    StagingArea(const std::string& indexFilePath,const std::string& stagingFilePath,const std::string& removedFilePath);
 
-    const std::map<std::string,std::string>& getStagingMap() const;
+    //读取文件的stat信息，文件不存在或不是普通文件时返回false；stat.checked为调用时的时间
+    static bool statFile(const std::string& path,FileStat& stat);
+
+    const std::map<std::string,ObjectId>& getStagingMap() const;
     const std::set<std::string>& getRemovedFiles() const;
 
-    void addStagedFile(const std::string&,const std::string&);
+    void addStagedFile(const std::string&,const ObjectId&);
     void removeStagedFile(const std::string&);
     void addRemovedFile(const std::string&);
     void removeRemovedFile(const std::string&);
 
-    //保存暂存区和删除列表
+    //工作区文件的blob id：stat信息和缓存一致时直接返回缓存，否则重新计算并更新缓存；文件不存在时返回空ID
+    //缓存的文件在条目写入之后（同一时刻）又修改过时，stat信息可能不变，这种"racy"的条目总是重新计算
+    ObjectId fileBlobId(const std::string& path);
+    //fileBlobId拆成两步，给在多个线程里算哈希的调用方用：stat（由statFile取得）和缓存一致且不是racy时
+    //把缓存的blob id写入id并返回true；否则调用方自己算出哈希，再用recordBlobId记下
+    bool cachedBlobId(const std::string& path,const FileStat& stat,ObjectId& id) const;
+    void recordBlobId(const std::string& path,const FileStat& stat,const ObjectId& id);
+
+    //保存暂存区、删除列表和stat缓存：通常只把这次的改动追加到日志，日志太长时合并回主文件
     void save() const;
 
+    //只有stat缓存变了时才保存（status只读工作区，不改暂存区）
+    void saveStats() const;
+
+    //清空暂存区和删除列表，stat缓存保留
     void clear();
 
-    //重新加载暂存区和删除列表
+    //重新加载暂存区和删除列表：主文件没有被改写时只重放日志新增的部分，没保存的改动丢弃
     void reload();
 
     bool isStaged(const std::string&) const;
     bool isRemoved(const std::string&) const;
 };
 
-#endif // STAGINGAREA_H
\ No newline at end of file
+#endif // STAGINGAREA_H
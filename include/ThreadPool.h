@@ -0,0 +1,51 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include<condition_variable>
+#include<cstddef>
+#include<deque>
+#include<exception>
+#include<functional>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+// 固定数量工作线程的线程池，任务按提交顺序从一个共享队列里取
+// 任务抛出的第一个异常在wait()时重新抛给调用方
+class ThreadPool{
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    std::condition_variable all_done;
+    size_t running;             // 正在执行的任务数
+    bool stopping;
+    std::exception_ptr error;
+
+    void workerLoop();
+
+public:
+    //threads为0时使用硬件线程数
+    explicit ThreadPool(size_t threads=0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)=delete;
+    ThreadPool& operator=(const ThreadPool&)=delete;
+
+    size_t size() const {return workers.size();}
+
+    void submit(std::function<void()> task);
+
+    //等待已提交的任务全部完成
+    void wait();
+
+    //把[0,count)切成若干段并行执行body(begin,end)，返回前全部完成
+    //每个线程先分到连续的一段，做完的线程从还有剩余的线程那里偷走一半（work stealing）
+    void parallelFor(size_t count,const std::function<void(size_t,size_t)>& body);
+
+    //默认的线程数：硬件线程数，取不到时为1
+    static size_t defaultThreads();
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,58 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include<functional>
+#include<map>
+#include<string>
+#include<string_view>
+#include<vector>
+#include"BlobTable.h"
+#include"ObjectId.h"
+#include"ObjectStore.h"
+
+// 目录树对象：一个目录下的文件和子目录。commit通过根目录的tree引用全部文件，
+// 内容相同的目录得到相同的id，没有改动的子树在commit之间直接共用
+//
+// tree: "\0GLT" 版本(1) | 条目数(varint) | 条目: 类型(1) 名字长度(varint) 名字 id(20)
+// 条目按名字排序，类型为OBJ_BLOB或OBJ_TREE；tree的id是整个内容的sha1
+// 写入时总是先写子树再写父目录，所以对象库里有某个tree时，它下面的对象也都在
+class Tree{
+public:
+    struct Entry{
+        std::string name;
+        ObjectType type;
+        ObjectId id;
+    };
+
+    static const char MAGIC[4];
+    static const uint8_t VERSION=1;
+
+    static bool isTreeData(std::string_view data);
+    static std::string serialize(const std::vector<Entry>& entries);
+    //解析tree内容，格式不对时抛出GitliteException
+    static std::vector<Entry> parse(std::string_view data);
+    static std::vector<Entry> load(const ObjectStore& store,const ObjectId& id);
+
+    //写入一个tree（已存在时不重复写），返回它的id
+    static ObjectId write(const ObjectStore& store,const std::vector<Entry>& entries);
+
+    //在base（可以为空）的基础上应用改动：路径到blob id，空id表示删除
+    //只重写改动路径上的tree，其余子树原样共用；返回新的根tree，没有文件时是空tree
+    static ObjectId update(const ObjectStore& store,const ObjectId& base,const std::map<std::string,ObjectId>& changes);
+
+    //按路径逐级查找一个文件，只读出路径上的tree；不存在时返回空ID
+    static ObjectId lookup(const ObjectStore& store,const ObjectId& root,std::string_view path);
+
+    //展开为完整路径到blob id的文件表
+    static BlobTable flatten(const ObjectStore& store,const ObjectId& id);
+
+    //比较两个tree（任一个可以为空），对每个内容不同的文件调用visit(路径, 旧blob id, 新blob id)，不存在的一边为空ID
+    //两边id相同的子树整个跳过，只读出有改动的目录
+    static void diff(const ObjectStore& store,const ObjectId& oldRoot,const ObjectId& newRoot,
+                     const std::function<void(const std::string&,const ObjectId&,const ObjectId&)>& visit);
+
+    //把tree及其下所有对象复制到另一个对象库，目标里已经有的子树整个跳过
+    static void copy(const ObjectStore& from,const ObjectStore& to,const ObjectId& id);
+};
+
+#endif // TREE_H
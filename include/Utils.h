@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
 #include <iostream>
@@ -14,27 +15,31 @@
 #include <iomanip>
 
 namespace SHA1 {
+    // 增量式SHA-1：update()逐段喂入数据，内部只保留一个64字节的块缓冲
     class SHA {
     private:
         typedef uint8_t BYTE;
         typedef uint32_t WORD;
-        WORD A, B, C, D, E;
-        std::vector<WORD> Word;
+        WORD state[5];          // A、B、C、D、E
+        BYTE buffer[64];        // 未满一个块的剩余数据
+        size_t bufferLength;    // buffer中的有效字节数
+        uint64_t totalLength;   // 已喂入的总字节数
         void reset();
-        std::string padding(std::string message);
-        inline WORD charToWord(char ch);
-        WORD shiftLeft(WORD x, int n);
-        WORD kt(int t);
-        WORD ft(int t, WORD B, WORD C, WORD D);
-        void getWord(std::string& message, int index);
+        void processBlocks(const BYTE* blocks, size_t count);
     public:
         SHA();
-        std::string sha(std::string message);
+        void update(const void* data, size_t length);
+        void update(const std::string& data);
+        // 结束哈希，写出20字节的原始摘要，并重置状态以便复用
+        void finalize(uint8_t digest[20]);
+        // 同上，返回40位十六进制摘要
+        std::string finalize();
+        std::string sha(const std::string& message);
     };
     extern SHA sha;
-    std::string sha1(std::string message);
-    std::string sha1(std::string s1, std::string s2);
-    std::string sha1(std::string s1, std::string s2, std::string s3, std::string s4);
+    std::string sha1(const std::string& message);
+    std::string sha1(const std::string& s1, const std::string& s2);
+    std::string sha1(const std::string& s1, const std::string& s2, const std::string& s3, const std::string& s4);
 }
 
 class Utils {
@@ -47,9 +52,11 @@ public:
     static std::string sha1(const std::string& s1, const std::string& s2, 
                           const std::string& s3, const std::string& s4);
     static std::string sha1(const std::vector<unsigned char>& data);
+    static std::string sha1File(const std::string& filepath);
 
     // File operations
     static bool restrictedDelete(const std::string& filepath);
+    static bool removeWorkingFile(const std::string& filepath);
     static std::vector<unsigned char> readContents(const std::string& filepath);
     static std::string readContentsAsString(const std::string& filepath);
     static void writeContents(const std::string& filepath, const std::string& content);
@@ -57,11 +64,14 @@ public:
 
     // Directory operations
     static std::vector<std::string> plainFilenamesIn(const std::string& dirPath);
+    static std::vector<std::string> subdirectoriesIn(const std::string& dirPath);
     static std::string join(const std::string& first, const std::string& second);
     static std::string join(const std::string& first, const std::string& second, const std::string& third);
 
     // Serialization (simplified for basic types)
     static std::vector<unsigned char> serialize(const std::string& obj);
+    static void appendVarint(std::string& out, uint64_t value);
+    static bool readVarint(std::string_view in, size_t& pos, uint64_t& value);
 
     // Message and error reporting
     static void message(const std::string& msg);
@@ -46,8 +46,10 @@ int main(int argc, char* argv[]) {
         bloop.rmRemote(args[1]);
     } else if (firstArg == "add") {
         checkCWD();
-        checkArgsNum(args, 2);
-        bloop.add(args[1]);
+        if (args.size() < 2) {
+            Utils::exitWithMessage("Incorrect operands.");
+        }
+        bloop.add(std::vector<std::string>(args.begin() + 1, args.end()));
     } else if (firstArg == "commit") {
         checkCWD();
         checkArgsNum(args, 2);
@@ -66,8 +68,13 @@ int main(int argc, char* argv[]) {
         bloop.globalLog();
     } else if (firstArg == "find") {
         checkCWD();
-        checkArgsNum(args, 2);
-        bloop.find(args[1]);
+        if (args.size() == 2) {
+            bloop.find(args[1]);
+        } else if (args.size() == 3) {
+            bloop.find(args[1], args[2]);
+        } else {
+            Utils::exitWithMessage("Incorrect operands.");
+        }
     } else if (firstArg == "status") {
         checkCWD();
         checkArgsNum(args, 1);
@@ -117,6 +124,40 @@ int main(int argc, char* argv[]) {
         checkCWD();
         checkArgsNum(args, 3);
         bloop.pull(args[1], args[2]);
+    } else if (firstArg == "migrate") {
+        checkCWD();
+        checkArgsNum(args, 1);
+        bloop.migrate();
+    } else if (firstArg == "config") {
+        checkCWD();
+        if (args.size() == 2) {
+            bloop.config(args[1]);
+        } else if (args.size() == 3) {
+            bloop.config(args[1], args[2]);
+        } else {
+            Utils::exitWithMessage("Incorrect operands.");
+        }
+    } else if (firstArg == "repack") {
+        checkCWD();
+        checkArgsNum(args, 1);
+        bloop.repack();
+    } else if (firstArg == "reindex") {
+        checkCWD();
+        checkArgsNum(args, 1);
+        bloop.reindex();
+    } else if (firstArg == "fsck") {
+        checkCWD();
+        checkArgsNum(args, 1);
+        bloop.fsck();
+    } else if (firstArg == "gc") {
+        checkCWD();
+        if (args.size() == 1) {
+            bloop.gc(false);
+        } else if (args.size() == 2 && args[1] == "--dry-run") {
+            bloop.gc(true);
+        } else {
+            Utils::exitWithMessage("Incorrect operands.");
+        }
     } else {
         std::cout << "No command with that name exists." << std::endl;
         return 0;
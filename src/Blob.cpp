@@ -1,40 +1,275 @@
 #include"../include/Blob.h"
 #include"../include/Utils.h"
 #include"../include/GitliteException.h"
+#include"../include/ObjectStore.h"
+#include"../include/Chunker.h"
+#include"../include/ObjectStream.h"
+#include<cstring>
+#include<fstream>
+#include<sys/stat.h>
+
+namespace {
+    const char CHUNK_LIST_MAGIC[8]={'G','L','C','H','U','N','K','S'};
+}
 
 Blob::Blob(const std::string& content):content(content){
     id=generateId(content); 
 }
 
-Blob::Blob(const std::string& id,const std::string& content):id(id),
-                                                             content(content){}
+Blob::Blob(const ObjectId& id,std::string content):id(id),
+                                                     content(std::move(content)){}
+
+ObjectId Blob::getId()const{return id;}
+
+const std::string& Blob::getContent()const{return content;}
+
+void Blob::write(const ObjectStore& store)const{
+    if(!store.isChunkingEnabled()||content.size()<CHUNK_THRESHOLD){
+        store.write(id,content,OBJ_BLOB);
+        return;
+    }
+
+    // 先写块再写清单，中途失败不会留下指向缺失块的清单
+    std::string chunk_list(CHUNK_LIST_MAGIC,sizeof(CHUNK_LIST_MAGIC));
+    const uint8_t* data=reinterpret_cast<const uint8_t*>(content.data());
+    std::vector<size_t> sizes=Chunker::split(data,content.size());
+    Utils::appendVarint(chunk_list,sizes.size());
+    size_t pos=0;
+    for(size_t size:sizes){
+        std::string chunk=content.substr(pos,size);
+        ObjectId chunk_id=generateId(chunk);
+        if(!store.exists(chunk_id)){
+            store.write(chunk_id,chunk,OBJ_BLOB);
+        }
+        chunk_list.append(reinterpret_cast<const char*>(chunk_id.data()),ObjectId::RAW_LENGTH);
+        Utils::appendVarint(chunk_list,size);
+        pos+=size;
+    }
+    store.write(id,chunk_list,OBJ_CHUNK_LIST);
+}
+
+bool Blob::isChunkList(const ObjectId& id,const std::string& data){
+    return data.size()>=sizeof(CHUNK_LIST_MAGIC)
+        &&std::memcmp(data.data(),CHUNK_LIST_MAGIC,sizeof(CHUNK_LIST_MAGIC))==0
+        &&generateId(data)!=id;
+}
+
+std::vector<std::pair<ObjectId,size_t>> Blob::parseChunkList(const std::string& data){
+    size_t pos=sizeof(CHUNK_LIST_MAGIC);
+    uint64_t count;
+    if(!Utils::readVarint(data,pos,count)){
+        throw GitliteException("Corrupt chunk list");
+    }
+    std::vector<std::pair<ObjectId,size_t>> chunks;
+    for(uint64_t i=0;i<count;i++){
+        uint64_t size;
+        if(data.size()-pos<ObjectId::RAW_LENGTH){
+            throw GitliteException("Corrupt chunk list");
+        }
+        ObjectId chunk_id=ObjectId::fromRaw(reinterpret_cast<const uint8_t*>(data.data()+pos));
+        pos+=ObjectId::RAW_LENGTH;
+        if(!Utils::readVarint(data,pos,size)){
+            throw GitliteException("Corrupt chunk list");
+        }
+        chunks.emplace_back(chunk_id,size);
+    }
+    return chunks;
+}
 
-std::string Blob::getId()const{return id;}
+namespace {
+    // 读出对象开头的几个字节，判断是不是块清单；是的话返回完整清单，否则返回空串
+    // 以magic开头的普通blob极少见，这时才把整个对象读进内存
+    bool readChunkList(ObjectReader& reader,const ObjectId& id,std::string& head){
+        head.resize(sizeof(CHUNK_LIST_MAGIC));
+        if(reader.size()<head.size()){
+            head.clear();
+            return false;
+        }
+        size_t got=0;
+        while(got<head.size()){
+            got+=reader.read(&head[got],head.size()-got);
+        }
+        if(std::memcmp(head.data(),CHUNK_LIST_MAGIC,sizeof(CHUNK_LIST_MAGIC))!=0){
+            return false;
+        }
+        head+=reader.readAll();
+        return Blob::isChunkList(id,head);
+    }
 
-std::string Blob::getContent()const{return content;}
+    void copyToFile(ObjectReader& reader,std::ofstream& file){
+        std::vector<char> buffer(STREAM_BUFFER_SIZE);
+        size_t got;
+        while((got=reader.read(buffer.data(),buffer.size()))>0){
+            file.write(buffer.data(),got);
+        }
+    }
 
-void Blob::write(const std::string& path)const{
-    std::string blob_path=Utils::join(path,id); 
-    Utils::writeContents(blob_path,content);     
+    void copyToStore(ObjectReader& reader,const std::string& head,const ObjectStore& to,const ObjectId& id){
+        ObjectWriter writer(to,OBJ_BLOB,reader.size());
+        writer.write(head.data(),head.size());
+        std::vector<char> buffer(STREAM_BUFFER_SIZE);
+        size_t got;
+        while((got=reader.read(buffer.data(),buffer.size()))>0){
+            writer.write(buffer.data(),got);
+        }
+        writer.finish(id);
+    }
+}
+
+void Blob::writeToFile(const ObjectStore& store,const ObjectId& id,const std::string& filepath){
+    ObjectReader reader(store,id);
+    std::string head;
+    bool chunked=readChunkList(reader,id,head);
+
+    // 和Utils::writeContents一样，子目录里的文件先建好父目录
+    size_t slash=filepath.find_last_of('/');
+    if(slash!=std::string::npos){
+        Utils::createDirectories(filepath.substr(0,slash));
+    }
+    std::ofstream file(filepath,std::ios::binary|std::ios::trunc);
+    if(!file.is_open()){
+        throw std::invalid_argument("cannot create file");
+    }
+    if(!chunked){
+        file.write(head.data(),head.size());
+        copyToFile(reader,file);
+        return;
+    }
+    for(const auto& chunk:parseChunkList(head)){
+        ObjectReader chunk_reader(store,chunk.first);
+        if(chunk_reader.size()!=chunk.second){
+            throw GitliteException("Chunk size mismatch in blob "+id.toHex());
+        }
+        copyToFile(chunk_reader,file);
+    }
+}
+
+std::vector<ObjectId> Blob::chunkIds(const ObjectStore& store,const ObjectId& id){
+    ObjectReader reader(store,id);
+    std::string head;
+    std::vector<ObjectId> ids;
+    if(readChunkList(reader,id,head)){
+        for(const auto& chunk:parseChunkList(head)){
+            ids.push_back(chunk.first);
+        }
+    }
+    return ids;
+}
+
+void Blob::copyObject(const ObjectStore& from,const ObjectStore& to,const ObjectId& id){
+    if(to.exists(id)){
+        return;
+    }
+    ObjectReader reader(from,id);
+    std::string head;
+    if(!readChunkList(reader,id,head)){
+        copyToStore(reader,head,to,id);
+        return;
+    }
+    for(const auto& chunk:parseChunkList(head)){
+        if(!to.exists(chunk.first)){
+            ObjectReader chunk_reader(from,chunk.first);
+            copyToStore(chunk_reader,"",to,chunk.first);
+        }
+    }
+    to.write(id,head,OBJ_CHUNK_LIST);
 }
 
 // 从磁盘加载Blob对象
-Blob Blob::load(const std::string& path,const std::string& id){
-    std::string blob_path=Utils::join(path,id);
-    if(!Utils::exists(blob_path)||!Utils::isFile(blob_path)){
-        throw GitliteException("Blob not found: "+id); 
+Blob Blob::load(const ObjectStore& store,const ObjectId& id){
+    if(!store.exists(id)){
+        throw GitliteException("Blob not found: "+id.toHex()); 
     }
-    std::string content=Utils::readContentsAsString(blob_path); 
-    return Blob(id,content);  // 创建并返回Blob对象
+    std::string content=store.read(id); 
+    if(isChunkList(id,content)){
+        // 分块存储的blob，按清单拼回完整内容
+        std::string assembled;
+        for(const auto& chunk:parseChunkList(content)){
+            assembled+=store.read(chunk.first);
+        }
+        content.swap(assembled);
+    }
+    return Blob(id,std::move(content));  // 创建并返回Blob对象
 }
 
 // 创建Blob对象并立即写入磁盘
-Blob Blob::create(const std::string& path,const std::string& content){
+Blob Blob::create(const ObjectStore& store,const std::string& content){
     Blob blob(content);    
-    blob.write(path);     
+    blob.write(store);     
     return blob;          
 }
 
-std::string Blob::generateId(const std::string& content){
-    return Utils::sha1(content); 
+ObjectId Blob::createFromFile(const ObjectStore& store,const std::string& filepath){
+    std::ifstream file(filepath,std::ios::binary);
+    if(!file.is_open()){
+        throw std::invalid_argument("cannot open file");
+    }
+    struct stat st;
+    if(stat(filepath.c_str(),&st)!=0){
+        throw std::invalid_argument("cannot stat file");
+    }
+    uint64_t size=static_cast<uint64_t>(st.st_size);
+    std::vector<char> buffer(STREAM_BUFFER_SIZE);
+
+    if(!store.isChunkingEnabled()||size<CHUNK_THRESHOLD){
+        ObjectWriter writer(store,OBJ_BLOB,size);
+        while(file){
+            file.read(buffer.data(),buffer.size());
+            if(file.gcount()<=0)break;
+            writer.write(buffer.data(),static_cast<size_t>(file.gcount()));
+        }
+        return writer.finish();
+    }
+
+    // 窗口里至少保留MAX_SIZE字节（或已到文件末尾）再找切分点，切出的块和split()一致
+    SHA1::SHA hasher;
+    std::string window;
+    std::string chunk_list(CHUNK_LIST_MAGIC,sizeof(CHUNK_LIST_MAGIC));
+    std::vector<std::pair<ObjectId,size_t>> chunks;
+    bool eof=false;
+    while(true){
+        while(!eof&&window.size()<Chunker::MAX_SIZE){
+            file.read(buffer.data(),buffer.size());
+            std::streamsize got=file.gcount();
+            if(got<=0){
+                eof=true;
+                break;
+            }
+            hasher.update(buffer.data(),static_cast<size_t>(got));
+            window.append(buffer.data(),static_cast<size_t>(got));
+        }
+        if(window.empty())break;
+
+        size_t n=Chunker::nextBoundary(reinterpret_cast<const uint8_t*>(window.data()),window.size());
+        std::string chunk=window.substr(0,n);
+        window.erase(0,n);
+        ObjectId chunk_id=generateId(chunk);
+        if(!store.exists(chunk_id)){
+            store.write(chunk_id,chunk,OBJ_BLOB);
+        }
+        chunks.emplace_back(chunk_id,n);
+    }
+
+    uint8_t digest[ObjectId::RAW_LENGTH];
+    hasher.finalize(digest);
+    ObjectId id=ObjectId::fromRaw(digest);
+    Utils::appendVarint(chunk_list,chunks.size());
+    for(const auto& chunk:chunks){
+        chunk_list.append(reinterpret_cast<const char*>(chunk.first.data()),ObjectId::RAW_LENGTH);
+        Utils::appendVarint(chunk_list,chunk.second);
+    }
+    store.write(id,chunk_list,OBJ_CHUNK_LIST);
+    return id;
+}
+
+ObjectId Blob::generateId(const std::string& content){
+    SHA1::SHA hasher;
+    uint8_t digest[ObjectId::RAW_LENGTH];
+    hasher.update(content);
+    hasher.finalize(digest);
+    return ObjectId::fromRaw(digest);
+}
+
+ObjectId Blob::generateIdFromFile(const std::string& filepath){
+    return ObjectId::fromHex(Utils::sha1File(filepath));
 }
\ No newline at end of file
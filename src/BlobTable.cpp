@@ -0,0 +1,34 @@
+#include"../include/BlobTable.h"
+#include<algorithm>
+
+BlobTable::BlobTable(const std::map<std::string,ObjectId>& blobs){
+    entries.reserve(blobs.size());
+    entries.assign(blobs.begin(),blobs.end());
+}
+
+BlobTable::BlobTable(std::vector<Entry> unsorted) : entries(std::move(unsorted)){
+    auto by_name=[](const Entry& a,const Entry& b){return a.first<b.first;};
+    // 正常写出的commit已经有序，只在需要时排序
+    if(!std::is_sorted(entries.begin(),entries.end(),by_name)){
+        std::stable_sort(entries.begin(),entries.end(),by_name);
+    }
+    entries.erase(std::unique(entries.begin(),entries.end(),[](const Entry& a,const Entry& b){
+        return a.first==b.first;
+    }),entries.end());
+}
+
+BlobTable::const_iterator BlobTable::find(std::string_view name) const {
+    auto it=std::lower_bound(entries.begin(),entries.end(),name,[](const Entry& entry,std::string_view key){
+        return std::string_view(entry.first)<key;
+    });
+    return it!=entries.end()&&it->first==name?it:entries.end();
+}
+
+ObjectId BlobTable::lookup(std::string_view name) const {
+    auto it=find(name);
+    return it==end()?ObjectId():it->second;
+}
+
+std::map<std::string,ObjectId> BlobTable::toMap() const {
+    return std::map<std::string,ObjectId>(entries.begin(),entries.end());
+}
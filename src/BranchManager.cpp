@@ -3,24 +3,24 @@
 #include"../include/Utils.h"
 #include"../include/CommitManager.h"
 #include"../include/Blob.h"
+#include"../include/DirectoryWalker.h"
 #include<iostream>
-#include<queue>
 
 BranchManager::BranchManager(RepositoryCore* repoCore) : core(repoCore) {}
 
 void BranchManager::branch(const std::string& branchName){
-    std::string branch_head=core->getBranchHead(branchName);  // 检查分支是否已存在
-    if(!branch_head.empty()){
+    ObjectId branch_head=core->getBranchHead(branchName);  // 检查分支是否已存在
+    if(!branch_head.isNull()){
         Utils::exitWithMessage("A branch with that name already exists.");
     }
 
-    std::string current_commit_id=core->getBranchHead(core->getCurrentBranch());  // 获取当前分支的commit
+    ObjectId current_commit_id=core->getBranchHead(core->getCurrentBranch());  // 获取当前分支的commit
     core->setBranchHead(branchName,current_commit_id);  // 新分支指向当前commit
 }
 
 void BranchManager::rmBranch(const std::string& branchName){
-    std::string branch_head=core->getBranchHead(branchName);  
-    if(branch_head.empty()){
+    ObjectId branch_head=core->getBranchHead(branchName);  
+    if(branch_head.isNull()){
         Utils::exitWithMessage("A branch with that name does not exist.");
     }
 
@@ -34,8 +34,8 @@ void BranchManager::rmBranch(const std::string& branchName){
 }
 
 void BranchManager::checkoutBranch(const std::string& branchName){
-    std::string branch_head=core->getBranchHead(branchName);  // 检查目标分支是否存在
-    if(branch_head.empty()){
+    ObjectId branch_head=core->getBranchHead(branchName);  // 检查目标分支是否存在
+    if(branch_head.isNull()){
         Utils::exitWithMessage("No such branch exists.");
     }
 
@@ -59,63 +59,23 @@ std::set<std::string> BranchManager::getAllBranches(){
     return std::set<std::string>(branch_files.begin(),branch_files.end());
 }
 
-std::string BranchManager::findSplitPoint(const std::string& branch1,const std::string& branch2){
-    std::set<std::string> ancestor1; 
-    std::vector<std::string> stack;
-    
-    if(!branch1.empty())stack.push_back(branch1); 
-
-    while(!stack.empty()){
-        std::string commit_id=stack.back(); 
-        stack.pop_back();
-        if(commit_id.empty()||ancestor1.count(commit_id))continue;  
-        ancestor1.insert(commit_id); 
-
-        std::string commit_file=Utils::join(".gitlite/objects",commit_id);
-        Commit commit=Commit::fromFile(commit_file); 
-        for(const auto& parent_id:commit.getParents()){
-            if(!parent_id.empty()&&!ancestor1.count(parent_id))stack.push_back(parent_id);
-        }
-    }
-
-    std::queue<std::string> q;        
-    std::set<std::string> visited;   
-    q.push(branch2);
-    visited.insert(branch2);
-
-    while(!q.empty()){
-        std::string commit_id=q.front();
-        q.pop();
-        if(ancestor1.count(commit_id))return commit_id;  // 如果在ancestor1中找到，即为分割点
-
-        std::string commit_file=Utils::join(".gitlite/objects",commit_id);
-        Commit commit=Commit::fromFile(commit_file);
-        for(const auto& parent_id:commit.getParents()){
-            if(!parent_id.empty()&&!visited.count(parent_id)){
-                q.push(parent_id);      // 将未访问的父commit入队
-                visited.insert(parent_id);
-            }
-        }
-    }   
-
-    return "";
+ObjectId BranchManager::findSplitPoint(const ObjectId& branch1,const ObjectId& branch2){
+    // commit图按世代号往下找，碰到第一个公共祖先就停，不用先收集一边的全部祖先
+    return core->getCommitGraph().mergeBase(branch1,branch2);
 }
 
 void BranchManager::performBranchCheckout(const std::string& branchName){
     std::string current_branch=core->getCurrentBranch();    
-    std::string current_commit_id=core->getBranchHead(current_branch);  // 当前分支的commit ID
-    std::string target_commit_id=core->getBranchHead(branchName);       // 目标分支的commit ID
-
-    std::string current_commit_file=Utils::join(".gitlite/objects",current_commit_id);
-    std::string target_commit_file=Utils::join(".gitlite/objects",target_commit_id);
+    ObjectId current_commit_id=core->getBranchHead(current_branch);  // 当前分支的commit ID
+    ObjectId target_commit_id=core->getBranchHead(branchName);       // 目标分支的commit ID
 
-    Commit current_commit=Commit::fromFile(current_commit_file);
-    Commit target_commit=Commit::fromFile(target_commit_file);
+    auto current_commit=core->getCommit(current_commit_id);
+    auto target_commit=core->getCommit(target_commit_id);
     
-    auto current_blobs=current_commit.getBlobs();  // 当前分支的文件列表
-    auto target_blobs=target_commit.getBlobs();    // 目标分支的文件列表
+    const auto& current_blobs=current_commit->getBlobs();  // 当前分支的文件列表
+    const auto& target_blobs=target_commit->getBlobs();    // 目标分支的文件列表
 
-    auto working_files=Utils::plainFilenamesIn(".");  
+    auto working_files=DirectoryWalker::listFiles(".");  // 包括子目录里的文件
     for(const auto& filename : working_files){
         if(filename.empty()||filename[0]=='.'||filename=="gitlite"){
             continue;
@@ -128,15 +88,14 @@ void BranchManager::performBranchCheckout(const std::string& branchName){
     // 第一步：删除当前分支有但目标分支没有的文件
     for(const auto& current_blob : current_blobs){
         if(!target_blobs.count(current_blob.first)){
-            remove(current_blob.first.c_str());  // 删除工作目录中的文件
+            Utils::removeWorkingFile(current_blob.first);  // 删除工作目录中的文件
         }
     }
 
     // 第二步：添加或更新目标分支的文件
     for(const auto& target_blob : target_blobs){
-        std::string blob_id=target_blob.second;   
-        Blob blob=Blob::load(".gitlite/objects",blob_id); 
-        Utils::writeContents(target_blob.first,blob.getContent());
+        const ObjectId& blob_id=target_blob.second;   
+        Blob::writeToFile(core->getObjectStore(),blob_id,target_blob.first);
     }
 
     core->clearStagingArea();              
@@ -0,0 +1,55 @@
+#include"../include/Chunker.h"
+#include<array>
+
+namespace {
+    // gear表：256个固定的伪随机数，由splitmix64生成，保证不同机器上切分点一致
+    std::array<uint64_t,256> makeGearTable(){
+        std::array<uint64_t,256> table;
+        uint64_t x=0x6769746C69746521ULL;
+        for(auto& v:table){
+            x+=0x9E3779B97F4A7C15ULL;
+            uint64_t z=x;
+            z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+            z=(z^(z>>27))*0x94D049BB133111EBULL;
+            v=z^(z>>31);
+        }
+        return table;
+    }
+
+    const std::array<uint64_t,256> GEAR=makeGearTable();
+
+    // 归一化分块：平均大小之前用更严格的掩码（多2位），之后用更宽松的掩码，块大小更集中
+    // gear哈希的高位受更多字节影响，所以掩码取高位
+    const int AVG_BITS=18;  // log2(AVG_SIZE)
+    const uint64_t MASK_STRICT=~0ULL<<(64-(AVG_BITS+2));
+    const uint64_t MASK_LOOSE=~0ULL<<(64-(AVG_BITS-2));
+}
+
+size_t Chunker::nextBoundary(const uint8_t* data,size_t length){
+    if(length<=MIN_SIZE)return length;
+    size_t limit=length<MAX_SIZE?length:MAX_SIZE;
+    size_t normal=limit<AVG_SIZE?limit:AVG_SIZE;
+
+    uint64_t hash=0;
+    size_t i=MIN_SIZE;
+    for(;i<normal;i++){
+        hash=(hash<<1)+GEAR[data[i]];
+        if(!(hash&MASK_STRICT))return i+1;
+    }
+    for(;i<limit;i++){
+        hash=(hash<<1)+GEAR[data[i]];
+        if(!(hash&MASK_LOOSE))return i+1;
+    }
+    return limit;
+}
+
+std::vector<size_t> Chunker::split(const uint8_t* data,size_t length){
+    std::vector<size_t> sizes;
+    size_t pos=0;
+    while(pos<length){
+        size_t n=nextBoundary(data+pos,length-pos);
+        sizes.push_back(n);
+        pos+=n;
+    }
+    return sizes;
+}
@@ -1,130 +1,426 @@
 #include"../include/Commit.h"
 #include"../include/Utils.h"
+#include"../include/ObjectStore.h"
+#include"../include/MappedFile.h"
+#include"../include/GitliteException.h"
+#include"../include/Tree.h"
 #include<sstream>
 #include<iomanip>
 #include<iostream>
 
-Commit::Commit():id(""),message(""),timestamp(0){}
+namespace {
+    const std::string TEXT_PREFIX="Message:";
+    const size_t ENTRY_SIZE=4+ObjectId::RAW_LENGTH;
+
+    void appendBE(std::string& out,uint64_t v,int bytes){
+        for(int i=bytes-1;i>=0;i--){
+            out.push_back(static_cast<char>(v>>(8*i)));
+        }
+    }
+
+    uint64_t readBE(const char* p,int bytes){
+        uint64_t v=0;
+        for(int i=0;i<bytes;i++){
+            v=(v<<8)|static_cast<uint8_t>(p[i]);
+        }
+        return v;
+    }
+
+    void corrupt(){
+        throw GitliteException("Corrupt commit data");
+    }
+
+    //读一个长度前缀的字段
+    std::string_view readField(std::string_view data,size_t& pos){
+        uint64_t length;
+        if(!Utils::readVarint(data,pos,length)||length>data.size()-pos)corrupt();
+        std::string_view field=data.substr(pos,length);
+        pos+=length;
+        return field;
+    }
+}
+
+const char Commit::BINARY_MAGIC[4]={'\0','G','L','C'};
+
+static bool isBinaryCommit(std::string_view data){
+    return data.size()>sizeof(Commit::BINARY_MAGIC)&&std::memcmp(data.data(),Commit::BINARY_MAGIC,sizeof(Commit::BINARY_MAGIC))==0;
+}
+
+Commit::Commit():message(""),timestamp(0),table_source(TABLE_READY),table_pos(0),store(nullptr){}
+
+Commit::Commit(const std::string& message,
+               const std::time_t& timestamp,
+               const std::vector<ObjectId>& parents,
+               BlobTable blobs)
+    :message(message),timestamp(timestamp),parents(parents),blobs(std::move(blobs)),merge_info(""),
+     table_source(TABLE_READY),table_pos(0),store(nullptr){
+    id=generateId(message,timestamp,parents,this->blobs);  
+}
 
 Commit::Commit(const std::string& message,
                const std::time_t& timestamp,
-               const std::vector<std::string>& parents,
-               const std::map<std::string, std::string>& blobs)
-    :message(message),timestamp(timestamp),parents(parents),blobs(blobs),merge_info(""){
-    id=generateId(message,timestamp,parents,blobs);  
+               const std::vector<ObjectId>& parents,
+               const ObjectId& tree)
+    :message(message),timestamp(timestamp),parents(parents),tree(tree),merge_info(""),
+     table_source(TABLE_READY),table_pos(0),store(nullptr){
+    id=generateId(message,timestamp,parents,tree);
 }
 
-std::string Commit::getId() const {return id;}                              
+ObjectId Commit::getId() const {return id;}                              
 std::string Commit::getMessage() const {return message;}                   
 std::time_t Commit::getTimestamp() const {return timestamp;}               
-std::vector<std::string> Commit::getParents() const {return parents;}      
-std::map<std::string, std::string> Commit::getBlobs() const {return blobs;} 
+const std::vector<ObjectId>& Commit::getParents() const {return parents;}      
+
+const BlobTable& Commit::getBlobs() const {
+    switch(table_source){
+    case TABLE_BINARY:
+        blobs=decodeBinaryTable(*raw,table_pos);
+        break;
+    case TABLE_TEXT:{
+        std::string_view line(*raw);
+        line=line.substr(table_pos,line.find('\n',table_pos)-table_pos);
+        blobs=decodeTextTable(line);
+        break;
+    }
+    case TABLE_TREE:
+        blobs=Tree::flatten(*store,tree);
+        break;
+    case TABLE_READY:
+        return blobs;
+    }
+    table_source=TABLE_READY;
+    raw.reset();
+    return blobs;
+}
+
+const ObjectId& Commit::getTree() const {return tree;}
 std::string Commit::getMergeInfo() const {return merge_info;}               
 
+ObjectId Commit::getBlobId(const std::string& filename) const {
+    // 还没解码时只查这一个文件
+    switch(table_source){
+    case TABLE_BINARY:
+        return findInBinaryTable(*raw,table_pos,filename);
+    case TABLE_TREE:
+        return Tree::lookup(*store,tree,filename);
+    case TABLE_TEXT:
+        getBlobs();
+        break;
+    case TABLE_READY:
+        break;
+    }
+    return blobs.lookup(filename);
+}
+
 void Commit::setMergeInfo(const std::string& info){merge_info=info;}
 
 std::string Commit::serialize() const {
-    std::ostringstream oss;
+    std::string out(BINARY_MAGIC,sizeof(BINARY_MAGIC));
+    out.push_back(static_cast<char>(tree.isNull()?FORMAT_VERSION:TREE_FORMAT_VERSION));
+    appendBE(out,static_cast<uint64_t>(timestamp),8);
 
-    oss<<"Message:"<<message<<"\n";       
+    Utils::appendVarint(out,parents.size());
+    for(const auto& parent:parents){
+        out.append(reinterpret_cast<const char*>(parent.data()),ObjectId::RAW_LENGTH);
+    }
+    Utils::appendVarint(out,message.size());
+    out+=message;
+    Utils::appendVarint(out,merge_info.size());
+    out+=merge_info;
+    if(!tree.isNull()){
+        out.append(reinterpret_cast<const char*>(tree.data()),ObjectId::RAW_LENGTH);
+        return out;
+    }
 
-    oss<<"Time:"<<timestamp<<"\n";        
+    // 定长条目表在前，文件名拼在最后
+    const BlobTable& blobs=getBlobs();
+    size_t names_size=0;
+    for(const auto& blob:blobs){
+        names_size+=blob.first.size();
+    }
+    Utils::appendVarint(out,blobs.size());
+    out.reserve(out.size()+blobs.size()*ENTRY_SIZE+names_size);
+    uint64_t offset=0;
+    for(const auto& blob:blobs){
+        appendBE(out,offset,4);
+        out.append(reinterpret_cast<const char*>(blob.second.data()),ObjectId::RAW_LENGTH);
+        offset+=blob.first.size();
+    }
+    for(const auto& blob:blobs){
+        out+=blob.first;
+    }
+    return out;
+}
+
+bool Commit::isCommitData(std::string_view data){
+    return isBinaryCommit(data)||data.compare(0,TEXT_PREFIX.size(),TEXT_PREFIX)==0;
+}
+
+Commit Commit::deserialize(std::string_view data){
+    return deserialize(std::string(data));
+}
 
-    oss<<"Parents:";
-    for(size_t i=0;i<parents.size();i++){
-        if(i>0)oss<<",";                  
-        oss<<parents[i];
+Commit Commit::deserialize(std::string&& data){
+    auto shared=std::make_shared<const std::string>(std::move(data));
+    if(isBinaryCommit(*shared)){
+        return deserializeBinary(shared,nullptr);
     }
-    oss<<"\n";
+    return deserializeText(shared,nullptr);
+}
 
-    oss<<"Merge:"<<merge_info<<"\n";      
+Commit Commit::deserializeBinary(std::shared_ptr<const std::string> raw,const ObjectId* knownId){
+    std::string_view data(*raw);
+    size_t pos=sizeof(BINARY_MAGIC);
+    uint8_t version=static_cast<uint8_t>(data[pos++]);
+    if(version!=FORMAT_VERSION&&version!=TREE_FORMAT_VERSION){
+        throw GitliteException("Unsupported commit format version");
+    }
+    if(data.size()-pos<8)corrupt();
+    std::time_t timestamp=static_cast<std::time_t>(readBE(data.data()+pos,8));
+    pos+=8;
+
+    uint64_t parent_count;
+    if(!Utils::readVarint(data,pos,parent_count)||parent_count>(data.size()-pos)/ObjectId::RAW_LENGTH)corrupt();
+    std::vector<ObjectId> parents;
+    parents.reserve(parent_count);
+    for(uint64_t i=0;i<parent_count;i++){
+        parents.push_back(ObjectId::fromRaw(reinterpret_cast<const uint8_t*>(data.data()+pos)));
+        pos+=ObjectId::RAW_LENGTH;
+    }
+    std::string message(readField(data,pos));
+    std::string merge_info(readField(data,pos));
 
-    oss<<"Blobs:";
-    bool flag=0;
-    for(const auto& pair:blobs){
-        if(flag)oss<<",";                   
-        oss<<pair.first<<":"<<pair.second;  
-        flag=1;
+    if(version==TREE_FORMAT_VERSION){
+        if(data.size()-pos<ObjectId::RAW_LENGTH)corrupt();
+        Commit commit;
+        commit.message=std::move(message);
+        commit.timestamp=timestamp;
+        commit.parents=std::move(parents);
+        commit.tree=ObjectId::fromRaw(reinterpret_cast<const uint8_t*>(data.data()+pos));
+        commit.merge_info=std::move(merge_info);
+        commit.id=knownId?*knownId:generateId(commit.message,commit.timestamp,commit.parents,commit.tree);
+        return commit;
     }
-    oss<<"\n";
 
-    return oss.str();                     
+    Commit commit;
+    commit.message=std::move(message);
+    commit.timestamp=timestamp;
+    commit.parents=std::move(parents);
+    commit.merge_info=std::move(merge_info);
+    if(knownId){
+        // 文件表留在原始数据里，用到时再解码
+        commit.id=*knownId;
+        commit.table_source=TABLE_BINARY;
+        commit.raw=std::move(raw);
+        commit.table_pos=pos;
+        return commit;
+    }
+    commit.blobs=decodeBinaryTable(data,pos);
+    commit.id=generateId(commit.message,commit.timestamp,commit.parents,commit.blobs);
+    return commit;
+}
+
+BlobTable Commit::decodeBinaryTable(std::string_view data,size_t pos){
+    uint64_t count;
+    if(!Utils::readVarint(data,pos,count)||count>(data.size()-pos)/ENTRY_SIZE)corrupt();
+    const char* table=data.data()+pos;
+    std::string_view names=data.substr(pos+count*ENTRY_SIZE);
+    std::vector<BlobTable::Entry> entries;
+    entries.reserve(count);
+    for(uint64_t i=0;i<count;i++){
+        const char* entry=table+i*ENTRY_SIZE;
+        uint64_t begin=readBE(entry,4);
+        uint64_t end=i+1<count?readBE(entry+ENTRY_SIZE,4):names.size();
+        if(begin>end||end>names.size())corrupt();
+        entries.emplace_back(std::string(names.substr(begin,end-begin)),
+                             ObjectId::fromRaw(reinterpret_cast<const uint8_t*>(entry+4)));
+    }
+    return BlobTable(std::move(entries));
+}
+
+// 条目按文件名排序，直接在原始数据上二分，不解码整个表
+ObjectId Commit::findInBinaryTable(std::string_view data,size_t pos,std::string_view filename){
+    uint64_t count;
+    if(!Utils::readVarint(data,pos,count)||count>(data.size()-pos)/ENTRY_SIZE)corrupt();
+    const char* table=data.data()+pos;
+    std::string_view names=data.substr(pos+count*ENTRY_SIZE);
+    auto nameAt=[&](uint64_t i){
+        const char* entry=table+i*ENTRY_SIZE;
+        uint64_t begin=readBE(entry,4);
+        uint64_t end=i+1<count?readBE(entry+ENTRY_SIZE,4):names.size();
+        if(begin>end||end>names.size())corrupt();
+        return names.substr(begin,end-begin);
+    };
+    uint64_t low=0,high=count;
+    while(low<high){
+        uint64_t mid=low+(high-low)/2;
+        if(nameAt(mid)<filename){
+            low=mid+1;
+        }
+        else{
+            high=mid;
+        }
+    }
+    if(low<count&&nameAt(low)==filename){
+        return ObjectId::fromRaw(reinterpret_cast<const uint8_t*>(table+low*ENTRY_SIZE+4));
+    }
+    return ObjectId();
 }
 
-// 从序列化字符串反序列化为commit对象
-Commit Commit::deserialize(const std::string& data){
-    std::istringstream iss(data);     
-    std::string line;
+// 旧的文本格式
+// 直接在输入上按行切分，不经过istringstream，也不为每个字段拷贝子串
+Commit Commit::deserializeText(std::shared_ptr<const std::string> raw,const ObjectId* knownId){
+    std::string_view data(*raw);
     std::string message;
     std::time_t timestamp=0;
-    std::vector<std::string> parents;
-    std::map<std::string, std::string> blobs;
+    std::vector<ObjectId> parents;
+    BlobTable blobs;
+    size_t blobs_pos=std::string_view::npos;
     std::string merge_info;
 
+    auto startsWith=[](std::string_view line,std::string_view prefix){
+        return line.compare(0,prefix.size(),prefix)==0;
+    };
+
     // 逐行解析序列化数据
-    while(std::getline(iss, line)){
-        if(line.rfind("Message:",0)==0)     
-            message=line.substr(8);           
-        
-        else if(line.rfind("Time:",0)==0)     
-            timestamp=std::stoll(line.substr(5));  
-        
-        else if(line.rfind("Parents:",0)==0){ 
-            std::string parents_str=line.substr(8);  
+    size_t line_start=0;
+    while(line_start<data.size()){
+        size_t line_end=data.find('\n',line_start);
+        if(line_end==std::string_view::npos)line_end=data.size();
+        std::string_view line=data.substr(line_start,line_end-line_start);
+        line_start=line_end+1;
+
+        if(startsWith(line,"Message:"))
+            message=std::string(line.substr(8));
+
+        else if(startsWith(line,"Time:"))
+            timestamp=std::stoll(std::string(line.substr(5)));
+
+        else if(startsWith(line,"Parents:")){
+            std::string_view parents_str=line.substr(8);
             parents.clear();
-            if(!parents_str.empty()){
-                std::stringstream ss(parents_str);
-                std::string parent;
-                while(std::getline(ss,parent,',')) 
-                    parents.push_back(parent);
+            while(!parents_str.empty()){
+                size_t comma=parents_str.find(',');
+                parents.push_back(ObjectId::fromHex(parents_str.substr(0,comma)));
+                if(comma==std::string_view::npos)break;
+                parents_str.remove_prefix(comma+1);
             }
-        } 
-
-        else if(line.rfind("Merge:",0)==0)  
-            merge_info=line.substr(6);         
-        
-        else if(line.rfind("Blobs:",0)==0){
-            std::string blobs_str=line.substr(6);  
-            blobs.clear();
-            if (!blobs_str.empty()) {
-                std::stringstream ss(blobs_str);
-                std::string pair;
-                while (std::getline(ss,pair,',')){ 
-                    size_t pos=pair.find(':');
-                    if (pos!=std::string::npos){
-                        std::string key=pair.substr(0,pos);  
-                        std::string value=pair.substr(pos+1);  
-                        blobs[key]=value;                       
-                    }
-                }
+        }
+
+        else if(startsWith(line,"Merge:"))
+            merge_info=std::string(line.substr(6));
+
+        else if(startsWith(line,"Blobs:")){
+            // id已知时先不解析，记下位置
+            blobs_pos=line_start-line.size()-1+6;
+            if(!knownId){
+                blobs=decodeTextTable(line.substr(6));
             }
         }
     }
-    
+
+    if(knownId){
+        Commit commit;
+        commit.message=std::move(message);
+        commit.timestamp=timestamp;
+        commit.parents=std::move(parents);
+        commit.merge_info=std::move(merge_info);
+        commit.id=*knownId;
+        if(blobs_pos!=std::string_view::npos){
+            commit.table_source=TABLE_TEXT;
+            commit.raw=std::move(raw);
+            commit.table_pos=blobs_pos;
+        }
+        return commit;
+    }
+
     // 创建commit对象
-    Commit commit(message,timestamp,parents,blobs);
+    Commit commit(message,timestamp,parents,std::move(blobs));
     commit.setMergeInfo(merge_info);
     return commit;
 }
 
+BlobTable Commit::decodeTextTable(std::string_view blobs_str){
+    std::vector<BlobTable::Entry> blobs;
+    // 文件名本来就有序，BlobTable构造时只检查一遍
+    while(!blobs_str.empty()){
+        size_t comma=blobs_str.find(',');
+        std::string_view pair=blobs_str.substr(0,comma);
+        size_t pos=pair.find(':');
+        if(pos!=std::string_view::npos){
+            blobs.emplace_back(std::string(pair.substr(0,pos)),ObjectId::fromHex(pair.substr(pos+1)));
+        }
+        if(comma==std::string_view::npos)break;
+        blobs_str.remove_prefix(comma+1);
+    }
+    return BlobTable(std::move(blobs));
+}
+
 // 反序列化
 Commit Commit::fromFile(const std::string& filename) {
-    std::string data=Utils::readContentsAsString(filename);  
-    return deserialize(data);                                    
+    MappedFile file(filename);
+    return deserialize(file.view());                                    
 }
 
-std::string Commit::generateId(const std::string& message, 
-                               const std::time_t& timestamp,
-                               const std::vector<std::string>& parents,
-                               const std::map<std::string, std::string>& blobs) {
-    std::ostringstream oss;
-    oss<<message<<timestamp;              
-    for(const auto& parent : parents)      
-        oss<<parent;
+// 从对象库读取并反序列化
+Commit Commit::load(const ObjectStore& store,const ObjectId& id) {
+    auto data=std::make_shared<const std::string>(store.read(id));
+    // 完整性由fsck按字段重新计算id来检查，这里按id读出的就不再算一遍
+    if(isBinaryCommit(*data)){
+        Commit commit=deserializeBinary(data,&id);
+        if(!commit.tree.isNull()){
+            commit.table_source=TABLE_TREE;
+            commit.store=&store;
+        }
+        return commit;
+    }
+    return deserializeText(data,&id);
+}
+
+ObjectId Commit::generateId(const std::string& message, 
+                            const std::time_t& timestamp,
+                            const std::vector<ObjectId>& parents,
+                            const BlobTable& blobs) {
+    // 各字段依次喂给哈希器，避免先拼出一个与文件数成正比的大字符串
+    // ID按十六进制参与哈希，与旧版本生成的commit id保持一致
+    SHA1::SHA hasher;
+    char hex[ObjectId::HEX_LENGTH];
+    hasher.update(message);
+    hasher.update(timeToString(timestamp));
+    for(const auto& parent : parents){
+        parent.writeHex(hex);
+        hasher.update(hex,sizeof(hex));
+    }
     
-    for(const auto& blob : blobs)         
-        oss<<blob.first<<blob.second;
-    return Utils::sha1(oss.str());         
+    for(const auto& blob : blobs){
+        hasher.update(blob.first);
+        blob.second.writeHex(hex);
+        hasher.update(hex,sizeof(hex));
+    }
+    uint8_t digest[ObjectId::RAW_LENGTH];
+    hasher.finalize(digest);
+    return ObjectId::fromRaw(digest);
+}
+
+// 引用tree的commit：tree的id已经概括了全部文件，不用再逐个文件哈希
+ObjectId Commit::generateId(const std::string& message,
+                            const std::time_t& timestamp,
+                            const std::vector<ObjectId>& parents,
+                            const ObjectId& tree) {
+    SHA1::SHA hasher;
+    char hex[ObjectId::HEX_LENGTH];
+    hasher.update(message);
+    hasher.update(timeToString(timestamp));
+    for(const auto& parent : parents){
+        parent.writeHex(hex);
+        hasher.update(hex,sizeof(hex));
+    }
+    hasher.update(std::string("tree:"));
+    tree.writeHex(hex);
+    hasher.update(hex,sizeof(hex));
+    uint8_t digest[ObjectId::RAW_LENGTH];
+    hasher.finalize(digest);
+    return ObjectId::fromRaw(digest);
 }
 
 // 将时间戳转换为字符串（序列化）
@@ -137,6 +433,10 @@ std::time_t Commit::stringToTime(const std::string& timeStr) {
     return std::stoll(timeStr);
 }
 
+std::string Commit::getShortId() const {
+    return id.toShortHex();
+}
+
 // 判断是否为merge commit
 // 如果有多个父commit则为true，否则为false
 bool Commit::isMergeCommit() const {
@@ -144,6 +444,10 @@ bool Commit::isMergeCommit() const {
 }
 
 std::string Commit::getFormattedTimestamp() const {
+    return formatTimestamp(timestamp);
+}
+
+std::string Commit::formatTimestamp(std::time_t timestamp){
     std::tm* tm_info=std::localtime(&timestamp);
     std::ostringstream oss;
     oss<<std::put_time(tm_info,"%a %b %d %H:%M:%S %Y %z");
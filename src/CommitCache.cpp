@@ -0,0 +1,34 @@
+#include"../include/CommitCache.h"
+#include"../include/ObjectStore.h"
+#include"../include/GitliteException.h"
+
+CommitCache::CommitCache(const ObjectStore& objectStore,size_t capacity)
+    : store(objectStore),capacity(capacity),hits(0),misses(0){}
+
+std::shared_ptr<const Commit> CommitCache::get(const ObjectId& id){
+    auto it=entry_map.find(id);
+    if(it!=entry_map.end()){
+        hits++;
+        entries.splice(entries.begin(),entries,it->second);
+        return it->second->second;
+    }
+
+    misses++;
+    // 完整ID直接按路径判断是否存在，不需要扫描objects目录
+    if(!store.exists(id)){
+        throw GitliteException("Commit not found: "+id.toHex());
+    }
+    auto commit=std::make_shared<const Commit>(Commit::load(store,id));
+    entries.emplace_front(id,commit);
+    entry_map[id]=entries.begin();
+    while(entries.size()>capacity){
+        entry_map.erase(entries.back().first);
+        entries.pop_back();
+    }
+    return commit;
+}
+
+void CommitCache::clear(){
+    entries.clear();
+    entry_map.clear();
+}
@@ -0,0 +1,291 @@
+#include"../include/CommitCatalog.h"
+#include"../include/Commit.h"
+#include"../include/MappedFile.h"
+#include"../include/ObjectStore.h"
+#include"../include/Utils.h"
+#include<algorithm>
+#include<iterator>
+#include<cstdio>
+#include<cstring>
+#include<fstream>
+#include<memory>
+#include<vector>
+#include<sys/stat.h>
+
+namespace {
+    const std::string CATALOG_MAGIC="GLCCAT1\n";
+    const size_t COMMIT_PEEK=16;    // 判断是不是commit只需要开头的magic或"Message:"
+
+    uint64_t readBE(const uint8_t* p,int bytes){
+        uint64_t v=0;
+        for(int i=0;i<bytes;i++){
+            v=(v<<8)|p[i];
+        }
+        return v;
+    }
+
+    void appendBE(std::string& out,uint64_t v,int bytes){
+        for(int i=bytes-1;i>=0;i--){
+            out.push_back(static_cast<char>(v>>(8*i)));
+        }
+    }
+
+    void appendId(std::string& out,const ObjectId& id){
+        out.append(reinterpret_cast<const char*>(id.data()),ObjectId::RAW_LENGTH);
+    }
+
+    //生成一条记录和对应的信息，信息从messageOffset开始编号
+    void encodeEntry(const CommitCatalog::Entry& entry,uint64_t messageOffset,std::string& records,std::string& messages){
+        appendId(records,entry.id);
+        appendBE(records,static_cast<uint64_t>(entry.timestamp),8);
+        appendId(records,entry.parents[0]);
+        appendId(records,entry.parents[1]);
+        appendBE(records,messageOffset+messages.size(),8);
+        appendBE(records,entry.message.size(),4);
+        messages+=entry.message;
+        messages.push_back('\n');
+    }
+
+    //为commits生成记录和信息
+    void encode(const std::vector<const Commit*>& commits,uint64_t messageOffset,std::string& records,std::string& messages){
+        for(const Commit* commit:commits){
+            const auto& parents=commit->getParents();
+            std::string message=commit->getMessage();
+            CommitCatalog::Entry entry;
+            entry.id=commit->getId();
+            entry.timestamp=commit->getTimestamp();
+            entry.parents[0]=parents.size()>0?parents[0]:ObjectId();
+            entry.parents[1]=parents.size()>1?parents[1]:ObjectId();
+            entry.message=message;
+            encodeEntry(entry,messageOffset,records,messages);
+        }
+    }
+
+    uint64_t fileSize(const std::string& path){
+        struct stat st;
+        return stat(path.c_str(),&st)==0?static_cast<uint64_t>(st.st_size):0;
+    }
+}
+
+CommitCatalog::CommitCatalog(const std::string& gitliteDir,const ObjectStore& objectStore)
+    : store(objectStore),
+      catalog_file(Utils::join(gitliteDir,"commit-catalog")),
+      messages_file(Utils::join(gitliteDir,"commit-messages")),
+      message_index(gitliteDir){}
+
+bool CommitCatalog::exists() const {
+    return Utils::isFile(catalog_file);
+}
+
+CommitCatalog::Reader::Reader(const CommitCatalog& owner)
+    : catalog(owner.catalog_file,MappedFile::SEQUENTIAL),count(0){
+    if(catalog.size()<CATALOG_MAGIC.length()
+     ||std::memcmp(catalog.data(),CATALOG_MAGIC.data(),CATALOG_MAGIC.length())!=0){
+        return;
+    }
+    // 信息文件可能还不存在（目录为空）
+    if(Utils::isFile(owner.messages_file)){
+        messages.reset(new MappedFile(owner.messages_file,MappedFile::RANDOM));
+    }
+    count=(catalog.size()-CATALOG_MAGIC.length())/RECORD_SIZE;
+}
+
+CommitCatalog::Entry CommitCatalog::Reader::at(size_t i) const {
+    const uint8_t* p=reinterpret_cast<const uint8_t*>(catalog.data())+CATALOG_MAGIC.length()+i*RECORD_SIZE;
+    std::string_view text=messages?messages->view():std::string_view();
+    Entry entry;
+    entry.timestamp=static_cast<std::time_t>(readBE(p+20,8));
+    entry.parents[0]=ObjectId::fromRaw(p+28);
+    entry.parents[1]=ObjectId::fromRaw(p+48);
+    uint64_t offset=readBE(p+68,8);
+    uint64_t length=readBE(p+76,4);
+    if(offset<=text.size()&&length<=text.size()-offset){
+        entry.id=ObjectId::fromRaw(p);
+        entry.message=text.substr(offset,length);
+    }
+    return entry;
+}
+
+void CommitCatalog::append(const Commit& commit){
+    if(!exists())return;
+
+    std::string records,messages;
+    encode({&commit},fileSize(messages_file),records,messages);
+    uint64_t ordinal=(fileSize(catalog_file)-CATALOG_MAGIC.length())/RECORD_SIZE;
+    {
+        std::ofstream out(messages_file,std::ios::binary|std::ios::app);
+        out.write(messages.data(),messages.size());
+    }
+    {
+        std::ofstream out(catalog_file,std::ios::binary|std::ios::app);
+        out.write(records.data(),records.size());
+    }
+    message_index.add(static_cast<uint32_t>(ordinal),commit.getMessage());
+}
+
+size_t CommitCatalog::rebuild(){
+    std::vector<Commit> commits;
+    for(const auto& id:store.list()){
+        // 先只看开头，blob和块不用整个解压出来
+        if(!Commit::isCommitData(store.readPrefix(id,COMMIT_PEEK)))continue;
+        std::string content=store.read(id);
+        try{
+            Commit commit=Commit::deserialize(content);
+            if(commit.getId()==id){
+                commits.push_back(std::move(commit));
+            }
+        }catch(...){
+            continue;
+        }
+    }
+    std::stable_sort(commits.begin(),commits.end(),[](const Commit& a,const Commit& b){
+        return a.getTimestamp()<b.getTimestamp();
+    });
+
+    std::vector<const Commit*> ordered;
+    for(const auto& commit:commits){
+        ordered.push_back(&commit);
+    }
+    std::string records=CATALOG_MAGIC;
+    std::string messages;
+    encode(ordered,0,records,messages);
+    return install(records,messages);
+}
+
+size_t CommitCatalog::remove(const std::unordered_set<ObjectId>& ids){
+    if(!exists()){
+        return rebuild();
+    }
+    std::string records=CATALOG_MAGIC;
+    std::string messages;
+    {
+        Reader reader(*this);
+        for(size_t i=0;i<reader.size();i++){
+            Entry entry=reader.at(i);
+            if(!entry.id.isNull()&&!ids.count(entry.id)){
+                encodeEntry(entry,0,records,messages);
+            }
+        }
+    }
+    return install(records,messages);
+}
+
+size_t CommitCatalog::install(const std::string& records,const std::string& messages){
+    // 先写信息文件；两个文件都先写临时文件再rename，避免中途失败留下半个目录
+    std::string tmp_messages=messages_file+".tmp";
+    std::string tmp_catalog=catalog_file+".tmp";
+    Utils::writeContents(tmp_messages,messages);
+    Utils::writeContents(tmp_catalog,records);
+    std::rename(tmp_messages.c_str(),messages_file.c_str());
+    std::rename(tmp_catalog.c_str(),catalog_file.c_str());
+
+    // 序号随目录一起变了，信息索引也要重建
+    Reader reader(*this);
+    message_index.rebuild(reader.size(),[&reader](size_t i){return reader.at(i).message;});
+    return reader.size();
+}
+
+void CommitCatalog::forEach(const std::function<void(const Entry&)>& visit){
+    if(!exists()){
+        rebuild();
+    }
+    Reader reader(*this);
+    for(size_t i=0;i<reader.size();i++){
+        Entry entry=reader.at(i);
+        if(!entry.id.isNull()){
+            visit(entry);
+        }
+    }
+}
+
+std::vector<ObjectId> CommitCatalog::find(const std::string& query,MatchMode mode){
+    if(!exists()){
+        rebuild();
+    }
+    Reader reader(*this);
+    if(!message_index.exists()){
+        message_index.rebuild(reader.size(),[&reader](size_t i){return reader.at(i).message;});
+    }
+
+    // 根据匹配方式得到要查的key；所有key都命中的commit才是候选
+    std::vector<uint64_t> keys;
+    std::vector<std::string> tokens;
+    bool scan_all=false;
+    switch(mode){
+    case MATCH_EXACT:
+        keys.push_back(MessageIndex::exactKey(query));
+        break;
+    case MATCH_TOKENS:
+        tokens=MessageIndex::tokenize(query);
+        for(const auto& token:tokens){
+            keys.push_back(MessageIndex::tokenKey(token));
+        }
+        if(tokens.empty())return {};
+        break;
+    case MATCH_SUBSTRING:
+        // 不足三个字节的子串没有三元组可查，只能逐条比较
+        if(query.size()<3){
+            scan_all=true;
+        }
+        for(size_t i=0;i+3<=query.size();i++){
+            keys.push_back(MessageIndex::trigramKey(query.data()+i));
+        }
+        break;
+    }
+
+    auto matches=[&](std::string_view message){
+        switch(mode){
+        case MATCH_EXACT:
+            return message==query;
+        case MATCH_TOKENS:{
+            auto words=MessageIndex::tokenize(message);
+            std::sort(words.begin(),words.end());
+            for(const auto& token:tokens){
+                if(!std::binary_search(words.begin(),words.end(),token))return false;
+            }
+            return true;
+        }
+        case MATCH_SUBSTRING:
+            return message.find(query)!=std::string_view::npos;
+        }
+        return false;
+    };
+
+    std::vector<uint32_t> candidates;
+    size_t covered=message_index.coveredCount();
+    if(scan_all){
+        covered=0;
+    }
+    else{
+        // 从最短的倒排表开始求交集
+        std::vector<std::vector<uint32_t>> lists;
+        for(uint64_t key:keys){
+            lists.push_back(message_index.lookup(key));
+        }
+        std::sort(lists.begin(),lists.end(),[](const std::vector<uint32_t>& a,const std::vector<uint32_t>& b){
+            return a.size()<b.size();
+        });
+        candidates=lists.front();
+        for(size_t i=1;i<lists.size()&&!candidates.empty();i++){
+            std::vector<uint32_t> both;
+            std::set_intersection(candidates.begin(),candidates.end(),lists[i].begin(),lists[i].end(),std::back_inserter(both));
+            candidates.swap(both);
+        }
+    }
+    // 索引没覆盖到的commit（比如追加到一半中断）直接逐条核对
+    for(size_t i=covered;i<reader.size();i++){
+        candidates.push_back(static_cast<uint32_t>(i));
+    }
+    std::sort(candidates.begin(),candidates.end());
+    candidates.erase(std::unique(candidates.begin(),candidates.end()),candidates.end());
+
+    std::vector<ObjectId> result;
+    for(uint32_t ordinal:candidates){
+        if(ordinal>=reader.size())continue;
+        Entry entry=reader.at(ordinal);
+        if(!entry.id.isNull()&&matches(entry.message)){
+            result.push_back(entry.id);
+        }
+    }
+    return result;
+}
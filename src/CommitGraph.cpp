@@ -0,0 +1,338 @@
+#include"../include/CommitGraph.h"
+#include"../include/Commit.h"
+#include"../include/CommitCatalog.h"
+#include"../include/GitliteException.h"
+#include"../include/MappedFile.h"
+#include"../include/Utils.h"
+#include<algorithm>
+#include<cstdio>
+#include<cstring>
+#include<fstream>
+#include<queue>
+#include<sys/stat.h>
+
+namespace {
+    const std::string GRAPH_MAGIC="GLCGRPH1";
+    const size_t FANOUT_SIZE=256*4;
+    const size_t HEADER_SIZE=8+4+FANOUT_SIZE;
+
+    uint64_t readBE(const uint8_t* p,int bytes){
+        uint64_t v=0;
+        for(int i=0;i<bytes;i++){
+            v=(v<<8)|p[i];
+        }
+        return v;
+    }
+
+    void appendBE(std::string& out,uint64_t v,int bytes){
+        for(int i=bytes-1;i>=0;i--){
+            out.push_back(static_cast<char>(v>>(8*i)));
+        }
+    }
+
+    void appendId(std::string& out,const ObjectId& id){
+        out.append(reinterpret_cast<const char*>(id.data()),ObjectId::RAW_LENGTH);
+    }
+
+    // merge-base遍历时的标记
+    const uint8_t FROM_A=1;
+    const uint8_t FROM_B=2;
+}
+
+CommitGraph::CommitGraph(const std::string& gitliteDir,CommitCatalog& commitCatalog)
+    : catalog(commitCatalog),
+      graph_file(Utils::join(gitliteDir,"commit-graph")),
+      log_file(Utils::join(gitliteDir,"commit-graph.log")),
+      count(0),loaded(false){}
+
+CommitGraph::~CommitGraph(){}
+
+bool CommitGraph::exists() const {
+    return Utils::isFile(graph_file);
+}
+
+void CommitGraph::unload() const {
+    mapped.reset();
+    count=0;
+    loaded=false;
+    log_ids.clear();
+    log_nodes.clear();
+    log_map.clear();
+}
+
+bool CommitGraph::load() const {
+    if(loaded)return true;
+    if(!exists())return false;
+    std::unique_ptr<MappedFile> file(new MappedFile(graph_file,MappedFile::RANDOM));
+    if(file->size()<HEADER_SIZE||std::memcmp(file->data(),GRAPH_MAGIC.data(),GRAPH_MAGIC.length())!=0){
+        return false;
+    }
+    uint32_t n=static_cast<uint32_t>(readBE(reinterpret_cast<const uint8_t*>(file->data())+GRAPH_MAGIC.length(),4));
+    if(file->size()!=HEADER_SIZE+static_cast<uint64_t>(n)*(ObjectId::RAW_LENGTH+RECORD_SIZE)){
+        return false;
+    }
+    mapped=std::move(file);
+    count=n;
+
+    // 日志里的父commit在主文件或更早的日志记录里，读的时候换成序号；末尾不完整的记录忽略
+    if(Utils::isFile(log_file)){
+        std::string data=Utils::readContentsAsString(log_file);
+        const uint8_t* p=reinterpret_cast<const uint8_t*>(data.data());
+        for(size_t pos=0;pos+LOG_RECORD_SIZE<=data.size();pos+=LOG_RECORD_SIZE){
+            ObjectId id=ObjectId::fromRaw(p+pos);
+            Node entry;
+            for(int k=0;k<2;k++){
+                ObjectId parent=ObjectId::fromRaw(p+pos+ObjectId::RAW_LENGTH*(k+1));
+                entry.parents[k]=parent.isNull()?NONE:find(parent);
+            }
+            entry.generation=static_cast<uint32_t>(readBE(p+pos+3*ObjectId::RAW_LENGTH,4));
+            entry.timestamp=static_cast<std::time_t>(readBE(p+pos+3*ObjectId::RAW_LENGTH+4,8));
+            if(log_map.emplace(id,count+static_cast<uint32_t>(log_ids.size())).second){
+                log_ids.push_back(id);
+                log_nodes.push_back(entry);
+            }
+        }
+    }
+    loaded=true;
+    return true;
+}
+
+uint32_t CommitGraph::find(const ObjectId& id) const {
+    if(mapped){
+        // fanout表缩小范围后在映射上二分
+        const uint8_t* base=reinterpret_cast<const uint8_t*>(mapped->data());
+        const uint8_t* fanout=base+GRAPH_MAGIC.length()+4;
+        const uint8_t* ids=base+HEADER_SIZE;
+        uint8_t first=id.data()[0];
+        uint32_t lo=first==0?0:static_cast<uint32_t>(readBE(fanout+(first-1)*4,4));
+        uint32_t hi=static_cast<uint32_t>(readBE(fanout+first*4,4));
+        while(lo<hi){
+            uint32_t mid=lo+(hi-lo)/2;
+            int cmp=std::memcmp(ids+static_cast<size_t>(mid)*ObjectId::RAW_LENGTH,id.data(),ObjectId::RAW_LENGTH);
+            if(cmp==0)return mid;
+            if(cmp<0)lo=mid+1;
+            else hi=mid;
+        }
+    }
+    auto it=log_map.find(id);
+    return it==log_map.end()?NONE:it->second;
+}
+
+CommitGraph::Node CommitGraph::node(uint32_t index) const {
+    if(index>=count){
+        return log_nodes[index-count];
+    }
+    const uint8_t* p=reinterpret_cast<const uint8_t*>(mapped->data())+HEADER_SIZE
+                    +static_cast<size_t>(count)*ObjectId::RAW_LENGTH+static_cast<size_t>(index)*RECORD_SIZE;
+    Node result;
+    result.parents[0]=static_cast<uint32_t>(readBE(p,4));
+    result.parents[1]=static_cast<uint32_t>(readBE(p+4,4));
+    result.generation=static_cast<uint32_t>(readBE(p+8,4));
+    result.timestamp=static_cast<std::time_t>(readBE(p+12,8));
+    return result;
+}
+
+ObjectId CommitGraph::idAt(uint32_t index) const {
+    if(index>=count){
+        return log_ids[index-count];
+    }
+    return ObjectId::fromRaw(reinterpret_cast<const uint8_t*>(mapped->data())+HEADER_SIZE+static_cast<size_t>(index)*ObjectId::RAW_LENGTH);
+}
+
+uint32_t CommitGraph::require(const ObjectId& id){
+    uint32_t index=load()?find(id):NONE;
+    if(index==NONE){
+        // 旧版本或其他途径写入、没有记进图里的commit：重建一次
+        rebuild();
+        index=load()?find(id):NONE;
+        if(index==NONE){
+            throw GitliteException("Commit not found: "+id.toHex());
+        }
+    }
+    return index;
+}
+
+void CommitGraph::append(const Commit& commit){
+    if(!load())return;
+    if(find(commit.getId())!=NONE)return;
+
+    const auto& parents=commit.getParents();
+    ObjectId parent_ids[2];
+    uint32_t generation=1;
+    for(size_t k=0;k<parents.size()&&k<2;k++){
+        if(parents[k].isNull())continue;
+        uint32_t parent=find(parents[k]);
+        if(parent==NONE){
+            // 图已经不完整，删掉等下次查询时重建
+            unload();
+            std::remove(graph_file.c_str());
+            std::remove(log_file.c_str());
+            return;
+        }
+        parent_ids[k]=parents[k];
+        generation=std::max(generation,node(parent).generation+1);
+    }
+
+    std::string record;
+    appendId(record,commit.getId());
+    appendId(record,parent_ids[0]);
+    appendId(record,parent_ids[1]);
+    appendBE(record,generation,4);
+    appendBE(record,static_cast<uint64_t>(commit.getTimestamp()),8);
+    {
+        std::ofstream out(log_file,std::ios::binary|std::ios::app);
+        out.write(record.data(),record.size());
+    }
+    unload();
+
+    struct stat st;
+    if(stat(log_file.c_str(),&st)==0
+     &&static_cast<size_t>(st.st_size)/LOG_RECORD_SIZE>COMPACT_THRESHOLD){
+        rebuild();
+    }
+}
+
+size_t CommitGraph::rebuild(){
+    struct Item{
+        ObjectId id;
+        ObjectId parents[2];
+        std::time_t timestamp;
+    };
+    std::vector<Item> items;
+    catalog.forEach([&](const CommitCatalog::Entry& entry){
+        items.push_back({entry.id,{entry.parents[0],entry.parents[1]},entry.timestamp});
+    });
+    std::sort(items.begin(),items.end(),[](const Item& a,const Item& b){return a.id<b.id;});
+    items.erase(std::unique(items.begin(),items.end(),[](const Item& a,const Item& b){return a.id==b.id;}),items.end());
+
+    size_t n=items.size();
+    auto indexOf=[&](const ObjectId& id){
+        if(id.isNull())return NONE;
+        auto it=std::lower_bound(items.begin(),items.end(),id,[](const Item& item,const ObjectId& key){return item.id<key;});
+        return it!=items.end()&&it->id==id?static_cast<uint32_t>(it-items.begin()):NONE;
+    };
+    std::vector<uint32_t> parents(2*n);
+    for(size_t i=0;i<n;i++){
+        parents[2*i]=indexOf(items[i].parents[0]);
+        parents[2*i+1]=indexOf(items[i].parents[1]);
+    }
+
+    // 世代号：非递归的后序遍历，父commit都算完后才算自己
+    std::vector<uint32_t> generation(n,0);
+    std::vector<uint32_t> stack;
+    for(size_t start=0;start<n;start++){
+        if(generation[start]!=0)continue;
+        stack.push_back(static_cast<uint32_t>(start));
+        while(!stack.empty()){
+            uint32_t top=stack.back();
+            bool ready=true;
+            uint32_t g=1;
+            for(int k=0;k<2;k++){
+                uint32_t parent=parents[2*top+k];
+                if(parent==NONE)continue;
+                if(generation[parent]==0){
+                    ready=false;
+                    stack.push_back(parent);
+                }
+                else{
+                    g=std::max(g,generation[parent]+1);
+                }
+            }
+            if(ready){
+                generation[top]=g;
+                stack.pop_back();
+            }
+            else if(stack.size()>2*n+2){
+                throw GitliteException("Commit history contains a cycle");
+            }
+        }
+    }
+
+    std::string data=GRAPH_MAGIC;
+    data.reserve(HEADER_SIZE+n*(ObjectId::RAW_LENGTH+RECORD_SIZE));
+    appendBE(data,n,4);
+    size_t next=0;
+    for(int b=0;b<256;b++){
+        while(next<n&&items[next].id.data()[0]<=b)next++;
+        appendBE(data,next,4);
+    }
+    for(const auto& item:items){
+        appendId(data,item.id);
+    }
+    for(size_t i=0;i<n;i++){
+        appendBE(data,parents[2*i],4);
+        appendBE(data,parents[2*i+1],4);
+        appendBE(data,generation[i],4);
+        appendBE(data,static_cast<uint64_t>(items[i].timestamp),8);
+    }
+
+    // 先写临时文件再rename，然后才删日志；中途失败最多让日志里的commit重复一次
+    unload();
+    std::string tmp_file=graph_file+".tmp";
+    Utils::writeContents(tmp_file,data);
+    std::rename(tmp_file.c_str(),graph_file.c_str());
+    std::remove(log_file.c_str());
+    return n;
+}
+
+ObjectId CommitGraph::mergeBase(const ObjectId& a,const ObjectId& b){
+    if(a.isNull()||b.isNull())return ObjectId();
+    if(a==b)return a;
+    // 查第二个时可能重建，序号会变，所以第一个再查一遍
+    require(a);
+    uint32_t ib=require(b);
+    uint32_t ia=require(a);
+
+    // 按世代号从大到小往下涂色：同时带上两边标记的第一个commit就是最近的公共祖先。
+    // 后代的世代号更大，轮到一个commit时所有能到达它的后代都已经处理完，标记不会再变
+    typedef std::pair<std::pair<uint32_t,std::time_t>,uint32_t> Item;
+    std::priority_queue<Item> queue;
+    std::unordered_map<uint32_t,uint8_t> flags;
+    auto paint=[&](uint32_t index,uint8_t flag){
+        uint8_t& current=flags[index];
+        if((current|flag)==current)return;
+        current|=flag;
+        Node n=node(index);
+        queue.push({{n.generation,n.timestamp},index});
+    };
+    paint(ia,FROM_A);
+    paint(ib,FROM_B);
+    while(!queue.empty()){
+        uint32_t index=queue.top().second;
+        queue.pop();
+        uint8_t flag=flags[index];
+        if(flag==(FROM_A|FROM_B)){
+            return idAt(index);
+        }
+        Node n=node(index);
+        for(uint32_t parent:n.parents){
+            if(parent!=NONE)paint(parent,flag);
+        }
+    }
+    return ObjectId();
+}
+
+bool CommitGraph::isAncestor(const ObjectId& ancestor,const ObjectId& descendant){
+    if(ancestor.isNull()||descendant.isNull())return false;
+    if(ancestor==descendant)return true;
+    require(ancestor);
+    uint32_t start=require(descendant);
+    uint32_t target=require(ancestor);
+
+    // 世代号不大于目标的commit不可能是目标的后代，不往下走
+    uint32_t floor=node(target).generation;
+    std::vector<uint32_t> stack{start};
+    std::unordered_map<uint32_t,bool> visited;
+    while(!stack.empty()){
+        uint32_t index=stack.back();
+        stack.pop_back();
+        if(index==target)return true;
+        if(!visited.emplace(index,true).second)continue;
+        Node n=node(index);
+        if(n.generation<=floor)continue;
+        for(uint32_t parent:n.parents){
+            if(parent!=NONE)stack.push_back(parent);
+        }
+    }
+    return false;
+}
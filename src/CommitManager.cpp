@@ -2,6 +2,8 @@
 #include"../include/RepositoryCore.h"
 #include"../include/Utils.h"
 #include"../include/Blob.h"
+#include"../include/DirectoryWalker.h"
+#include"../include/Tree.h"
 #include"../include/GitliteException.h"
 #include<algorithm>
 #include<fstream>
@@ -24,29 +26,21 @@ void CommitManager::commit(const std::string& message){
         Utils::exitWithMessage("No changes added to the commit.");
     }
 
-    std::vector<std::string> parents;
-    std::string currentCommitId=getCurrentCommitId();
-    if(!currentCommitId.empty()){
+    std::vector<ObjectId> parents;
+    ObjectId currentCommitId=getCurrentCommitId();
+    if(!currentCommitId.isNull()){
         parents.push_back(currentCommitId);
     }
 
-    std::map<std::string,std::string> newBlobs;
-    if(!currentCommitId.empty()){
-        newBlobs=getCommit(currentCommitId).getBlobs();
-    }
-
-    for(const auto& entry:stagingMap){
-        newBlobs[entry.first]=entry.second;
-    }
-
-    // 从新commit中移除被标记删除的文件
+    // 只有暂存和标记删除的文件是改动，其余子树沿用父commit的tree
+    std::map<std::string,ObjectId> changes(stagingMap.begin(),stagingMap.end());
     for(const auto& filename: removedFiles){
-        newBlobs.erase(filename);
+        changes[filename]=ObjectId();
     }
 
     // 创建并保存新的commit对象
     std::time_t now = std::time(nullptr);
-    Commit newCommit(message, now, parents, newBlobs);
+    Commit newCommit(message, now, parents, buildTree(currentCommitId,changes));
     saveCommit(newCommit);
 
     // 更新当前分支指向新的commit
@@ -59,7 +53,7 @@ void CommitManager::commit(const std::string& message){
     for(const auto& filename:removedFiles){
         if(Utils::exists(filename)){
             try{
-                remove(filename.c_str());
+                Utils::removeWorkingFile(filename);
             }catch(...){
                 Utils::exitWithMessage("Failed to remove file: "+filename);
             }
@@ -68,156 +62,152 @@ void CommitManager::commit(const std::string& message){
 }
 
 void CommitManager::saveCommit(const Commit& commit){
-    std::string commit_path=Utils::join(".gitlite/objects",commit.getId());
-    Utils::writeContents(commit_path,commit.serialize());
+    bool fresh=!core->getObjectStore().exists(commit.getId());
+    core->getObjectStore().write(commit.getId(),commit.serialize(),OBJ_COMMIT);
+    if(fresh){
+        core->getCommitCatalog().append(commit);
+        core->getCommitGraph().append(commit);
+    }
 }
 
-Commit CommitManager::getCommit(const std::string& id){
-    std::string full_id=getFullCommitId(id); 
-    if(full_id.empty()){
-        throw GitliteException("Commit not found: "+id); 
+ObjectId CommitManager::buildTree(const ObjectId& baseCommitId,const std::map<std::string,ObjectId>& changes){
+    const ObjectStore& store=core->getObjectStore();
+    if(baseCommitId.isNull()){
+        return Tree::update(store,ObjectId(),changes);
+    }
+    auto base=getCommit(baseCommitId);
+    if(!base->getTree().isNull()){
+        return Tree::update(store,base->getTree(),changes);
+    }
+
+    std::map<std::string,ObjectId> files=base->getBlobs().toMap();
+    for(const auto& change:changes){
+        if(change.second.isNull()){
+            files.erase(change.first);
+        }
+        else{
+            files[change.first]=change.second;
+        }
     }
+    return Tree::update(store,ObjectId(),files);
+}
 
-    std::string commit_file=Utils::join(".gitlite/objects",full_id);
-    return Commit::fromFile(commit_file);
+std::shared_ptr<const Commit> CommitManager::getCommit(const ObjectId& id){
+    // 经过RepositoryCore的缓存，同一条命令里重复访问的commit只解析一次
+    return core->getCommit(id);
 }   
 
 void CommitManager::log(){
-    std::string current_commit_id=getCurrentCommitId();
+    ObjectId current_commit_id=getCurrentCommitId();
     bool first_commit=true;
 
-    while(!current_commit_id.empty()){
+    while(!current_commit_id.isNull()){
         if(!first_commit){
             std::cout<<std::endl;
         }
         first_commit=false;
 
-        Commit commit=getCommit(current_commit_id); 
+        auto commit=getCommit(current_commit_id); 
 
         std::cout<<"===\n";
-        std::cout<<"commit "<<commit.getId()<<"\n";
+        std::cout<<"commit "<<commit->getId().toHex()<<"\n";
 
         // 如果是merge commit，显示父commit信息
-        if(commit.isMergeCommit()){
-            auto parents=commit.getParents();
+        if(commit->isMergeCommit()){
+            const auto& parents=commit->getParents();
             std::cout<<"Merge: "
-            <<parents[0].substr(0,7)<<" " 
-            <<parents[1].substr(0,7)<<"\n";
+            <<parents[0].toShortHex()<<" " 
+            <<parents[1].toShortHex()<<"\n";
         }
 
-        std::cout<<"Date: "<<commit.getFormattedTimestamp()<<"\n"; 
-        std::cout<<commit.getMessage()<<"\n";                        
+        std::cout<<"Date: "<<commit->getFormattedTimestamp()<<"\n"; 
+        std::cout<<commit->getMessage()<<"\n";                        
 
         // 移动到父commit
-        auto parents=commit.getParents();
-        current_commit_id=parents.empty()?"":parents[0];
+        const auto& parents=commit->getParents();
+        current_commit_id=parents.empty()?ObjectId():parents[0];
     }
 }
 
 void CommitManager::globalLog(){
-    auto all_commits=Utils::plainFilenamesIn(".gitlite/objects");
     bool first_commit=true;
 
-    // 遍历所有对象，筛选出commit文件
-    for(const auto& commit_id:all_commits){
-        if(commit_id.length()==Utils::UID_LENGTH){
-            try{
-                if(!first_commit){
-                    std::cout<<std::endl; 
-                }
-                first_commit=false;
-
-                Commit commit=getCommit(commit_id);
-                std::cout<<"===\n";
-                std::cout<<"commit "<<commit.getId()<<"\n";
-
-                if(commit.isMergeCommit()){
-                    auto parents=commit.getParents();
-                    std::cout<<"Merge: "
-                    <<parents[0].substr(0,7)<<" "
-                    <<parents[1].substr(0,7)<<"\n";
-                }
-
-                std::cout<<"Date: "<<commit.getFormattedTimestamp()<<"\n";
-                std::cout<<commit.getMessage()<<"\n";
-            }catch(...){
-                continue;
-            }
+    // 顺序读commit目录，不需要打开任何对象文件
+    core->getCommitCatalog().forEach([&](const CommitCatalog::Entry& entry){
+        if(!first_commit){
+            std::cout<<"\n";
         }
-    }
-}
+        first_commit=false;
 
-void CommitManager::find(const std::string& commitMessage){
-    auto all_commits=Utils::plainFilenamesIn(".gitlite/objects");
-    bool found=false;
+        std::cout<<"===\n";
+        std::cout<<"commit "<<entry.id.toHex()<<"\n";
 
-    for(const auto& commit_id:all_commits){
-        if(commit_id.length()==Utils::UID_LENGTH){ 
-            try{
-                Commit commit=getCommit(commit_id);
-                if(commit.getMessage()==commitMessage){
-                    found=true;
-                    std::cout<<commit.getId()<<"\n"; 
-                }
-            }catch(...){
-                continue;
-            }
+        if(entry.isMergeCommit()){
+            std::cout<<"Merge: "
+            <<entry.parents[0].toShortHex()<<" "
+            <<entry.parents[1].toShortHex()<<"\n";
         }
+
+        std::cout<<"Date: "<<Commit::formatTimestamp(entry.timestamp)<<"\n";
+        std::cout<<entry.message<<"\n";
+    });
+}
+
+void CommitManager::find(const std::string& query,CommitCatalog::MatchMode mode){
+    // 由信息索引给出候选，不需要逐条比较全部commit
+    auto matches=core->getCommitCatalog().find(query,mode);
+    for(const auto& id:matches){
+        std::cout<<id.toHex()<<"\n";
     }
 
-    if(!found){
+    if(matches.empty()){
         Utils::exitWithMessage("Found no commit with that message.");
     }
 }
 
-std::string CommitManager::getFileBlobId(const std::string& filename,const std::string& commitId){
-    if(commitId.empty()){
-        return "";  
+ObjectId CommitManager::getFileBlobId(const std::string& filename,const ObjectId& commitId){
+    if(commitId.isNull()){
+        return ObjectId();  
     }
 
-    Commit commit=getCommit(commitId);
-    auto blobs=commit.getBlobs();     
-    if(blobs.count(filename)){        
-        return blobs[filename];       
-    }
-    return ""; 
+    auto commit=getCommit(commitId);
+    return commit->getBlobId(filename); 
 }
-bool CommitManager::fileExistsInCommit(const std::string& filename,const std::string& commitId){
-    return !getFileBlobId(filename,commitId).empty();  // blob ID非空即为存在
+bool CommitManager::fileExistsInCommit(const std::string& filename,const ObjectId& commitId){
+    return !getFileBlobId(filename,commitId).isNull();  // blob ID非空即为存在
 }
 
-std::string CommitManager::getCurrentCommitId(){
+ObjectId CommitManager::getCurrentCommitId(){
     return core->getBranchHead(core->getCurrentBranch());
 }
 
-void CommitManager::copyFileFromCommit(const std::string& filename,const std::string& commitId){
-    std::string blob_id=getFileBlobId(filename,commitId);
-    if(blob_id.empty()){
+void CommitManager::copyFileFromCommit(const std::string& filename,const ObjectId& commitId){
+    ObjectId blob_id=getFileBlobId(filename,commitId);
+    if(blob_id.isNull()){
         return ;
     }
 
-    Blob blob=Blob::load(".gitlite/objects",blob_id);     
-    Utils::writeContents(filename,blob.getContent());     
+    Blob::writeToFile(core->getObjectStore(),blob_id,filename);     
 }
 
-std::map<std::string,std::string> CommitManager::getTrackedFiles(const std::string& commitId){
-    if(commitId.empty()){
+BlobTable CommitManager::getTrackedFiles(const ObjectId& commitId){
+    if(commitId.isNull()){
         return {};
     }
 
-    Commit commit=getCommit(commitId);
-    return commit.getBlobs();           
+    auto commit=getCommit(commitId);
+    return commit->getBlobs();           
 }
 
-Commit CommitManager::getHeadCommit(){
-    std::string current_commit_id=getCurrentCommitId();
+std::shared_ptr<const Commit> CommitManager::getHeadCommit(){
+    ObjectId current_commit_id=getCurrentCommitId();
     return getCommit(current_commit_id);                
 }
 
-std::vector<std::string> CommitManager::getFiles(const std::string& commitId){
+std::vector<std::string> CommitManager::getFiles(const ObjectId& commitId){
     std::vector<std::string> files;
-    Commit commit=getCommit(commitId);     
-    auto blobs=commit.getBlobs();           
+    auto commit=getCommit(commitId);     
+    const auto& blobs=commit->getBlobs();           
 
     for(const auto& blob:blobs){
         files.push_back(blob.first);        
@@ -227,33 +217,38 @@ std::vector<std::string> CommitManager::getFiles(const std::string& commitId){
 }
 
 // 找缩写
-std::string CommitManager::getFullCommitId(const std::string& id){
-    if(id.empty())return "";
-    auto all_commits=Utils::plainFilenamesIn(".gitlite/objects"); 
-    std::string match;
+ObjectId CommitManager::getFullCommitId(const std::string& id){
+    if(id.empty())return ObjectId();
+    const ObjectStore& store=core->getObjectStore();
+    if(ObjectId::isValidHex(id)){
+        ObjectId full_id=ObjectId::fromHex(id);
+        return store.exists(full_id)?full_id:ObjectId();
+    }
+
+    // 缩写ID走前缀索引二分查找
+    auto all_commits=store.resolvePrefix(id); 
+    ObjectId match;
     for(const auto& commit_id:all_commits){
-        if(commit_id.length()==Utils::UID_LENGTH&&commit_id.find(id)==0){
-            if(!match.empty()){
-                Utils::exitWithMessage("Ambiguous commit id: "+id); 
-            }
-            match=commit_id;
+        if(!match.isNull()){
+            Utils::exitWithMessage("Ambiguous commit id: "+id); 
         }
+        match=commit_id;
     }
 
     return match;  
 }
 
 void CommitManager::reset(const std::string& commitId){
-    std::string full_commit_id=getFullCommitId(commitId);
-    if(full_commit_id.empty()){
+    ObjectId full_commit_id=getFullCommitId(commitId);
+    if(full_commit_id.isNull()){
         Utils::exitWithMessage("No commit with that id exists.");
     }
 
-    std::string current_commit_id=getCurrentCommitId();  
+    ObjectId current_commit_id=getCurrentCommitId();  
     auto current_blobs=getTrackedFiles(current_commit_id); 
     auto target_blobs=getTrackedFiles(full_commit_id);     
 
-    auto working_files=Utils::plainFilenamesIn(".");
+    auto working_files=DirectoryWalker::listFiles(".");
     for(const auto& filename:working_files){
         if(!current_blobs.count(filename)&&target_blobs.count(filename))
             Utils::exitWithMessage("There is an untracked file in the way; delete it, or add and commit it first.");
@@ -262,7 +257,7 @@ void CommitManager::reset(const std::string& commitId){
     // 删除当前commit有但目标commit没有的文件
     for(const auto& current_blob:current_blobs){
         if(!target_blobs.count(current_blob.first)){
-            remove(current_blob.first.c_str());
+            Utils::removeWorkingFile(current_blob.first);
         }
     }
 
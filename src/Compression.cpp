@@ -0,0 +1,196 @@
+#include"../include/Compression.h"
+#include"../include/GitliteException.h"
+#include"../include/Utils.h"
+#include<cstdint>
+#include<cstring>
+#include<vector>
+
+namespace {
+    const size_t MIN_MATCH=4;
+    const size_t LAST_LITERALS=5;   // 块末尾至少这么多字节必须是字面数据
+    const size_t MF_LIMIT=12;       // 最后一个匹配必须在距末尾这么多字节之前开始
+    const size_t MAX_OFFSET=65535;
+    const int HASH_LOG=12;
+
+    uint32_t read32(const char* p){
+        uint32_t v;
+        std::memcpy(&v,p,4);
+        return v;
+    }
+
+    uint32_t hash4(uint32_t v){
+        return (v*2654435761U)>>(32-HASH_LOG);
+    }
+
+    void putLength(std::string& out,size_t length){
+        while(length>=255){
+            out.push_back(static_cast<char>(255));
+            length-=255;
+        }
+        out.push_back(static_cast<char>(length));
+    }
+
+    bool getLength(const uint8_t* src,size_t srcLength,size_t& ip,size_t& length){
+        uint8_t b;
+        do{
+            if(ip>=srcLength)return false;
+            b=src[ip++];
+            length+=b;
+        }while(b==255);
+        return true;
+    }
+
+    // 输出一个序列：字面数据[anchor,anchor+literals)，之后是(offset,matchLength)的匹配
+    void putSequence(std::string& out,const char* literals,size_t literalLength,size_t offset,size_t matchLength){
+        size_t token_pos=out.size();
+        out.push_back(0);
+        uint8_t token=static_cast<uint8_t>((literalLength<15?literalLength:15)<<4);
+        if(literalLength>=15)putLength(out,literalLength-15);
+        out.append(literals,literalLength);
+
+        if(matchLength>0){
+            out.push_back(static_cast<char>(offset&0xff));
+            out.push_back(static_cast<char>(offset>>8));
+            size_t ml=matchLength-MIN_MATCH;
+            token|=static_cast<uint8_t>(ml<15?ml:15);
+            if(ml>=15)putLength(out,ml-15);
+        }
+        out[token_pos]=static_cast<char>(token);
+    }
+}
+
+std::string Compression::lz4Compress(const char* src,size_t length){
+    std::string out;
+    out.reserve(length+length/255+16);
+    size_t anchor=0;
+
+    if(length>=MF_LIMIT+1){
+        std::vector<uint32_t> table(size_t(1)<<HASH_LOG,0);
+        size_t limit=length-MF_LIMIT;
+        size_t match_limit=length-LAST_LITERALS;
+        size_t ip=1;
+        size_t misses=0;
+        table[hash4(read32(src))]=0;
+
+        while(ip<limit){
+            uint32_t h=hash4(read32(src+ip));
+            size_t ref=table[h];
+            table[h]=static_cast<uint32_t>(ip);
+            if(ref>=ip||ip-ref>MAX_OFFSET||read32(src+ref)!=read32(src+ip)){
+                // 连续找不到匹配时加大步长，不可压缩的数据很快就能扫过去
+                ip+=1+(misses++>>6);
+                continue;
+            }
+            misses=0;
+
+            while(ip>anchor&&ref>0&&src[ip-1]==src[ref-1]){
+                ip--;
+                ref--;
+            }
+            size_t match_length=MIN_MATCH;
+            while(ip+match_length<match_limit&&src[ref+match_length]==src[ip+match_length]){
+                match_length++;
+            }
+
+            putSequence(out,src+anchor,ip-anchor,ip-ref,match_length);
+            ip+=match_length;
+            anchor=ip;
+            if(ip<limit){
+                table[hash4(read32(src+ip-2))]=static_cast<uint32_t>(ip-2);
+            }
+        }
+    }
+    putSequence(out,src+anchor,length-anchor,0,0);
+    return out;
+}
+
+bool Compression::lz4Decompress(const char* source,size_t srcLength,char* dst,size_t dstLength){
+    const uint8_t* src=reinterpret_cast<const uint8_t*>(source);
+    size_t ip=0;
+    size_t op=0;
+    while(true){
+        if(ip>=srcLength)return false;
+        uint8_t token=src[ip++];
+
+        size_t literal_length=token>>4;
+        if(literal_length==15&&!getLength(src,srcLength,ip,literal_length))return false;
+        if(literal_length>srcLength-ip||literal_length>dstLength-op)return false;
+        std::memcpy(dst+op,src+ip,literal_length);
+        ip+=literal_length;
+        op+=literal_length;
+
+        // 最后一个序列只有字面数据
+        if(ip==srcLength)return op==dstLength;
+
+        if(srcLength-ip<2)return false;
+        size_t offset=src[ip]|(size_t(src[ip+1])<<8);
+        ip+=2;
+        if(offset==0||offset>op)return false;
+
+        size_t match_length=token&15;
+        if(match_length==15&&!getLength(src,srcLength,ip,match_length))return false;
+        match_length+=MIN_MATCH;
+        if(match_length>dstLength-op)return false;
+
+        // 匹配可能和输出重叠（offset小于长度时是重复模式），只能逐字节复制
+        if(offset>=match_length){
+            std::memcpy(dst+op,dst+op-offset,match_length);
+        }
+        else{
+            for(size_t i=0;i<match_length;i++){
+                dst[op+i]=dst[op-offset+i];
+            }
+        }
+        op+=match_length;
+    }
+}
+
+void Compression::appendFrame(std::string& out,const char* raw,size_t length){
+    std::string packed=lz4Compress(raw,length);
+    if(packed.size()<length){
+        Utils::appendVarint(out,uint64_t(packed.size())<<1);
+        out+=packed;
+    }
+    else{
+        Utils::appendVarint(out,(uint64_t(length)<<1)|1);
+        out.append(raw,length);
+    }
+}
+
+std::string Compression::compressFrames(const std::string& raw){
+    std::string out;
+    for(size_t pos=0;pos<raw.size();pos+=FRAME_SIZE){
+        size_t frame_length=raw.size()-pos<FRAME_SIZE?raw.size()-pos:FRAME_SIZE;
+        appendFrame(out,raw.data()+pos,frame_length);
+    }
+    return out;
+}
+
+std::string Compression::decompressFrames(std::string_view data,size_t pos,size_t rawLength){
+    std::string raw(rawLength,'\0');
+    for(size_t offset=0;offset<rawLength;offset+=FRAME_SIZE){
+        size_t frame_length=rawLength-offset<FRAME_SIZE?rawLength-offset:FRAME_SIZE;
+        uint64_t tag;
+        if(!Utils::readVarint(data,pos,tag)){
+            throw GitliteException("Corrupt compressed object: bad frame header");
+        }
+        uint64_t stored=tag>>1;
+        if(stored>data.size()-pos){
+            throw GitliteException("Corrupt compressed object: truncated frame");
+        }
+        if(tag&1){
+            if(stored!=frame_length){
+                throw GitliteException("Corrupt compressed object: bad frame length");
+            }
+            std::memcpy(&raw[offset],data.data()+pos,frame_length);
+        }
+        else if(!lz4Decompress(data.data()+pos,stored,&raw[offset],frame_length)){
+            throw GitliteException("Corrupt compressed object: bad frame data");
+        }
+        pos+=stored;
+    }
+    if(pos!=data.size()){
+        throw GitliteException("Corrupt compressed object: trailing data");
+    }
+    return raw;
+}
@@ -0,0 +1,84 @@
+#include"../include/Config.h"
+#include"../include/Utils.h"
+#include<sstream>
+#include<vector>
+
+namespace {
+    struct KeyInfo{
+        std::string default_value;
+        std::vector<std::string> allowed;
+    };
+
+    // 支持的配置项、默认值及可选值；没有可选值的配置项取非负整数
+    const std::map<std::string,KeyInfo> KNOWN_KEYS={
+        {"core.chunking",{"auto",{"auto","off"}}},
+        {"core.compression",{"lz4",{"none","lz4"}}},
+        {"gc.graceperiod",{"1209600",{}}},
+    };
+}
+
+Config::Config(const std::string& gitliteDir) : config_file(Utils::join(gitliteDir,"config")){
+    reload();
+}
+
+void Config::reload(){
+    values.clear();
+    if(!Utils::isFile(config_file))return;
+
+    std::istringstream iss(Utils::readContentsAsString(config_file));
+    std::string line;
+    while(std::getline(iss,line)){
+        size_t pos=line.find('=');
+        if(line.empty()||line[0]=='#'||pos==std::string::npos)continue;
+        values[line.substr(0,pos)]=line.substr(pos+1);
+    }
+}
+
+bool Config::has(const std::string& key) const {
+    return values.count(key)>0;
+}
+
+std::string Config::get(const std::string& key,const std::string& defaultValue) const {
+    auto it=values.find(key);
+    return it==values.end()?defaultValue:it->second;
+}
+
+void Config::set(const std::string& key,const std::string& value){
+    values[key]=value;
+    std::string content;
+    for(const auto& entry:values){
+        content+=entry.first+"="+entry.second+"\n";
+    }
+    Utils::writeContents(config_file,content);
+}
+
+bool Config::isKnownKey(const std::string& key){
+    return KNOWN_KEYS.count(key)>0;
+}
+
+std::string Config::defaultValue(const std::string& key){
+    auto it=KNOWN_KEYS.find(key);
+    return it==KNOWN_KEYS.end()?"":it->second.default_value;
+}
+
+std::string Config::validate(const std::string& key,const std::string& value){
+    auto it=KNOWN_KEYS.find(key);
+    if(it==KNOWN_KEYS.end()){
+        return "Unknown config key: "+key;
+    }
+    if(it->second.allowed.empty()){
+        bool digits=!value.empty()&&value.size()<=18;
+        for(char c:value){
+            if(c<'0'||c>'9')digits=false;
+        }
+        return digits?"":"Invalid value for "+key+" (expected a non-negative integer).";
+    }
+    for(const auto& allowed:it->second.allowed){
+        if(value==allowed)return "";
+    }
+    std::string choices;
+    for(const auto& allowed:it->second.allowed){
+        choices+=(choices.empty()?"":"|")+allowed;
+    }
+    return "Invalid value for "+key+" (expected "+choices+").";
+}
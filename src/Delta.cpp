@@ -0,0 +1,176 @@
+#include"../include/Delta.h"
+#include"../include/GitliteException.h"
+#include"../include/Utils.h"
+#include<algorithm>
+#include<cstdint>
+#include<cstring>
+#include<unordered_map>
+
+namespace {
+    const uint8_t OP_COPY=0x80;
+    const size_t MAX_INSERT=0x7f;
+
+    uint64_t getVarint(const std::string& in,size_t& pos){
+        uint64_t v;
+        if(!Utils::readVarint(in,pos,v)){
+            throw GitliteException("Corrupt delta: bad varint");
+        }
+        return v;
+    }
+
+    // 一个块的指纹：两个8字节各乘一个奇数常量后异或
+    uint64_t blockHash(const char* p){
+        uint64_t a,b;
+        std::memcpy(&a,p,8);
+        std::memcpy(&b,p+8,8);
+        return a*0x9E3779B97F4A7C15ULL^b*0xC2B2AE3D27D4EB4FULL;
+    }
+
+    void flushInsert(std::string& out,const char* data,size_t length){
+        while(length>0){
+            size_t n=length<MAX_INSERT?length:MAX_INSERT;
+            out.push_back(static_cast<char>(n));
+            out.append(data,n);
+            data+=n;
+            length-=n;
+        }
+    }
+}
+
+std::string Delta::create(const std::string& base,const std::string& target){
+    std::string out;
+    Utils::appendVarint(out,base.size());
+    Utils::appendVarint(out,target.size());
+
+    // 只给基准中按BLOCK_SIZE对齐的块建索引，同一指纹保留第一次出现的位置
+    std::unordered_map<uint64_t,size_t> blocks;
+    if(base.size()>=BLOCK_SIZE){
+        blocks.reserve(base.size()/BLOCK_SIZE);
+        for(size_t i=0;i+BLOCK_SIZE<=base.size();i+=BLOCK_SIZE){
+            blocks.emplace(blockHash(base.data()+i),i);
+        }
+    }
+
+    const char* t=target.data();
+    size_t n=target.size();
+    size_t pos=0;
+    size_t literal_start=0;     // 还没输出的字面数据起点
+    while(pos+BLOCK_SIZE<=n&&!blocks.empty()){
+        auto it=blocks.find(blockHash(t+pos));
+        if(it==blocks.end()||std::memcmp(base.data()+it->second,t+pos,BLOCK_SIZE)!=0){
+            pos++;
+            continue;
+        }
+
+        // 命中后尽量向前、向后扩展
+        size_t base_start=it->second;
+        size_t target_start=pos;
+        while(base_start>0&&target_start>literal_start&&base[base_start-1]==t[target_start-1]){
+            base_start--;
+            target_start--;
+        }
+        size_t base_end=it->second+BLOCK_SIZE;
+        size_t target_end=pos+BLOCK_SIZE;
+        while(base_end<base.size()&&target_end<n&&base[base_end]==t[target_end]){
+            base_end++;
+            target_end++;
+        }
+
+        flushInsert(out,t+literal_start,target_start-literal_start);
+        out.push_back(static_cast<char>(OP_COPY));
+        Utils::appendVarint(out,base_start);
+        Utils::appendVarint(out,target_end-target_start);
+        pos=target_end;
+        literal_start=pos;
+    }
+    flushInsert(out,t+literal_start,n-literal_start);
+    return out;
+}
+
+std::string Delta::apply(const std::string& base,const std::string& delta){
+    size_t pos=0;
+    uint64_t base_size=getVarint(delta,pos);
+    uint64_t result_size=getVarint(delta,pos);
+    if(base_size!=base.size()){
+        throw GitliteException("Corrupt delta: base size mismatch");
+    }
+
+    std::string result;
+    result.reserve(result_size);
+    while(pos<delta.size()){
+        uint8_t op=static_cast<uint8_t>(delta[pos++]);
+        if(op==OP_COPY){
+            uint64_t offset=getVarint(delta,pos);
+            uint64_t length=getVarint(delta,pos);
+            if(offset>base.size()||length>base.size()-offset){
+                throw GitliteException("Corrupt delta: copy out of range");
+            }
+            result.append(base,offset,length);
+        }
+        else if(op>0&&op<=MAX_INSERT){
+            if(op>delta.size()-pos){
+                throw GitliteException("Corrupt delta: truncated insert");
+            }
+            result.append(delta,pos,op);
+            pos+=op;
+        }
+        else{
+            throw GitliteException("Corrupt delta: unknown opcode");
+        }
+    }
+    if(result.size()!=result_size){
+        throw GitliteException("Corrupt delta: result size mismatch");
+    }
+    return result;
+}
+
+std::string Delta::applyRange(const std::string& delta,uint64_t offset,uint64_t length,
+                              const std::function<std::string(uint64_t,uint64_t)>& readBase){
+    size_t pos=0;
+    uint64_t base_size=getVarint(delta,pos);
+    uint64_t result_size=getVarint(delta,pos);
+    if(offset>=result_size){
+        return "";
+    }
+    uint64_t end=offset+std::min(length,result_size-offset);
+
+    // 逐条指令往后数输出位置，只处理和[offset,end)重叠的部分，过了end就停
+    std::string result;
+    uint64_t out=0;
+    while(pos<delta.size()&&out<end){
+        uint8_t op=static_cast<uint8_t>(delta[pos++]);
+        uint64_t produced;
+        if(op==OP_COPY){
+            uint64_t copy_offset=getVarint(delta,pos);
+            produced=getVarint(delta,pos);
+            if(copy_offset>base_size||produced>base_size-copy_offset){
+                throw GitliteException("Corrupt delta: copy out of range");
+            }
+            if(out+produced>offset){
+                uint64_t from=std::max(offset,out);
+                uint64_t to=std::min(end,out+produced);
+                result+=readBase(copy_offset+(from-out),to-from);
+            }
+        }
+        else if(op>0&&op<=MAX_INSERT){
+            if(op>delta.size()-pos){
+                throw GitliteException("Corrupt delta: truncated insert");
+            }
+            produced=op;
+            if(out+produced>offset){
+                uint64_t from=std::max(offset,out);
+                uint64_t to=std::min(end,out+produced);
+                result.append(delta,pos+(from-out),to-from);
+            }
+            pos+=op;
+        }
+        else{
+            throw GitliteException("Corrupt delta: unknown opcode");
+        }
+        out+=produced;
+    }
+    if(result.size()!=end-offset){
+        throw GitliteException("Corrupt delta: result size mismatch");
+    }
+    return result;
+}
@@ -0,0 +1,120 @@
+#include"../include/DirectoryWalker.h"
+#include"../include/ThreadPool.h"
+#include<algorithm>
+#include<cstring>
+#include<functional>
+#include<iterator>
+#include<mutex>
+#include<dirent.h>
+#include<fcntl.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#ifdef __linux__
+#include<sys/syscall.h>
+#endif
+
+namespace {
+    const char* const SKIP_DIR=".gitlite";
+
+    // 目录项的类型，文件系统不填d_type时用fstatat补上
+    unsigned char entryType(int dirfd,const char* name,unsigned char type){
+        if(type!=DT_UNKNOWN)return type;
+        struct stat st;
+        if(fstatat(dirfd,name,&st,AT_SYMLINK_NOFOLLOW)!=0)return DT_UNKNOWN;
+        if(S_ISREG(st.st_mode))return DT_REG;
+        if(S_ISDIR(st.st_mode))return DT_DIR;
+        return DT_UNKNOWN;
+    }
+
+    // 对fd打开的目录里每一项调用visit(名字, d_type)，不含"."和".."
+    template<typename Visit>
+    void readEntries(int fd,Visit visit){
+#ifdef SYS_getdents64
+        // 和readdir一样是getdents64，但直接用栈上的缓冲区，一次系统调用读回一整块目录项
+        struct Entry{
+            uint64_t ino;
+            int64_t off;
+            unsigned short reclen;
+            unsigned char type;
+            char name[1];
+        };
+        alignas(8) char buffer[32768];
+        while(true){
+            long n=syscall(SYS_getdents64,fd,buffer,sizeof(buffer));
+            if(n<=0)break;
+            for(long pos=0;pos<n;){
+                const Entry* entry=reinterpret_cast<const Entry*>(buffer+pos);
+                pos+=entry->reclen;
+                const char* name=entry->name;
+                if(name[0]=='.'&&(name[1]=='\0'||(name[1]=='.'&&name[2]=='\0')))continue;
+                visit(name,entry->type);
+            }
+        }
+#else
+        int copy=dup(fd);
+        DIR* dir=copy<0?nullptr:fdopendir(copy);
+        if(dir==nullptr){
+            if(copy>=0)close(copy);
+            return;
+        }
+        struct dirent* entry;
+        while((entry=readdir(dir))!=nullptr){
+            const char* name=entry->d_name;
+            if(name[0]=='.'&&(name[1]=='\0'||(name[1]=='.'&&name[2]=='\0')))continue;
+            visit(name,entry->d_type);
+        }
+        closedir(dir);
+#endif
+    }
+}
+
+DirectoryWalker::DirectoryWalker(size_t threads) : threads(threads){}
+
+std::vector<std::string> DirectoryWalker::listFiles(const std::string& root){
+    return DirectoryWalker().walk(root);
+}
+
+std::vector<std::string> DirectoryWalker::walk(const std::string& root) const {
+    std::vector<std::string> files;
+    int root_fd=open(root.c_str(),O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if(root_fd<0){
+        return files;
+    }
+
+    ThreadPool pool(threads);
+    std::mutex files_mutex;
+    // 遍历一个目录（相对root的路径，根目录为空串），子目录各提交一个任务
+    std::function<void(const std::string&)> visitDir=[&](const std::string& dir){
+        int fd=dir.empty()?dup(root_fd):openat(root_fd,dir.c_str(),O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+        if(fd<0)return;
+        std::string prefix=dir.empty()?"":dir+"/";
+        std::vector<std::string> found;
+        readEntries(fd,[&](const char* name,unsigned char type){
+            type=entryType(fd,name,type);
+            if(type==DT_REG){
+                found.push_back(prefix+name);
+            }
+            else if(type==DT_DIR&&std::strcmp(name,SKIP_DIR)!=0){
+                std::string sub=prefix+name;
+                pool.submit([&visitDir,sub]{visitDir(sub);});
+            }
+        });
+        close(fd);
+        if(!found.empty()){
+            std::lock_guard<std::mutex> lock(files_mutex);
+            files.insert(files.end(),std::make_move_iterator(found.begin()),std::make_move_iterator(found.end()));
+        }
+    };
+    pool.submit([&visitDir]{visitDir("");});
+    pool.wait();
+    close(root_fd);
+
+    std::sort(files.begin(),files.end());
+    if(root!="."){
+        std::string prefix=root.back()=='/'?root:root+"/";
+        for(auto& file:files){
+            file.insert(0,prefix);
+        }
+    }
+    return files;
+}
@@ -0,0 +1,119 @@
+#include"../include/EwahBitmap.h"
+#include"../include/GitliteException.h"
+#include"../include/Utils.h"
+#include<algorithm>
+
+namespace {
+    const uint64_t ALL_ONES=~uint64_t(0);
+
+    uint64_t marker(bool runBit,uint64_t run,uint64_t literals){
+        return (runBit?1:0)|(run<<1)|(literals<<33);
+    }
+
+    bool runBit(uint64_t marker){return marker&1;}
+    uint64_t runLength(uint64_t marker){return (marker>>1)&EwahBitmap::MAX_RUN;}
+    uint64_t literalCount(uint64_t marker){return marker>>33;}
+
+    void corrupt(){
+        throw GitliteException("Corrupt bitmap");
+    }
+
+    //按标记字逐段展开，visit(起始字, 字数, 游程值或nullptr表示原样字, 原样字)
+    template<typename Visit>
+    void forEachRun(const std::vector<uint64_t>& words,size_t plainWords,Visit visit){
+        size_t out=0;
+        size_t i=0;
+        while(i<words.size()){
+            uint64_t m=words[i++];
+            uint64_t run=runLength(m);
+            uint64_t literals=literalCount(m);
+            if(run>plainWords-out||literals>words.size()-i||literals>plainWords-out-run)corrupt();
+            if(run>0){
+                visit(out,run,runBit(m)?ALL_ONES:0,nullptr);
+                out+=run;
+            }
+            if(literals>0){
+                visit(out,literals,0,&words[i]);
+                out+=literals;
+                i+=literals;
+            }
+        }
+        if(out!=plainWords)corrupt();
+    }
+}
+
+EwahBitmap::EwahBitmap():plain_words(0){}
+
+EwahBitmap EwahBitmap::compress(const std::vector<uint64_t>& plain){
+    EwahBitmap bitmap;
+    bitmap.plain_words=plain.size();
+    size_t i=0;
+    while(i<plain.size()){
+        // 先吃掉一段全0或全1的字，再收集后面的原样字，直到下一个全0或全1的字
+        bool bit=plain[i]==ALL_ONES;
+        uint64_t run=0;
+        while(i<plain.size()&&(plain[i]==0||plain[i]==ALL_ONES)&&(plain[i]==ALL_ONES)==bit&&run<MAX_RUN){
+            run++;
+            i++;
+        }
+        size_t literal_start=i;
+        while(i<plain.size()&&plain[i]!=0&&plain[i]!=ALL_ONES&&i-literal_start<MAX_LITERALS){
+            i++;
+        }
+        bitmap.words.push_back(marker(bit,run,i-literal_start));
+        bitmap.words.insert(bitmap.words.end(),plain.begin()+literal_start,plain.begin()+i);
+    }
+    return bitmap;
+}
+
+std::vector<uint64_t> EwahBitmap::decompress() const {
+    std::vector<uint64_t> plain(plain_words,0);
+    orInto(plain);
+    return plain;
+}
+
+void EwahBitmap::orInto(std::vector<uint64_t>& plain) const {
+    if(plain.size()<plain_words){
+        plain.resize(plain_words,0);
+    }
+    forEachRun(words,plain_words,[&](size_t start,size_t count,uint64_t fill,const uint64_t* literals){
+        if(literals){
+            for(size_t k=0;k<count;k++){
+                plain[start+k]|=literals[k];
+            }
+        }
+        else if(fill){
+            std::fill(plain.begin()+start,plain.begin()+start+count,fill);
+        }
+    });
+}
+
+void EwahBitmap::serialize(std::string& out) const {
+    Utils::appendVarint(out,plain_words);
+    Utils::appendVarint(out,words.size());
+    for(uint64_t word:words){
+        for(int b=7;b>=0;b--){
+            out.push_back(static_cast<char>(word>>(8*b)));
+        }
+    }
+}
+
+EwahBitmap EwahBitmap::deserialize(std::string_view data,size_t& pos){
+    uint64_t plain,count;
+    if(!Utils::readVarint(data,pos,plain)||!Utils::readVarint(data,pos,count)||count>(data.size()-pos)/8){
+        corrupt();
+    }
+    EwahBitmap bitmap;
+    bitmap.plain_words=plain;
+    bitmap.words.reserve(count);
+    for(uint64_t i=0;i<count;i++){
+        uint64_t word=0;
+        for(int b=0;b<8;b++){
+            word=(word<<8)|static_cast<uint8_t>(data[pos++]);
+        }
+        bitmap.words.push_back(word);
+    }
+    // 先完整走一遍，结构不对的位图在读入时就报错
+    forEachRun(bitmap.words,bitmap.plain_words,[](size_t,size_t,uint64_t,const uint64_t*){});
+    return bitmap;
+}
@@ -3,66 +3,157 @@
 #include"../include/CommitManager.h"
 #include"../include/Utils.h"
 #include"../include/Blob.h"
+#include"../include/DirectoryWalker.h"
+#include"../include/ThreadPool.h"
 #include<algorithm>
+#include<glob.h>
 #include<sstream>
+#include<unordered_set>
 
 FileOperationManager::FileOperationManager(RepositoryCore* repoCore, CommitManager* commitMgr) 
     : core(repoCore), commitManager(commitMgr) {}
 
-void FileOperationManager::add(const std::string& filename){
-    StagingArea& stagingArea=core->getStagingArea(); 
-
-    // 如果文件之前被标记为删除，现在要重新添加，则先移除删除标记
-    if(stagingArea.isRemoved(filename)){
-        stagingArea.removeRemovedFile(filename);
-        stagingArea.save();
-        if(!Utils::exists(filename)){
-            return;
+namespace {
+    // 去掉开头的"./"和结尾的"/"，和commit里的路径写法一致
+    std::string normalizePath(std::string path){
+        while(path.length()>2&&path.compare(0,2,"./")==0){
+            path.erase(0,2);
         }
-    }   
+        while(path.length()>1&&path.back()=='/'){
+            path.pop_back();
+        }
+        return path;
+    }
 
-    if(!Utils::exists(filename)){
-        Utils::exitWithMessage("File does not exist."); 
+    bool hasGlob(const std::string& path){
+        return path.find_first_of("*?[")!=std::string::npos;
     }
 
-    // 获取当前commit中文件的blob ID
-    std::string current_commit_id=commitManager->getCurrentCommitId();
-    std::string current_blob_id=commitManager->getFileBlobId(filename,current_commit_id);
+    // 目录下的全部普通文件（递归），跳过.gitlite
+    void collectFiles(const std::string& dir,std::set<std::string>& files){
+        for(auto& file:DirectoryWalker::listFiles(dir)){
+            files.insert(files.end(),std::move(file));
+        }
+    }
+}
+
+std::vector<std::string> FileOperationManager::expandPaths(const std::vector<std::string>& paths){
+    StagingArea& stagingArea=core->getStagingArea();
+    std::set<std::string> files;
+    for(const auto& arg:paths){
+        std::string path=normalizePath(arg);
+        // 如果文件之前被标记为删除，现在要重新添加，则先移除删除标记
+        if(stagingArea.isRemoved(path)){
+            stagingArea.removeRemovedFile(path);
+            if(!Utils::exists(path)){
+                continue;
+            }
+        }
+        if(Utils::isFile(path)){
+            files.insert(path);
+        }
+        else if(Utils::isDirectory(path)){
+            collectFiles(path,files);
+        }
+        else if(hasGlob(path)){
+            // 通配符按shell的规则匹配，*不跨过"/"；匹配到的目录整个加入
+            glob_t matches;
+            bool found=glob(path.c_str(),0,nullptr,&matches)==0;
+            if(found){
+                for(size_t i=0;i<matches.gl_pathc;i++){
+                    std::string match=normalizePath(matches.gl_pathv[i]);
+                    if(Utils::isFile(match))files.insert(match);
+                    else if(Utils::isDirectory(match))collectFiles(match,files);
+                }
+            }
+            globfree(&matches);
+            if(!found){
+                Utils::exitWithMessage("File does not exist.");
+            }
+        }
+        else{
+            Utils::exitWithMessage("File does not exist."); 
+        }
+    }
+    return std::vector<std::string>(files.begin(),files.end());
+}
 
-    // 当前文件的blob ID
-    std::string file_content=Utils::readContentsAsString(filename);
-    std::string new_blob_id=Blob::generateId(file_content);
+void FileOperationManager::add(const std::vector<std::string>& paths){
+    StagingArea& stagingArea=core->getStagingArea(); 
+    // 先展开全部路径，有不存在的路径时什么都不改
+    std::vector<std::string> files=expandPaths(paths);
 
+    // 当前commit的文件表、冲突列表只读一次
+    ObjectId current_commit_id=commitManager->getCurrentCommitId();
+    BlobTable tracked_files=commitManager->getTrackedFiles(current_commit_id);
     auto conflict_files=getConflictFiles();
-    bool is_conflict_file=conflict_files.count(filename)>0;
-
-    // 如果文件内容没有变化
-    if(current_blob_id==new_blob_id){
-        if(!is_conflict_file){
-            // 如果不是冲突文件且已在暂存区，则移除
-            if(stagingArea.isStaged(filename)){
-                stagingArea.removeStagedFile(filename);
-                stagingArea.save();
-            }
-            return;
+    bool conflicts_changed=false;
+
+    // stat信息没变的文件用索引里的缓存，其余的在线程池里并行算哈希
+    std::vector<StagingArea::FileStat> stats(files.size());
+    std::vector<ObjectId> new_blob_ids(files.size());
+    std::vector<size_t> to_hash;
+    for(size_t i=0;i<files.size();i++){
+        if(stagingArea.isRemoved(files[i])){
+            stagingArea.removeRemovedFile(files[i]);
+        }
+        if(!StagingArea::statFile(files[i],stats[i])){
+            Utils::exitWithMessage("File does not exist.");
+        }
+        if(!stagingArea.cachedBlobId(files[i],stats[i],new_blob_ids[i])){
+            to_hash.push_back(i);
+        }
+    }
+    ThreadPool pool(std::min(ThreadPool::defaultThreads(),std::max<size_t>(to_hash.size(),1)));
+    pool.parallelFor(to_hash.size(),[&](size_t begin,size_t end){
+        for(size_t k=begin;k<end;k++){
+            size_t i=to_hash[k];
+            new_blob_ids[i]=Blob::generateIdFromFile(files[i]);
         }
+    });
+    for(size_t i:to_hash){
+        stagingArea.recordBlobId(files[i],stats[i],new_blob_ids[i]);
     }
 
-    stagingArea.addStagedFile(filename,new_blob_id);
+    const ObjectStore& store=core->getObjectStore();
+    std::vector<size_t> to_write;
+    std::unordered_set<ObjectId> writing;
+    for(size_t i=0;i<files.size();i++){
+        const std::string& filename=files[i];
+        ObjectId current_blob_id=tracked_files.lookup(filename);
+        bool is_conflict_file=conflict_files.count(filename)>0;
+
+        // 如果文件内容没有变化，不是冲突文件时从暂存区移除
+        if(current_blob_id==new_blob_ids[i]&&!is_conflict_file){
+            stagingArea.removeStagedFile(filename);
+            continue;
+        }
 
-    if(is_conflict_file){
-        conflict_files.erase(filename);
-        saveConflictFiles(conflict_files);
+        stagingArea.addStagedFile(filename,new_blob_ids[i]);
+        if(is_conflict_file){
+            conflict_files.erase(filename);
+            conflicts_changed=true;
+        }
+        if(!store.exists(new_blob_ids[i])&&writing.insert(new_blob_ids[i]).second){
+            to_write.push_back(i);
+        }
     }
 
+    // 先并行把新内容流式写入对象库（大文件不会整个读进内存），再一次性保存暂存区，暂存区里的blob总是已经存在
+    pool.parallelFor(to_write.size(),[&](size_t begin,size_t end){
+        for(size_t k=begin;k<end;k++){
+            Blob::createFromFile(store,files[to_write[k]]);
+        }
+    });
+    if(conflicts_changed){
+        saveConflictFiles(conflict_files);
+    }
     stagingArea.save();
-    Blob::create(".gitlite/objects",file_content);
 }
 
 void FileOperationManager::rm(const std::string& filename){
     StagingArea& staging_area=core->getStagingArea();
-    const auto& staging_map=staging_area.getStagingMap();
-    std::string current_commit_id=commitManager->getCurrentCommitId();
+    ObjectId current_commit_id=commitManager->getCurrentCommitId();
     bool file_tracked=commitManager->fileExistsInCommit(filename,current_commit_id);  // 文件是否被跟踪
     bool file_staged=staging_area.isStaged(filename);                                 // 文件是否在暂存区
 
@@ -82,7 +173,7 @@ void FileOperationManager::rm(const std::string& filename){
         staging_area.addRemovedFile(filename); 
         staging_area.save();
         if(Utils::exists(filename)){
-            remove(filename.c_str());          
+            Utils::removeWorkingFile(filename);
         }
         return;
     }
@@ -90,13 +181,13 @@ void FileOperationManager::rm(const std::string& filename){
 
 
 void FileOperationManager::checkoutFile(const std::string& filename){
-    std::string current_commit_id=commitManager->getCurrentCommitId();
-    checkoutFileInCommit(current_commit_id,filename);
+    ObjectId current_commit_id=commitManager->getCurrentCommitId();
+    checkoutFileInCommit(current_commit_id.toHex(),filename);
 }
 
 void FileOperationManager::checkoutFileInCommit(const std::string& commit_id, const std::string& filename){
-    std::string full_commit_id=commitManager->getFullCommitId(commit_id);
-    if(full_commit_id.empty()){
+    ObjectId full_commit_id=commitManager->getFullCommitId(commit_id);
+    if(full_commit_id.isNull()){
         Utils::exitWithMessage("No commit with that id exists.");
     }
 
@@ -107,27 +198,26 @@ void FileOperationManager::checkoutFileInCommit(const std::string& commit_id, co
     commitManager->copyFileFromCommit(filename,full_commit_id);
 }
 
-bool FileOperationManager::isFileModified(const std::string& filename,const std::string& commit_id){
+bool FileOperationManager::isFileModified(const std::string& filename,const ObjectId& commit_id){
     if(!Utils::exists(filename)||!commitManager->fileExistsInCommit(filename,commit_id)){
         return false;  // 文件不存在或未被跟踪，不算修改
     }
 
-    // 比较当前文件和commit中文件的blob ID
-    std::string commit_blob_id=commitManager->getFileBlobId(filename,commit_id);
-    std::string current_content=Utils::readContentsAsString(filename);
-    std::string current_blob_id=Blob::generateId(current_content);
+    // 比较当前文件和commit中文件的blob ID，stat信息没变时用索引里的缓存
+    ObjectId commit_blob_id=commitManager->getFileBlobId(filename,commit_id);
+    ObjectId current_blob_id=core->getStagingArea().fileBlobId(filename);
 
     return commit_blob_id!=current_blob_id;
 }
 
 std::set<std::string> FileOperationManager::getUntrackedFiles() {
     std::set<std::string> untracked_files;
-    std::string current_commit_id=commitManager->getCurrentCommitId();
+    ObjectId current_commit_id=commitManager->getCurrentCommitId();
     auto tracked_files=commitManager->getTrackedFiles(current_commit_id);
     StagingArea& staging_area=core->getStagingArea();
     const auto& staging_map=staging_area.getStagingMap();                 
 
-    auto working_files=Utils::plainFilenamesIn(".");
+    auto working_files=DirectoryWalker::listFiles(".");
     for(const auto& file:working_files){
         if(!tracked_files.count(file)&&!staging_map.count(file)){
             untracked_files.insert(file);
@@ -139,7 +229,7 @@ std::set<std::string> FileOperationManager::getUntrackedFiles() {
 
 std::map<std::string,std::string> FileOperationManager::getModifiedFiles(){
     std::map<std::string,std::string> modified_files;
-    std::string current_commit_id=commitManager->getCurrentCommitId();
+    ObjectId current_commit_id=commitManager->getCurrentCommitId();
     auto tracked_files=commitManager->getTrackedFiles(current_commit_id);  
     StagingArea& staging_area=core->getStagingArea();
     const auto& staging_map=staging_area.getStagingMap();                 
@@ -0,0 +1,126 @@
+#include"../include/GarbageCollector.h"
+#include"../include/Blob.h"
+#include"../include/Commit.h"
+#include"../include/ObjectStore.h"
+#include"../include/Tree.h"
+#include"../include/Utils.h"
+#include<cstdio>
+#include<mutex>
+#include<unistd.h>
+
+GarbageCollector::GarbageCollector(const ObjectStore& objectStore,size_t threads)
+    : store(objectStore),pool(threads){}
+
+std::unordered_set<ObjectId> GarbageCollector::mark(const std::vector<ObjectId>& commits,const std::vector<ObjectId>& blobs){
+    std::unordered_set<ObjectId> marked;
+    std::mutex mutex;
+    std::vector<ObjectId> frontier;
+    std::vector<ObjectId> trees;
+    std::vector<ObjectId> reached_blobs;
+    for(const auto& id:commits){
+        if(!id.isNull()&&marked.insert(id).second){
+            frontier.push_back(id);
+        }
+    }
+
+    // 逐层遍历commit：线程里只读对象库（不经过commit缓存，只解析头部、不展开tree），结果合并时才加锁
+    while(!frontier.empty()){
+        std::vector<ObjectId> next;
+        pool.parallelFor(frontier.size(),[&](size_t begin,size_t end){
+            std::vector<ObjectId> parents,roots,files;
+            for(size_t i=begin;i<end;i++){
+                Commit commit=Commit::load(store,frontier[i]);
+                for(const auto& parent:commit.getParents()){
+                    if(!parent.isNull())parents.push_back(parent);
+                }
+                if(!commit.getTree().isNull()){
+                    roots.push_back(commit.getTree());
+                }
+                else{
+                    for(const auto& blob:commit.getBlobs()){
+                        files.push_back(blob.second);
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            for(const auto& parent:parents){
+                if(marked.insert(parent).second)next.push_back(parent);
+            }
+            for(const auto& tree:roots){
+                if(marked.insert(tree).second)trees.push_back(tree);
+            }
+            for(const auto& blob:files){
+                if(marked.insert(blob).second)reached_blobs.push_back(blob);
+            }
+        });
+        frontier.swap(next);
+    }
+
+    // 再逐层遍历tree，commit之间共用的子树只访问一次
+    while(!trees.empty()){
+        std::vector<ObjectId> next;
+        pool.parallelFor(trees.size(),[&](size_t begin,size_t end){
+            std::vector<ObjectId> subtrees,files;
+            for(size_t i=begin;i<end;i++){
+                for(const auto& entry:Tree::load(store,trees[i])){
+                    (entry.type==OBJ_TREE?subtrees:files).push_back(entry.id);
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            for(const auto& tree:subtrees){
+                if(marked.insert(tree).second)next.push_back(tree);
+            }
+            for(const auto& blob:files){
+                if(marked.insert(blob).second)reached_blobs.push_back(blob);
+            }
+        });
+        trees.swap(next);
+    }
+    for(const auto& id:blobs){
+        if(!id.isNull()&&marked.insert(id).second){
+            reached_blobs.push_back(id);
+        }
+    }
+
+    // 分块存储的blob还引用着各个块
+    pool.parallelFor(reached_blobs.size(),[&](size_t begin,size_t end){
+        std::vector<ObjectId> chunks;
+        for(size_t i=begin;i<end;i++){
+            auto ids=Blob::chunkIds(store,reached_blobs[i]);
+            chunks.insert(chunks.end(),ids.begin(),ids.end());
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        marked.insert(chunks.begin(),chunks.end());
+    });
+    return marked;
+}
+
+GarbageCollector::Plan GarbageCollector::plan(const std::unordered_set<ObjectId>& reachable,std::time_t cutoff) const {
+    Plan result;
+    for(const auto& id:store.list()){
+        if(reachable.count(id))continue;
+        if(store.modifiedTime(id)>cutoff){
+            result.recent++;
+            continue;
+        }
+        if(!store.loosePath(id).empty())result.loose.push_back(id);
+        if(store.isPacked(id))result.packed.insert(id);
+    }
+    return result;
+}
+
+void GarbageCollector::removeLoose(const Plan& plan) const {
+    for(const auto& id:plan.loose){
+        std::string path=store.loosePath(id);
+        if(!path.empty()){
+            std::remove(path.c_str());
+        }
+    }
+    // 非空目录rmdir会失败，不用管
+    const std::string& objects_dir=store.getObjectsDir();
+    for(const auto& shard:Utils::subdirectoriesIn(objects_dir)){
+        if(shard.length()==2){
+            ::rmdir(Utils::join(objects_dir,shard).c_str());
+        }
+    }
+}
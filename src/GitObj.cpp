@@ -4,8 +4,8 @@ void GitObj::init(){
     repo.init();  
 }
 
-void GitObj::add(const std::string& filename){
-    repo.add(filename);  
+void GitObj::add(const std::vector<std::string>& paths){
+    repo.add(paths);  
 }
 
 void GitObj::commit(const std::string& message){
@@ -28,6 +28,10 @@ void GitObj::find(const std::string& commitMessage){
     repo.find(commitMessage);
 }
 
+void GitObj::find(const std::string& option,const std::string& query){
+    repo.find(option,query);
+}
+
 void GitObj::checkoutFile(const std::string& filename){
     repo.checkoutFile(filename);
 }
@@ -78,4 +82,32 @@ void GitObj::fetch(const std::string& remoteName,const std::string& branchName){
 
 void GitObj::pull(const std::string& remoteName,const std::string& branchName){
     repo.pull(remoteName,branchName);
+}
+
+void GitObj::migrate(){
+    repo.migrate();
+}
+
+void GitObj::repack(){
+    repo.repack();
+}
+
+void GitObj::reindex(){
+    repo.reindex();
+}
+
+void GitObj::gc(bool dryRun){
+    repo.gc(dryRun);
+}
+
+void GitObj::fsck(){
+    repo.fsck();
+}
+
+void GitObj::config(const std::string& key){
+    repo.config(key);
+}
+
+void GitObj::config(const std::string& key,const std::string& value){
+    repo.config(key,value);
 }
\ No newline at end of file
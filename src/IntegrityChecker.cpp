@@ -0,0 +1,224 @@
+#include"../include/IntegrityChecker.h"
+#include"../include/Blob.h"
+#include"../include/Commit.h"
+#include"../include/ObjectStore.h"
+#include"../include/ObjectStream.h"
+#include"../include/Sha1Kernel.h"
+#include"../include/Tree.h"
+#include"../include/Utils.h"
+#include<algorithm>
+#include<chrono>
+#include<mutex>
+#include<unordered_set>
+
+namespace {
+    enum Kind : uint8_t { KIND_CORRUPT=0,KIND_BLOB=1,KIND_COMMIT=2,KIND_CHUNKED=3,KIND_TREE=4 };
+
+    // 一条引用：from里的context指向id，要求id存在且是expected类型（KIND_BLOB也接受块清单）
+    struct Reference{
+        ObjectId id;
+        Kind expected;
+        std::string context;
+    };
+
+    const char* kindName(Kind kind){
+        switch(kind){
+        case KIND_COMMIT:return "commit";
+        case KIND_TREE:return "tree";
+        default:return "blob";
+        }
+    }
+
+    struct Result{
+        Kind kind=KIND_CORRUPT;
+        std::string detail;
+    };
+
+    const std::string CHUNK_PREFIX="GLCHUNKS";
+
+    bool startsWith(const std::vector<char>& buffer,size_t length,const std::string& prefix){
+        return length>=prefix.size()&&std::equal(prefix.begin(),prefix.end(),buffer.begin());
+    }
+
+    //把reader剩下的内容喂给hasher，keep非空时同时保留一份
+    uint64_t drain(ObjectReader& reader,SHA1::SHA& hasher,std::vector<char>& buffer,std::string* keep){
+        uint64_t total=0;
+        size_t got;
+        while((got=reader.read(buffer.data(),buffer.size()))>0){
+            hasher.update(buffer.data(),got);
+            if(keep)keep->append(buffer.data(),got);
+            total+=got;
+        }
+        return total;
+    }
+}
+
+IntegrityChecker::IntegrityChecker(const ObjectStore& objectStore,size_t threads)
+    : store(objectStore),pool(threads){}
+
+IntegrityChecker::Report IntegrityChecker::check(const std::map<std::string,ObjectId>& branches,const std::map<std::string,ObjectId>& staged){
+    auto started=std::chrono::steady_clock::now();
+    Report report;
+    report.threads=pool.size();
+    // 下面所有的哈希都用选中的SHA-1实现，先和参考实现对一下
+    if(!SHA1::selfCheck()){
+        report.problems.push_back("sha1 implementation "+SHA1::compressName()+" does not match the portable reference");
+    }
+
+    std::vector<ObjectId> all=store.list();
+    std::vector<Result> results(all.size());
+    std::vector<Reference> references;
+    std::mutex mutex;
+    uint64_t total_bytes=0;
+
+    pool.parallelFor(all.size(),[&](size_t begin,size_t end){
+        std::vector<Reference> local;
+        std::vector<char> buffer(STREAM_BUFFER_SIZE);
+        uint64_t bytes=0;
+        for(size_t i=begin;i<end;i++){
+            const ObjectId& id=all[i];
+            Result& result=results[i];
+            try{
+                ObjectReader reader(store,id);
+                SHA1::SHA hasher;
+                size_t got=reader.read(buffer.data(),buffer.size());
+                hasher.update(buffer.data(),got);
+                bytes+=got;
+
+                // 只有可能是commit（二进制或旧文本格式）、tree或块清单的对象才保留完整内容，普通blob只流式计算哈希
+                bool maybe_commit=Commit::isCommitData(std::string_view(buffer.data(),got));
+                bool maybe_tree=Tree::isTreeData(std::string_view(buffer.data(),got));
+                bool maybe_chunks=startsWith(buffer,got,CHUNK_PREFIX);
+                bool keep=maybe_commit||maybe_tree||maybe_chunks;
+                std::string content;
+                if(keep){
+                    content.assign(buffer.data(),got);
+                }
+                bytes+=drain(reader,hasher,buffer,keep?&content:nullptr);
+
+                uint8_t digest[ObjectId::RAW_LENGTH];
+                hasher.finalize(digest);
+                if(ObjectId::fromRaw(digest)==id){
+                    result.kind=KIND_BLOB;
+                    // tree的id也是内容的sha1，哈希对上后再按tree解析出条目
+                    if(maybe_tree){
+                        for(const auto& entry:Tree::parse(content)){
+                            local.push_back({entry.id,entry.type==OBJ_TREE?KIND_TREE:KIND_BLOB,entry.name+" in tree "+id.toHex()});
+                        }
+                        result.kind=KIND_TREE;
+                    }
+                    continue;
+                }
+                if(maybe_commit){
+                    Commit commit=Commit::deserialize(content);
+                    if(commit.getId()!=id){
+                        result.detail="commit fields hash to "+commit.getId().toHex();
+                        continue;
+                    }
+                    result.kind=KIND_COMMIT;
+                    for(const auto& parent:commit.getParents()){
+                        if(!parent.isNull())local.push_back({parent,KIND_COMMIT,"parent of "+id.toHex()});
+                    }
+                    if(!commit.getTree().isNull()){
+                        local.push_back({commit.getTree(),KIND_TREE,"tree of "+id.toHex()});
+                    }
+                    for(const auto& blob:commit.getBlobs()){
+                        local.push_back({blob.second,KIND_BLOB,blob.first+" in "+id.toHex()});
+                    }
+                    continue;
+                }
+                if(!maybe_chunks){
+                    result.detail="content hash mismatch";
+                    continue;
+                }
+
+                // 块清单：按顺序读出每个块，拼起来的内容的sha1应该等于id
+                SHA1::SHA whole;
+                bool complete=true;
+                for(const auto& chunk:Blob::parseChunkList(content)){
+                    local.push_back({chunk.first,KIND_BLOB,"chunk of "+id.toHex()});
+                    if(!store.exists(chunk.first)){
+                        complete=false;
+                        continue;
+                    }
+                    ObjectReader chunk_reader(store,chunk.first);
+                    if(chunk_reader.size()!=chunk.second){
+                        result.detail="chunk "+chunk.first.toHex()+" has the wrong size";
+                        complete=false;
+                        break;
+                    }
+                    bytes+=drain(chunk_reader,whole,buffer,nullptr);
+                }
+                if(!complete){
+                    // 缺块时按引用缺失报告，不算这个清单本身损坏
+                    if(result.detail.empty())result.kind=KIND_CHUNKED;
+                    continue;
+                }
+                whole.finalize(digest);
+                if(ObjectId::fromRaw(digest)!=id){
+                    result.detail="chunks hash to the wrong content";
+                    continue;
+                }
+                result.kind=KIND_CHUNKED;
+            }catch(const std::exception& e){
+                result.kind=KIND_CORRUPT;
+                result.detail=e.what();
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        references.insert(references.end(),std::make_move_iterator(local.begin()),std::make_move_iterator(local.end()));
+        total_bytes+=bytes;
+    });
+
+    for(const auto& branch:branches){
+        references.push_back({branch.second,KIND_COMMIT,"branch "+branch.first});
+    }
+    for(const auto& entry:staged){
+        references.push_back({entry.second,KIND_BLOB,"staged "+entry.first});
+    }
+
+    // 引用检查：目标必须存在且类型对得上
+    std::vector<bool> referenced(all.size(),false);
+    for(const auto& ref:references){
+        auto it=std::lower_bound(all.begin(),all.end(),ref.id);
+        const char* expected=kindName(ref.expected);
+        if(it==all.end()||*it!=ref.id){
+            report.problems.push_back(std::string("missing ")+expected+" "+ref.id.toHex()+" ("+ref.context+")");
+            continue;
+        }
+        size_t i=it-all.begin();
+        referenced[i]=true;
+        Kind kind=results[i].kind;
+        if(kind==KIND_CHUNKED)kind=KIND_BLOB;
+        if(kind!=KIND_CORRUPT&&kind!=ref.expected){
+            report.problems.push_back(std::string("not a ")+expected+" "+ref.id.toHex()+" ("+ref.context+")");
+        }
+    }
+
+    for(size_t i=0;i<all.size();i++){
+        const Result& result=results[i];
+        if(result.kind==KIND_CORRUPT){
+            report.problems.push_back("corrupt "+all[i].toHex()+" ("+result.detail+")");
+            continue;
+        }
+        if(result.kind==KIND_COMMIT){
+            report.commits++;
+        }
+        else if(result.kind==KIND_TREE){
+            report.trees++;
+        }
+        else{
+            report.blobs++;
+        }
+        if(!referenced[i]){
+            report.dangling.push_back(std::string("dangling ")+kindName(result.kind)+" "+all[i].toHex());
+        }
+    }
+    std::sort(report.problems.begin(),report.problems.end());
+    report.problems.erase(std::unique(report.problems.begin(),report.problems.end()),report.problems.end());
+
+    report.objects=all.size();
+    report.bytes=total_bytes;
+    report.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-started).count();
+    return report;
+}
@@ -0,0 +1,86 @@
+#include"../include/MappedFile.h"
+#include<stdexcept>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+
+MappedFile::MappedFile(const std::string& filepath,Access access)
+    : data_ptr(""),length(0),mapped(false){
+    int fd=::open(filepath.c_str(),O_RDONLY);
+    if(fd<0){
+        throw std::invalid_argument("cannot open file");
+    }
+    struct stat st;
+    if(fstat(fd,&st)!=0||!S_ISREG(st.st_mode)){
+        ::close(fd);
+        throw std::invalid_argument("must be a normal file");
+    }
+    size_t size=static_cast<size_t>(st.st_size);
+
+    if(size>=MMAP_THRESHOLD){
+        void* addr=mmap(nullptr,size,PROT_READ,MAP_PRIVATE,fd,0);
+        if(addr!=MAP_FAILED){
+            madvise(addr,size,access==SEQUENTIAL?MADV_SEQUENTIAL:MADV_RANDOM);
+            ::close(fd);
+            data_ptr=static_cast<const char*>(addr);
+            length=size;
+            mapped=true;
+            return;
+        }
+        // 映射失败（比如某些特殊文件系统）时退回到read
+    }
+
+    buffer.resize(size);
+    size_t got=0;
+    while(got<size){
+        ssize_t n=::read(fd,&buffer[got],size-got);
+        if(n<0){
+            ::close(fd);
+            throw std::invalid_argument("cannot read file");
+        }
+        if(n==0)break;  // 文件在读取过程中变短了
+        got+=static_cast<size_t>(n);
+    }
+    ::close(fd);
+    buffer.resize(got);
+    data_ptr=buffer.data();
+    length=got;
+}
+
+MappedFile::~MappedFile(){
+    release();
+}
+
+void MappedFile::release(){
+    if(mapped){
+        munmap(const_cast<char*>(data_ptr),length);
+        mapped=false;
+    }
+    data_ptr="";
+    length=0;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_ptr(other.data_ptr),length(other.length),mapped(other.mapped),buffer(std::move(other.buffer)){
+    // 小字符串优化时buffer的数据地址会随移动改变
+    if(!mapped)data_ptr=buffer.data();
+    other.data_ptr="";
+    other.length=0;
+    other.mapped=false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if(this!=&other){
+        release();
+        data_ptr=other.data_ptr;
+        length=other.length;
+        mapped=other.mapped;
+        buffer=std::move(other.buffer);
+        if(!mapped)data_ptr=buffer.data();
+        other.data_ptr="";
+        other.length=0;
+        other.mapped=false;
+    }
+    return *this;
+}
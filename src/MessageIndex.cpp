@@ -0,0 +1,279 @@
+#include"../include/MessageIndex.h"
+#include"../include/MappedFile.h"
+#include"../include/ThreadPool.h"
+#include"../include/Utils.h"
+#include<algorithm>
+#include<cctype>
+#include<cstdio>
+#include<cstring>
+#include<fstream>
+#include<mutex>
+
+namespace {
+    const std::string INDEX_MAGIC="GLMIDX1\n";
+    const size_t HEADER_SIZE=8+4;
+    const int BUCKET_BITS=8;    // 重建时按类型加值的前8位分桶，各桶独立排序
+
+    const uint64_t TYPE_EXACT=uint64_t(1)<<62;
+    const uint64_t TYPE_TOKEN=uint64_t(2)<<62;
+    const uint64_t TYPE_TRIGRAM=uint64_t(3)<<62;
+    const uint64_t VALUE_MASK=(uint64_t(1)<<62)-1;
+
+    uint64_t fnv1a(std::string_view data){
+        uint64_t h=0xcbf29ce484222325ULL;
+        for(char c:data){
+            h^=static_cast<uint8_t>(c);
+            h*=0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    uint64_t readBE(const uint8_t* p,int bytes){
+        uint64_t v=0;
+        for(int i=0;i<bytes;i++){
+            v=(v<<8)|p[i];
+        }
+        return v;
+    }
+
+    void appendBE(std::string& out,uint64_t v,int bytes){
+        for(int i=bytes-1;i>=0;i--){
+            out.push_back(static_cast<char>(v>>(8*i)));
+        }
+    }
+
+    // key的桶号：类型（最高2位）接上值的前8位，桶号的顺序和key的顺序一致
+    // 三元组的值只有24位，取第一个字节；哈希key取值的最高8位
+    size_t bucketOf(uint64_t key){
+        uint64_t type=key>>62;
+        uint64_t lead=type==(TYPE_TRIGRAM>>62)?(key>>16)&0xff:(key&VALUE_MASK)>>(62-BUCKET_BITS);
+        return static_cast<size_t>((type<<BUCKET_BITS)|lead);
+    }
+
+    bool isTokenChar(char c){
+        unsigned char u=static_cast<unsigned char>(c);
+        return u>=0x80||std::isalnum(u);
+    }
+}
+
+MessageIndex::MessageIndex(const std::string& gitliteDir)
+    : index_file(Utils::join(gitliteDir,"message-index")),
+      log_file(Utils::join(gitliteDir,"message-index.log")),
+      log_loaded(false){}
+
+MessageIndex::~MessageIndex(){}
+
+bool MessageIndex::exists() const {
+    return Utils::isFile(index_file);
+}
+
+uint64_t MessageIndex::exactKey(std::string_view message){
+    return TYPE_EXACT|(fnv1a(message)&VALUE_MASK);
+}
+
+uint64_t MessageIndex::tokenKey(std::string_view token){
+    return TYPE_TOKEN|(fnv1a(token)&VALUE_MASK);
+}
+
+uint64_t MessageIndex::trigramKey(const char* p){
+    // 三个字节直接拼成key，不会冲突
+    return TYPE_TRIGRAM|(uint64_t(static_cast<uint8_t>(p[0]))<<16)
+                       |(uint64_t(static_cast<uint8_t>(p[1]))<<8)
+                       |uint64_t(static_cast<uint8_t>(p[2]));
+}
+
+std::vector<std::string> MessageIndex::tokenize(std::string_view message){
+    std::vector<std::string> tokens;
+    size_t i=0;
+    while(i<message.size()){
+        if(!isTokenChar(message[i])){
+            i++;
+            continue;
+        }
+        std::string token;
+        while(i<message.size()&&isTokenChar(message[i])){
+            token.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(message[i]))));
+            i++;
+        }
+        tokens.push_back(std::move(token));
+    }
+    return tokens;
+}
+
+std::vector<uint64_t> MessageIndex::keysOf(std::string_view message){
+    std::vector<uint64_t> keys;
+    keys.push_back(exactKey(message));
+    for(const auto& token:tokenize(message)){
+        keys.push_back(tokenKey(token));
+    }
+    for(size_t i=0;i+3<=message.size();i++){
+        keys.push_back(trigramKey(message.data()+i));
+    }
+    std::sort(keys.begin(),keys.end());
+    keys.erase(std::unique(keys.begin(),keys.end()),keys.end());
+    return keys;
+}
+
+const MappedFile* MessageIndex::getMapped() const {
+    if(!mapped){
+        if(!exists())return nullptr;
+        std::unique_ptr<MappedFile> file(new MappedFile(index_file,MappedFile::RANDOM));
+        if(file->size()<HEADER_SIZE
+         ||std::memcmp(file->data(),INDEX_MAGIC.data(),INDEX_MAGIC.length())!=0
+         ||(file->size()-HEADER_SIZE)%RECORD_SIZE!=0){
+            return nullptr;
+        }
+        mapped=std::move(file);
+    }
+    return mapped.get();
+}
+
+const std::vector<MessageIndex::Posting>& MessageIndex::getLog() const {
+    if(!log_loaded){
+        log_postings.clear();
+        if(Utils::isFile(log_file)){
+            // 末尾不完整的记录（写入中途失败）直接忽略
+            std::string data=Utils::readContentsAsString(log_file);
+            const uint8_t* p=reinterpret_cast<const uint8_t*>(data.data());
+            for(size_t i=0;i+RECORD_SIZE<=data.size();i+=RECORD_SIZE){
+                log_postings.push_back({readBE(p+i,8),static_cast<uint32_t>(readBE(p+i+8,4))});
+            }
+        }
+        log_loaded=true;
+    }
+    return log_postings;
+}
+
+void MessageIndex::add(uint32_t ordinal,std::string_view message){
+    if(!exists())return;
+
+    std::string records;
+    for(uint64_t key:keysOf(message)){
+        appendBE(records,key,8);
+        appendBE(records,ordinal,4);
+    }
+    {
+        std::ofstream out(log_file,std::ios::binary|std::ios::app);
+        out.write(records.data(),records.size());
+    }
+    log_loaded=false;
+
+    struct stat st;
+    if(stat(log_file.c_str(),&st)==0
+     &&static_cast<size_t>(st.st_size)/RECORD_SIZE>COMPACT_THRESHOLD){
+        compact();
+    }
+}
+
+void MessageIndex::writeSorted(const std::vector<Posting>& postings,uint32_t covered){
+    std::string data=INDEX_MAGIC;
+    data.reserve(HEADER_SIZE+postings.size()*RECORD_SIZE);
+    appendBE(data,covered,4);
+    for(const auto& posting:postings){
+        appendBE(data,posting.key,8);
+        appendBE(data,posting.ordinal,4);
+    }
+    // 先写临时文件再rename，避免中途失败留下半个索引
+    mapped.reset();
+    std::string tmp_file=index_file+".tmp";
+    Utils::writeContents(tmp_file,data);
+    std::rename(tmp_file.c_str(),index_file.c_str());
+    std::remove(log_file.c_str());
+    log_loaded=false;
+}
+
+void MessageIndex::rebuild(size_t count,const std::function<std::string_view(size_t)>& messageAt){
+    const size_t bucket_count=size_t(4)<<BUCKET_BITS;
+    std::vector<std::vector<Posting>> buckets(bucket_count);
+    std::mutex buckets_mutex;
+
+    ThreadPool pool;
+    // 第一步：各线程为一段commit生成key，用bucketOf分桶后并入全局的桶
+    pool.parallelFor(count,[&](size_t begin,size_t end){
+        std::vector<std::vector<Posting>> local(bucket_count);
+        for(size_t i=begin;i<end;i++){
+            for(uint64_t key:keysOf(messageAt(i))){
+                local[bucketOf(key)].push_back({key,static_cast<uint32_t>(i)});
+            }
+        }
+        std::lock_guard<std::mutex> lock(buckets_mutex);
+        for(size_t b=0;b<bucket_count;b++){
+            buckets[b].insert(buckets[b].end(),local[b].begin(),local[b].end());
+        }
+    });
+    // 第二步：各桶的key区间互不重叠，分别排序后按桶的顺序拼起来就是全局有序
+    pool.parallelFor(bucket_count,[&](size_t begin,size_t end){
+        for(size_t b=begin;b<end;b++){
+            std::sort(buckets[b].begin(),buckets[b].end());
+        }
+    });
+
+    std::vector<Posting> postings;
+    size_t total=0;
+    for(const auto& bucket:buckets)total+=bucket.size();
+    postings.reserve(total);
+    for(auto& bucket:buckets){
+        postings.insert(postings.end(),bucket.begin(),bucket.end());
+        std::vector<Posting>().swap(bucket);
+    }
+    writeSorted(postings,static_cast<uint32_t>(count));
+}
+
+void MessageIndex::compact(){
+    const MappedFile* file=getMapped();
+    if(!file)return;
+    std::vector<Posting> postings;
+    const uint8_t* p=reinterpret_cast<const uint8_t*>(file->data());
+    uint32_t covered=static_cast<uint32_t>(readBE(p+INDEX_MAGIC.length(),4));
+    for(size_t pos=HEADER_SIZE;pos<file->size();pos+=RECORD_SIZE){
+        postings.push_back({readBE(p+pos,8),static_cast<uint32_t>(readBE(p+pos+8,4))});
+    }
+    for(const auto& posting:getLog()){
+        postings.push_back(posting);
+        covered=std::max(covered,posting.ordinal+1);
+    }
+    std::sort(postings.begin(),postings.end());
+    postings.erase(std::unique(postings.begin(),postings.end(),[](const Posting& a,const Posting& b){
+        return a.key==b.key&&a.ordinal==b.ordinal;
+    }),postings.end());
+    writeSorted(postings,covered);
+}
+
+std::vector<uint32_t> MessageIndex::lookup(uint64_t key) const {
+    std::vector<uint32_t> result;
+    const MappedFile* file=getMapped();
+    if(file){
+        // 在映射上二分查找key的第一条记录
+        const uint8_t* records=reinterpret_cast<const uint8_t*>(file->data())+HEADER_SIZE;
+        size_t lo=0,hi=(file->size()-HEADER_SIZE)/RECORD_SIZE;
+        size_t count=hi;
+        while(lo<hi){
+            size_t mid=lo+(hi-lo)/2;
+            if(readBE(records+mid*RECORD_SIZE,8)<key)lo=mid+1;
+            else hi=mid;
+        }
+        for(size_t i=lo;i<count&&readBE(records+i*RECORD_SIZE,8)==key;i++){
+            result.push_back(static_cast<uint32_t>(readBE(records+i*RECORD_SIZE+8,4)));
+        }
+    }
+    for(const auto& posting:getLog()){
+        if(posting.key==key){
+            result.push_back(posting.ordinal);
+        }
+    }
+    std::sort(result.begin(),result.end());
+    result.erase(std::unique(result.begin(),result.end()),result.end());
+    return result;
+}
+
+uint32_t MessageIndex::coveredCount() const {
+    uint32_t covered=0;
+    const MappedFile* file=getMapped();
+    if(file){
+        covered=static_cast<uint32_t>(readBE(reinterpret_cast<const uint8_t*>(file->data())+INDEX_MAGIC.length(),4));
+    }
+    for(const auto& posting:getLog()){
+        covered=std::max(covered,posting.ordinal+1);
+    }
+    return covered;
+}
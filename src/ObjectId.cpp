@@ -0,0 +1,64 @@
+#include"../include/ObjectId.h"
+#include"../include/GitliteException.h"
+
+static const char HEX_DIGITS[]="0123456789abcdef";
+
+static int hexValue(char c){
+    if(c>='0'&&c<='9')return c-'0';
+    if(c>='a'&&c<='f')return c-'a'+10;
+    if(c>='A'&&c<='F')return c-'A'+10;
+    return -1;
+}
+
+ObjectId::ObjectId(){
+    bytes.fill(0);
+}
+
+ObjectId ObjectId::fromRaw(const uint8_t* raw){
+    ObjectId id;
+    std::memcpy(id.bytes.data(),raw,RAW_LENGTH);
+    return id;
+}
+
+bool ObjectId::isValidHex(std::string_view hex){
+    if(hex.length()!=HEX_LENGTH)return false;
+    for(char c:hex){
+        if(hexValue(c)<0)return false;
+    }
+    return true;
+}
+
+ObjectId ObjectId::fromHex(std::string_view hex){
+    if(!isValidHex(hex)){
+        throw GitliteException("Invalid object id: "+std::string(hex));
+    }
+    ObjectId id;
+    for(int i=0;i<RAW_LENGTH;i++){
+        id.bytes[i]=static_cast<uint8_t>((hexValue(hex[2*i])<<4)|hexValue(hex[2*i+1]));
+    }
+    return id;
+}
+
+void ObjectId::writeHex(char* out) const {
+    for(int i=0;i<RAW_LENGTH;i++){
+        out[2*i]=HEX_DIGITS[bytes[i]>>4];
+        out[2*i+1]=HEX_DIGITS[bytes[i]&0xf];
+    }
+}
+
+std::string ObjectId::toHex() const {
+    std::string hex(HEX_LENGTH,'0');
+    writeHex(&hex[0]);
+    return hex;
+}
+
+std::string ObjectId::toShortHex(size_t length) const {
+    return toHex().substr(0,length);
+}
+
+bool ObjectId::isNull() const {
+    for(uint8_t b:bytes){
+        if(b!=0)return false;
+    }
+    return true;
+}
@@ -0,0 +1,124 @@
+#include"../include/ObjectIndex.h"
+#include"../include/Utils.h"
+#include<algorithm>
+#include<cstdio>
+#include<fstream>
+#include<sys/stat.h>
+
+namespace {
+    const std::string INDEX_MAGIC="GLOIDX1\n";
+
+    void appendRawIds(const std::string& data,size_t offset,std::vector<ObjectId>& ids){
+        size_t count=(data.size()-offset)/ObjectId::RAW_LENGTH;
+        ids.reserve(ids.size()+count);
+        for(size_t i=0;i<count;i++){
+            const uint8_t* raw=reinterpret_cast<const uint8_t*>(data.data()+offset+i*ObjectId::RAW_LENGTH);
+            ids.push_back(ObjectId::fromRaw(raw));
+        }
+    }
+
+    bool hasPrefix(const ObjectId& id,const std::string& hexPrefix){
+        return id.toHex().compare(0,hexPrefix.length(),hexPrefix)==0;
+    }
+}
+
+ObjectIndex::ObjectIndex(const std::string& gitliteDir)
+    : index_file(Utils::join(gitliteDir,"oid-index")),
+      log_file(Utils::join(gitliteDir,"oid-index.log")),
+      loaded(false){}
+
+bool ObjectIndex::load(){
+    if(loaded)return true;
+    if(!Utils::isFile(index_file))return false;
+
+    std::string data=Utils::readContentsAsString(index_file);
+    if(data.compare(0,INDEX_MAGIC.length(),INDEX_MAGIC)!=0
+     ||(data.size()-INDEX_MAGIC.length())%ObjectId::RAW_LENGTH!=0){
+        return false;
+    }
+    sorted_ids.clear();
+    appendRawIds(data,INDEX_MAGIC.length(),sorted_ids);
+    if(!std::is_sorted(sorted_ids.begin(),sorted_ids.end())){
+        sorted_ids.clear();
+        return false;
+    }
+    loadLog();
+    loaded=true;
+    return true;
+}
+
+void ObjectIndex::loadLog(){
+    log_ids.clear();
+    if(!Utils::isFile(log_file))return;
+    appendRawIds(Utils::readContentsAsString(log_file),0,log_ids);
+}
+
+void ObjectIndex::add(const ObjectId& id){
+    if(!Utils::isFile(index_file))return;
+
+    {
+        std::ofstream out(log_file,std::ios::binary|std::ios::app);
+        out.write(reinterpret_cast<const char*>(id.data()),ObjectId::RAW_LENGTH);
+    }
+    if(loaded){
+        log_ids.push_back(id);
+    }
+
+    struct stat st;
+    if(stat(log_file.c_str(),&st)==0
+     &&static_cast<size_t>(st.st_size)/ObjectId::RAW_LENGTH>COMPACT_THRESHOLD){
+        compact();
+    }
+}
+
+void ObjectIndex::writeSorted(const std::vector<ObjectId>& ids){
+    std::string data=INDEX_MAGIC;
+    data.reserve(INDEX_MAGIC.length()+ids.size()*ObjectId::RAW_LENGTH);
+    for(const auto& id:ids){
+        data.append(reinterpret_cast<const char*>(id.data()),ObjectId::RAW_LENGTH);
+    }
+    // 先写临时文件再rename，避免中途失败留下半个索引
+    std::string tmp_file=index_file+".tmp";
+    Utils::writeContents(tmp_file,data);
+    std::rename(tmp_file.c_str(),index_file.c_str());
+    std::remove(log_file.c_str());
+}
+
+void ObjectIndex::rebuild(std::vector<ObjectId> ids){
+    std::sort(ids.begin(),ids.end());
+    ids.erase(std::unique(ids.begin(),ids.end()),ids.end());
+    writeSorted(ids);
+    sorted_ids=std::move(ids);
+    log_ids.clear();
+    loaded=true;
+}
+
+void ObjectIndex::compact(){
+    if(!load())return;
+    std::vector<ObjectId> ids=sorted_ids;
+    ids.insert(ids.end(),log_ids.begin(),log_ids.end());
+    rebuild(std::move(ids));
+}
+
+std::vector<ObjectId> ObjectIndex::lookup(const std::string& hexPrefix) const {
+    std::vector<ObjectId> result;
+    std::string lowest=hexPrefix;
+    lowest.resize(ObjectId::HEX_LENGTH,'0');
+    if(hexPrefix.length()>ObjectId::HEX_LENGTH||!ObjectId::isValidHex(lowest)){
+        return result;
+    }
+
+    // 主文件有序：从前缀补0后的下界开始，直到前缀不再匹配
+    auto it=std::lower_bound(sorted_ids.begin(),sorted_ids.end(),ObjectId::fromHex(lowest));
+    for(;it!=sorted_ids.end()&&hasPrefix(*it,hexPrefix);it++){
+        result.push_back(*it);
+    }
+    for(const auto& id:log_ids){
+        if(hasPrefix(id,hexPrefix)){
+            result.push_back(id);
+        }
+    }
+    std::sort(result.begin(),result.end());
+    result.erase(std::unique(result.begin(),result.end()),result.end());
+    return result;
+}
@@ -0,0 +1,469 @@
+#include"../include/ObjectStore.h"
+#include"../include/Utils.h"
+#include"../include/GitliteException.h"
+#include"../include/Delta.h"
+#include"../include/Compression.h"
+#include"../include/Config.h"
+#include"../include/MappedFile.h"
+#include"../include/ObjectStream.h"
+#include<algorithm>
+#include<cstdio>
+#include<cstring>
+#include<deque>
+#include<unordered_map>
+#include<unordered_set>
+#include<sys/stat.h>
+#include<unistd.h>
+#include<utime.h>
+
+ObjectStore::ObjectStore(const std::string& gitliteDir)
+    : gitlite_dir(gitliteDir),objects_dir(Utils::join(gitliteDir,"objects")),fanout(false),codec(CODEC_LZ4),chunking(true),index(gitliteDir),packs_loaded(false){
+    reload();
+}
+
+void ObjectStore::reload(){
+    fanout=readFormatVersion(gitlite_dir)>=1;
+    Config config(gitlite_dir);
+    codec=config.get("core.compression",Config::defaultValue("core.compression"))=="none"?CODEC_NONE:CODEC_LZ4;
+    chunking=config.get("core.chunking",Config::defaultValue("core.chunking"))!="off";
+    packs.clear();
+    packs_loaded=false;
+}
+
+const std::string& ObjectStore::getObjectsDir() const {
+    return objects_dir;
+}
+
+bool ObjectStore::isFanout() const {
+    return fanout;
+}
+
+bool ObjectStore::isChunkingEnabled() const {
+    return chunking;
+}
+
+uint8_t ObjectStore::getCodec() const {
+    return codec;
+}
+
+std::string ObjectStore::flatPath(const ObjectId& id) const {
+    return Utils::join(objects_dir,id.toHex());
+}
+
+std::string ObjectStore::fanoutPath(const ObjectId& id) const {
+    std::string hex=id.toHex();
+    return Utils::join(objects_dir,hex.substr(0,2),hex.substr(2));
+}
+
+std::string ObjectStore::objectPath(const ObjectId& id) const {
+    return fanout?fanoutPath(id):flatPath(id);
+}
+
+std::string ObjectStore::getPackDir() const {
+    return Utils::join(objects_dir,"pack");
+}
+
+const std::vector<std::unique_ptr<PackFile>>& ObjectStore::getPacks() const {
+    std::lock_guard<std::mutex> lock(packs_mutex);
+    if(!packs_loaded){
+        packs_loaded=true;
+        std::string pack_dir=getPackDir();
+        for(const auto& name:Utils::plainFilenamesIn(pack_dir)){
+            auto pack=PackFile::open(Utils::join(pack_dir,name));
+            if(pack){
+                packs.push_back(std::move(pack));
+            }
+        }
+    }
+    return packs;
+}
+
+std::string ObjectStore::loosePath(const ObjectId& id) const {
+    std::string path=objectPath(id);
+    if(Utils::isFile(path))return path;
+    // 迁移中断时可能还有对象留在平铺目录
+    if(fanout&&Utils::isFile(flatPath(id)))return flatPath(id);
+    return "";
+}
+
+bool ObjectStore::exists(const ObjectId& id) const {
+    return !loosePath(id).empty()||isPacked(id);
+}
+
+bool ObjectStore::isPacked(const ObjectId& id) const {
+    for(const auto& pack:getPacks()){
+        if(pack->contains(id))return true;
+    }
+    return false;
+}
+
+std::string ObjectStore::modifiedPath(const ObjectId& id) const {
+    std::string path=loosePath(id);
+    if(path.empty()){
+        for(const auto& pack:getPacks()){
+            if(pack->contains(id)){
+                return pack->getPath();
+            }
+        }
+    }
+    return path;
+}
+
+std::time_t ObjectStore::modifiedTime(const ObjectId& id) const {
+    std::string path=modifiedPath(id);
+    struct stat st;
+    if(path.empty()||::stat(path.c_str(),&st)!=0)return 0;
+    return st.st_mtime;
+}
+
+const char ObjectStore::LOOSE_MAGIC[4]={'\0','G','L','O'};
+
+std::string ObjectStore::looseHeader(ObjectType type,uint8_t codec,uint64_t rawLength){
+    std::string header(LOOSE_MAGIC,sizeof(LOOSE_MAGIC));
+    header.push_back(static_cast<char>(type));
+    header.push_back(static_cast<char>(codec));
+    Utils::appendVarint(header,rawLength);
+    return header;
+}
+
+std::string ObjectStore::encodeLoose(const std::string& content,ObjectType type,uint8_t codec){
+    std::string payload;
+    if(codec==CODEC_LZ4){
+        payload=Compression::compressFrames(content);
+        // 压缩没有变小就原样存
+        if(payload.size()>=content.size()){
+            codec=CODEC_NONE;
+        }
+    }
+
+    std::string data=looseHeader(type,codec,content.size());
+    data+=codec==CODEC_NONE?content:payload;
+    return data;
+}
+
+std::string ObjectStore::decodeLoose(std::string_view data,ObjectType* type){
+    if(data.size()<sizeof(LOOSE_MAGIC)+2||std::memcmp(data.data(),LOOSE_MAGIC,sizeof(LOOSE_MAGIC))!=0){
+        if(type)*type=OBJ_UNKNOWN;
+        return std::string(data);
+    }
+    size_t pos=sizeof(LOOSE_MAGIC);
+    uint8_t object_type=static_cast<uint8_t>(data[pos++]);
+    uint8_t object_codec=static_cast<uint8_t>(data[pos++]);
+    uint64_t raw_length;
+    if(!Utils::readVarint(data,pos,raw_length)){
+        throw GitliteException("Corrupt object header");
+    }
+    if(type)*type=static_cast<ObjectType>(object_type);
+
+    switch(object_codec){
+    case CODEC_NONE:
+        if(data.size()-pos!=raw_length){
+            throw GitliteException("Corrupt object: size mismatch");
+        }
+        return std::string(data.substr(pos));
+    case CODEC_LZ4:
+        return Compression::decompressFrames(data,pos,raw_length);
+    default:
+        throw GitliteException("Unknown object compression");
+    }
+}
+
+void ObjectStore::write(const ObjectId& id,const std::string& content,ObjectType type) const {
+    // 已有的对象不原地重写：别的读者可能正映射着这个文件，截断会让它读到SIGBUS
+    if(exists(id)){
+        freshen(id);
+        return;
+    }
+    // 和ObjectWriter一样先写临时文件再改名，中途失败不会留下半个对象
+    std::string tmp_path=makeTempPath();
+    try{
+        Utils::writeContents(tmp_path,encodeLoose(content,type,codec));
+    }catch(...){
+        std::remove(tmp_path.c_str());
+        throw;
+    }
+    installObject(tmp_path,id);
+}
+
+void ObjectStore::freshen(const ObjectId& id) const {
+    std::string path=modifiedPath(id);
+    if(!path.empty()){
+        utime(path.c_str(),nullptr);
+    }
+}
+
+std::string ObjectStore::read(const ObjectId& id) const {
+    std::string path=loosePath(id);
+    if(!path.empty()){
+        // 直接从映射区域解码，省掉一次整文件拷贝
+        MappedFile file(path);
+        return decodeLoose(file.view());
+    }
+    std::string content;
+    for(const auto& pack:getPacks()){
+        if(pack->read(id,content))return content;
+    }
+    throw GitliteException("Object not found: "+id.toHex());
+}
+
+std::string ObjectStore::readPrefix(const ObjectId& id,size_t length) const {
+    if(!loosePath(id).empty()){
+        ObjectReader reader(*this,id);
+        std::string content(length,'\0');
+        size_t got=0;
+        while(got<length){
+            size_t n=reader.read(&content[got],length-got);
+            if(n==0)break;
+            got+=n;
+        }
+        content.resize(got);
+        return content;
+    }
+    std::string content;
+    for(const auto& pack:getPacks()){
+        if(pack->readPrefix(id,length,content))return content;
+    }
+    throw GitliteException("Object not found: "+id.toHex());
+}
+
+void ObjectStore::listShard(const std::string& shard,std::vector<ObjectId>& ids) const {
+    for(const auto& name:Utils::plainFilenamesIn(Utils::join(objects_dir,shard))){
+        std::string hex=shard+name;
+        if(ObjectId::isValidHex(hex)){
+            ids.push_back(ObjectId::fromHex(hex));
+        }
+    }
+}
+
+void ObjectStore::listFlat(const std::string& hexPrefix,std::vector<ObjectId>& ids) const {
+    for(const auto& name:Utils::plainFilenamesIn(objects_dir)){
+        if(ObjectId::isValidHex(name)&&name.compare(0,hexPrefix.length(),hexPrefix)==0){
+            ids.push_back(ObjectId::fromHex(name));
+        }
+    }
+}
+
+std::string ObjectStore::makeTempPath() const {
+    static int counter=0;
+    std::lock_guard<std::mutex> lock(write_mutex);
+    Utils::createDirectories(objects_dir);
+    return Utils::join(objects_dir,"tmp_obj_"+std::to_string(getpid())+"_"+std::to_string(counter++));
+}
+
+void ObjectStore::installObject(const std::string& tmpPath,const ObjectId& id) const {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    // 已经有这个对象时内容必然相同，丢掉临时文件即可
+    if(exists(id)){
+        std::remove(tmpPath.c_str());
+        freshen(id);
+        return;
+    }
+    std::string path=objectPath(id);
+    Utils::createDirectories(path.substr(0,path.find_last_of('/')));
+    if(std::rename(tmpPath.c_str(),path.c_str())!=0){
+        std::remove(tmpPath.c_str());
+        throw GitliteException("Failed to install object "+id.toHex());
+    }
+    index.add(id);
+}
+
+std::vector<ObjectId> ObjectStore::list() const {
+    return listWithPrefix("");
+}
+
+void ObjectStore::listLoose(const std::string& hexPrefix,std::vector<ObjectId>& ids) const {
+    listFlat(hexPrefix,ids);
+    if(fanout){
+        size_t first=ids.size();
+        if(hexPrefix.length()>=2){
+            listShard(hexPrefix.substr(0,2),ids);
+        }
+        else{
+            for(const auto& shard:Utils::subdirectoriesIn(objects_dir)){
+                if(shard.length()==2&&shard.compare(0,hexPrefix.length(),hexPrefix)==0){
+                    listShard(shard,ids);
+                }
+            }
+        }
+
+        // 分片目录里只按前两位筛选过，这里再按完整前缀过滤
+        std::string prefix=hexPrefix;
+        ids.erase(std::remove_if(ids.begin()+first,ids.end(),[&prefix](const ObjectId& id){
+            return id.toHex().compare(0,prefix.length(),prefix)!=0;
+        }),ids.end());
+    }
+}
+
+std::vector<ObjectId> ObjectStore::listWithPrefix(const std::string& hexPrefix) const {
+    std::vector<ObjectId> ids;
+    listLoose(hexPrefix,ids);
+    for(const auto& pack:getPacks()){
+        pack->listWithPrefix(hexPrefix,ids);
+    }
+    std::sort(ids.begin(),ids.end());
+    ids.erase(std::unique(ids.begin(),ids.end()),ids.end());
+    return ids;
+}
+
+std::vector<ObjectId> ObjectStore::resolvePrefix(const std::string& hexPrefix) const {
+    if(!index.load()){
+        rebuildIndex();
+    }
+    std::vector<ObjectId> ids=index.lookup(hexPrefix);
+    if(ids.empty()){
+        ids=listWithPrefix(hexPrefix);
+        if(!ids.empty()){
+            rebuildIndex();
+        }
+    }
+    return ids;
+}
+
+void ObjectStore::rebuildIndex() const {
+    index.rebuild(list());
+}
+
+int ObjectStore::repack(const std::vector<PackHint>& hints,const std::unordered_set<ObjectId>& drop){
+    std::vector<ObjectId> loose;
+    listLoose("",loose);
+    std::vector<std::string> old_packs;
+    for(const auto& pack:getPacks()){
+        old_packs.push_back(pack->getPath());
+    }
+    if(loose.empty()&&old_packs.size()<=1&&drop.empty()){
+        return 0;
+    }
+
+    // 先按提示排列，剩下的（commit和没有路径信息的blob）按ID接在后面
+    std::vector<ObjectId> all;
+    for(const auto& id:list()){
+        if(!drop.count(id))all.push_back(id);
+    }
+    std::vector<PackHint> order;
+    std::unordered_set<ObjectId> placed;
+    for(const auto& hint:hints){
+        if(std::binary_search(all.begin(),all.end(),hint.id)&&placed.insert(hint.id).second){
+            order.push_back(hint);
+        }
+    }
+    for(const auto& id:all){
+        if(placed.insert(id).second){
+            order.push_back({id,"",ObjectId()});
+        }
+    }
+
+    struct WindowEntry{
+        ObjectId id;
+        std::string content;
+        int depth;
+    };
+    std::deque<WindowEntry> window;
+    std::unordered_map<ObjectId,int> depths;   // 已写入对象的delta链长度，0表示完整存储
+
+    PackWriter writer(getPackDir());
+    for(const auto& item:order){
+        std::string content=read(item.id);
+
+        // delta至少要省下一半空间才值得多一次解码
+        std::string best_delta;
+        ObjectId best_base;
+        int best_depth=0;
+        size_t best_size=content.size()/2;
+        auto consider=[&](const ObjectId& base_id,const std::string& base,int depth){
+            if(depth>=PackFile::MAX_DELTA_DEPTH)return;
+            std::string delta=Delta::create(base,content);
+            if(delta.size()+ObjectId::RAW_LENGTH<best_size){
+                best_size=delta.size()+ObjectId::RAW_LENGTH;
+                best_delta.swap(delta);
+                best_base=base_id;
+                best_depth=depth+1;
+            }
+        };
+
+        if(content.size()>=4*Delta::BLOCK_SIZE){
+            // 首选父commit中同一路径的版本，它必须已经写进这个pack
+            auto base_depth=item.base.isNull()?depths.end():depths.find(item.base);
+            bool base_in_window=false;
+            for(const auto& entry:window){
+                if(entry.id==item.base)base_in_window=true;
+                consider(entry.id,entry.content,entry.depth);
+            }
+            if(base_depth!=depths.end()&&!base_in_window){
+                consider(item.base,read(item.base),base_depth->second);
+            }
+        }
+
+        if(best_base.isNull()){
+            writer.add(item.id,content);
+        }
+        else{
+            writer.addDelta(item.id,best_base,best_delta);
+        }
+        depths[item.id]=best_depth;
+        window.push_back({item.id,std::move(content),best_depth});
+        if(window.size()>DELTA_WINDOW){
+            window.pop_front();
+        }
+    }
+    std::string new_pack=Utils::join(getPackDir(),writer.finish()+".pack");
+
+    // 新pack落盘后才删除松散文件和旧pack，中途失败时对象仍然可读
+    for(const auto& id:loose){
+        std::string path=loosePath(id);
+        if(!path.empty()){
+            std::remove(path.c_str());
+        }
+    }
+    packs.clear();
+    packs_loaded=false;
+    for(const auto& pack_path:old_packs){
+        if(pack_path==new_pack)continue;
+        std::string idx_path=pack_path.substr(0,pack_path.size()-5)+".idx";
+        std::remove(idx_path.c_str());
+        std::remove(pack_path.c_str());
+    }
+    // 清掉已经空了的分片目录，非空目录rmdir会失败，不用管
+    for(const auto& shard:Utils::subdirectoriesIn(objects_dir)){
+        if(shard.length()==2){
+            ::rmdir(Utils::join(objects_dir,shard).c_str());
+        }
+    }
+    return static_cast<int>(order.size());
+}
+
+int ObjectStore::migrateToFanout(){
+    // 先写版本标记：迁移中断后读取仍会回退到平铺路径，重新执行即可继续
+    writeFormatVersion(gitlite_dir,FORMAT_VERSION);
+    reload();
+
+    int moved=0;
+    for(const auto& name:Utils::plainFilenamesIn(objects_dir)){
+        if(!ObjectId::isValidHex(name)){
+            continue;
+        }
+        ObjectId id=ObjectId::fromHex(name);
+        std::string target=fanoutPath(id);
+        Utils::createDirectories(Utils::join(objects_dir,name.substr(0,2)));
+        if(std::rename(flatPath(id).c_str(),target.c_str())!=0){
+            throw GitliteException("Failed to migrate object: "+name);
+        }
+        moved++;
+    }
+    return moved;
+}
+
+int ObjectStore::readFormatVersion(const std::string& gitliteDir){
+    std::string format_file=Utils::join(gitliteDir,"format");
+    if(!Utils::isFile(format_file)){
+        return 0;
+    }
+    try{
+        return std::stoi(Utils::readContentsAsString(format_file));
+    }catch(...){
+        return 0;
+    }
+}
+
+void ObjectStore::writeFormatVersion(const std::string& gitliteDir,int version){
+    Utils::writeContents(Utils::join(gitliteDir,"format"),std::to_string(version)+"\n");
+}
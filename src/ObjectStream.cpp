@@ -0,0 +1,222 @@
+#include"../include/ObjectStream.h"
+#include"../include/Compression.h"
+#include"../include/GitliteException.h"
+#include<cstring>
+#include<sys/stat.h>
+
+ObjectWriter::ObjectWriter(const ObjectStore& objectStore,ObjectType type,uint64_t size)
+    : store(objectStore),out(nullptr),codec(objectStore.getCodec()),expected_size(size),written(0){
+    tmp_path=store.makeTempPath();
+    out=std::fopen(tmp_path.c_str(),"wb");
+    if(!out){
+        throw GitliteException("Cannot create temporary object file");
+    }
+    // 空对象或不压缩时直接写原始数据
+    if(size==0)codec=ObjectStore::CODEC_NONE;
+    put(ObjectStore::looseHeader(type,codec,size));
+    if(codec!=ObjectStore::CODEC_NONE){
+        frame.reserve(Compression::FRAME_SIZE);
+    }
+}
+
+ObjectWriter::~ObjectWriter(){
+    // 没有finish（出错或提前退出）时清理临时文件
+    if(out){
+        std::fclose(out);
+        std::remove(tmp_path.c_str());
+    }
+}
+
+void ObjectWriter::put(const std::string& data){
+    if(std::fwrite(data.data(),1,data.size(),out)!=data.size()){
+        throw GitliteException("Failed to write object data");
+    }
+}
+
+void ObjectWriter::flushFrame(){
+    if(frame.empty())return;
+    encoded.clear();
+    Compression::appendFrame(encoded,frame.data(),frame.size());
+    put(encoded);
+    frame.clear();
+}
+
+void ObjectWriter::write(const char* data,size_t length){
+    if(length>expected_size-written){
+        throw GitliteException("Object larger than declared size");
+    }
+    hasher.update(data,length);
+    written+=length;
+    if(codec==ObjectStore::CODEC_NONE){
+        if(std::fwrite(data,1,length,out)!=length){
+            throw GitliteException("Failed to write object data");
+        }
+        return;
+    }
+    while(length>0){
+        size_t n=Compression::FRAME_SIZE-frame.size();
+        if(n>length)n=length;
+        frame.append(data,n);
+        data+=n;
+        length-=n;
+        if(frame.size()==Compression::FRAME_SIZE){
+            flushFrame();
+        }
+    }
+}
+
+ObjectId ObjectWriter::finish(const ObjectId& id){
+    if(written!=expected_size){
+        throw GitliteException("Object smaller than declared size");
+    }
+    flushFrame();
+    FILE* file=out;
+    out=nullptr;
+    if(std::fclose(file)!=0){
+        std::remove(tmp_path.c_str());
+        throw GitliteException("Failed to write object data");
+    }
+    uint8_t digest[ObjectId::RAW_LENGTH];
+    hasher.finalize(digest);
+    ObjectId object_id=id.isNull()?ObjectId::fromRaw(digest):id;
+    store.installObject(tmp_path,object_id);
+    return object_id;
+}
+
+ObjectReader::ObjectReader(const ObjectStore& store,const ObjectId& id)
+    : in(nullptr),codec(ObjectStore::CODEC_NONE),total_size(0),consumed(0),pending_pos(0),frame_pos(0),whole_pos(0){
+    std::string path=store.loosePath(id);
+    if(path.empty()){
+        // pack里的对象可能是delta，只能整体还原
+        whole=store.read(id);
+        total_size=whole.size();
+        return;
+    }
+
+    in=std::fopen(path.c_str(),"rb");
+    if(!in){
+        throw GitliteException("Object not found: "+id.toHex());
+    }
+    // 头部不超过 magic(4)+类型(1)+压缩方式(1)+varint(10)
+    pending.resize(16);
+    pending.resize(std::fread(&pending[0],1,pending.size(),in));
+
+    const size_t magic_length=sizeof(ObjectStore::LOOSE_MAGIC);
+    if(pending.size()<magic_length+2||std::memcmp(pending.data(),ObjectStore::LOOSE_MAGIC,magic_length)!=0){
+        // 没有头部的旧对象，整个文件就是内容
+        struct stat st;
+        if(fstat(fileno(in),&st)!=0){
+            throw GitliteException("Cannot stat object "+id.toHex());
+        }
+        total_size=static_cast<uint64_t>(st.st_size);
+        return;
+    }
+    size_t pos=magic_length+1;
+    codec=static_cast<uint8_t>(pending[pos++]);
+    if(!Utils::readVarint(pending,pos,total_size)){
+        throw GitliteException("Corrupt object header");
+    }
+    if(codec!=ObjectStore::CODEC_NONE&&codec!=ObjectStore::CODEC_LZ4){
+        throw GitliteException("Unknown object compression");
+    }
+    pending_pos=pos;
+}
+
+ObjectReader::~ObjectReader(){
+    if(in){
+        std::fclose(in);
+    }
+}
+
+size_t ObjectReader::readInput(char* buffer,size_t length){
+    size_t got=0;
+    if(pending_pos<pending.size()){
+        got=pending.size()-pending_pos<length?pending.size()-pending_pos:length;
+        std::memcpy(buffer,pending.data()+pending_pos,got);
+        pending_pos+=got;
+    }
+    if(got<length){
+        got+=std::fread(buffer+got,1,length-got,in);
+    }
+    return got;
+}
+
+bool ObjectReader::readInputVarint(uint64_t& value){
+    value=0;
+    for(int shift=0;shift<64;shift+=7){
+        char c;
+        if(readInput(&c,1)!=1)return false;
+        uint8_t byte=static_cast<uint8_t>(c);
+        value|=uint64_t(byte&0x7f)<<shift;
+        if(!(byte&0x80))return true;
+    }
+    return false;
+}
+
+void ObjectReader::nextFrame(){
+    uint64_t remaining=total_size-consumed;
+    size_t frame_length=remaining<Compression::FRAME_SIZE?static_cast<size_t>(remaining):Compression::FRAME_SIZE;
+    uint64_t tag;
+    if(!readInputVarint(tag)){
+        throw GitliteException("Corrupt compressed object: bad frame header");
+    }
+    uint64_t stored=tag>>1;
+    if(stored>Compression::FRAME_SIZE+Compression::FRAME_SIZE/255+16){
+        throw GitliteException("Corrupt compressed object: bad frame length");
+    }
+    std::string data(static_cast<size_t>(stored),'\0');
+    if(readInput(&data[0],data.size())!=data.size()){
+        throw GitliteException("Corrupt compressed object: truncated frame");
+    }
+    if(tag&1){
+        if(stored!=frame_length){
+            throw GitliteException("Corrupt compressed object: bad frame length");
+        }
+        frame.swap(data);
+    }
+    else{
+        frame.resize(frame_length);
+        if(!Compression::lz4Decompress(data.data(),data.size(),&frame[0],frame_length)){
+            throw GitliteException("Corrupt compressed object: bad frame data");
+        }
+    }
+    frame_pos=0;
+}
+
+size_t ObjectReader::read(char* buffer,size_t length){
+    uint64_t remaining=total_size-consumed;
+    if(length>remaining)length=static_cast<size_t>(remaining);
+    if(length==0)return 0;
+
+    size_t got;
+    if(!in){
+        std::memcpy(buffer,whole.data()+whole_pos,length);
+        whole_pos+=length;
+        got=length;
+    }
+    else if(codec==ObjectStore::CODEC_NONE){
+        got=readInput(buffer,length);
+        if(got==0){
+            throw GitliteException("Corrupt object: size mismatch");
+        }
+    }
+    else{
+        if(frame_pos==frame.size()){
+            nextFrame();
+        }
+        got=frame.size()-frame_pos<length?frame.size()-frame_pos:length;
+        std::memcpy(buffer,frame.data()+frame_pos,got);
+        frame_pos+=got;
+    }
+    consumed+=got;
+    return got;
+}
+
+std::string ObjectReader::readAll(){
+    std::string content(static_cast<size_t>(total_size-consumed),'\0');
+    size_t pos=0;
+    while(pos<content.size()){
+        pos+=read(&content[pos],content.size()-pos);
+    }
+    return content;
+}
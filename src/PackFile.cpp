@@ -0,0 +1,341 @@
+#include"../include/PackFile.h"
+#include"../include/GitliteException.h"
+#include"../include/Delta.h"
+#include<algorithm>
+#include<cstring>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+
+namespace {
+    const char PACK_MAGIC[4]={'G','L','P','K'};
+    const char IDX_MAGIC[4]={'G','L','I','X'};
+    const size_t PACK_HEADER_SIZE=8;
+    const size_t IDX_HEADER_SIZE=8+256*4;
+
+    uint32_t readBE32(const uint8_t* p){
+        return (uint32_t(p[0])<<24)|(uint32_t(p[1])<<16)|(uint32_t(p[2])<<8)|uint32_t(p[3]);
+    }
+
+    uint64_t readBE64(const uint8_t* p){
+        return (uint64_t(readBE32(p))<<32)|readBE32(p+4);
+    }
+
+    void writeBE32(uint8_t* p,uint32_t v){
+        p[0]=uint8_t(v>>24);p[1]=uint8_t(v>>16);p[2]=uint8_t(v>>8);p[3]=uint8_t(v);
+    }
+
+    void writeBE64(uint8_t* p,uint64_t v){
+        writeBE32(p,uint32_t(v>>32));
+        writeBE32(p+4,uint32_t(v));
+    }
+
+    //只读映射整个文件，失败返回nullptr
+    const uint8_t* mapFile(const std::string& path,size_t& size){
+        int fd=::open(path.c_str(),O_RDONLY);
+        if(fd<0)return nullptr;
+        struct stat st;
+        if(fstat(fd,&st)!=0||st.st_size==0){
+            ::close(fd);
+            return nullptr;
+        }
+        size=static_cast<size_t>(st.st_size);
+        void* addr=mmap(nullptr,size,PROT_READ,MAP_PRIVATE,fd,0);
+        ::close(fd);
+        return addr==MAP_FAILED?nullptr:static_cast<const uint8_t*>(addr);
+    }
+}
+
+PackFile::PackFile() : idx_data(nullptr),idx_size(0),pack_data(nullptr),pack_size(0),count(0),base_cache_bytes(0){}
+
+PackFile::~PackFile(){
+    if(idx_data)munmap(const_cast<uint8_t*>(idx_data),idx_size);
+    if(pack_data)munmap(const_cast<uint8_t*>(pack_data),pack_size);
+}
+
+std::unique_ptr<PackFile> PackFile::open(const std::string& idxPath){
+    if(idxPath.size()<4||idxPath.compare(idxPath.size()-4,4,".idx")!=0){
+        return nullptr;
+    }
+    std::unique_ptr<PackFile> pack(new PackFile());
+    pack->pack_path=idxPath.substr(0,idxPath.size()-4)+".pack";
+
+    pack->idx_data=mapFile(idxPath,pack->idx_size);
+    if(!pack->idx_data||pack->idx_size<IDX_HEADER_SIZE+ObjectId::RAW_LENGTH
+     ||std::memcmp(pack->idx_data,IDX_MAGIC,4)!=0||readBE32(pack->idx_data+4)!=VERSION){
+        return nullptr;
+    }
+    pack->count=readBE32(pack->idx_data+8+255*4);
+    if(pack->idx_size!=IDX_HEADER_SIZE+pack->count*ENTRY_SIZE+ObjectId::RAW_LENGTH){
+        return nullptr;
+    }
+    // fanout必须单调不减且不超过条目数，否则查找时的二分范围会越出条目表；坏的索引当作损坏的pack
+    uint32_t previous=0;
+    for(int b=0;b<256;b++){
+        uint32_t bound=readBE32(pack->idx_data+8+b*4);
+        if(bound<previous||bound>pack->count){
+            return nullptr;
+        }
+        previous=bound;
+    }
+
+    pack->pack_data=mapFile(pack->pack_path,pack->pack_size);
+    if(!pack->pack_data||pack->pack_size<PACK_HEADER_SIZE+ObjectId::RAW_LENGTH
+     ||std::memcmp(pack->pack_data,PACK_MAGIC,4)!=0||readBE32(pack->pack_data+4)!=VERSION){
+        return nullptr;
+    }
+    // idx末尾记录的校验和要和pack末尾一致，防止配错文件
+    if(std::memcmp(pack->idx_data+pack->idx_size-ObjectId::RAW_LENGTH,
+                   pack->pack_data+pack->pack_size-ObjectId::RAW_LENGTH,ObjectId::RAW_LENGTH)!=0){
+        return nullptr;
+    }
+    // 索引只会被随机访问
+    madvise(const_cast<uint8_t*>(pack->idx_data),pack->idx_size,MADV_RANDOM);
+    return pack;
+}
+
+const uint8_t* PackFile::entryAt(size_t i) const {
+    return idx_data+IDX_HEADER_SIZE+i*ENTRY_SIZE;
+}
+
+ObjectId PackFile::idAt(size_t i) const {
+    return ObjectId::fromRaw(entryAt(i));
+}
+
+long PackFile::find(const ObjectId& id) const {
+    uint8_t first=id.data()[0];
+    size_t lo=first==0?0:readBE32(idx_data+8+(first-1)*4);
+    size_t hi=readBE32(idx_data+8+first*4);
+    while(lo<hi){
+        size_t mid=lo+(hi-lo)/2;
+        int cmp=std::memcmp(entryAt(mid),id.data(),ObjectId::RAW_LENGTH);
+        if(cmp==0)return static_cast<long>(mid);
+        if(cmp<0)lo=mid+1;
+        else hi=mid;
+    }
+    return -1;
+}
+
+bool PackFile::contains(const ObjectId& id) const {
+    return find(id)>=0;
+}
+
+bool PackFile::read(const ObjectId& id,std::string& content) const {
+    long i=find(id);
+    if(i<0)return false;
+    content=readEntry(static_cast<size_t>(i),0);
+    return true;
+}
+
+std::string PackFile::readEntry(size_t i,int depth) const {
+    const uint8_t* entry=entryAt(i);
+    uint64_t offset=readBE64(entry+ObjectId::RAW_LENGTH);
+    uint64_t length=readBE64(entry+ObjectId::RAW_LENGTH+8);
+    if(offset<PACK_HEADER_SIZE||offset+1+length>pack_size-ObjectId::RAW_LENGTH){
+        throw GitliteException("Corrupt pack entry "+idAt(i).toHex()+" in "+pack_path);
+    }
+    const char* data=reinterpret_cast<const char*>(pack_data+offset+1);
+
+    switch(pack_data[offset]){
+    case ENTRY_FULL:
+        return std::string(data,length);
+    case ENTRY_DELTA:{
+        if(length<ObjectId::RAW_LENGTH){
+            throw GitliteException("Corrupt delta entry "+idAt(i).toHex()+" in "+pack_path);
+        }
+        ObjectId base_id=ObjectId::fromRaw(reinterpret_cast<const uint8_t*>(data));
+        std::string base=readBase(base_id,depth+1);
+        return Delta::apply(base,std::string(data+ObjectId::RAW_LENGTH,length-ObjectId::RAW_LENGTH));
+    }
+    default:
+        throw GitliteException("Unknown pack entry type in "+pack_path);
+    }
+}
+
+bool PackFile::readPrefix(const ObjectId& id,size_t length,std::string& content) const {
+    long i=find(id);
+    if(i<0)return false;
+    content=readEntryRange(static_cast<size_t>(i),0,length,0);
+    return true;
+}
+
+std::string PackFile::readEntryRange(size_t i,uint64_t offset,uint64_t length,int depth) const {
+    if(depth>4*MAX_DELTA_DEPTH){
+        throw GitliteException("Delta chain too deep in "+pack_path);
+    }
+    const uint8_t* entry=entryAt(i);
+    uint64_t entry_offset=readBE64(entry+ObjectId::RAW_LENGTH);
+    uint64_t entry_length=readBE64(entry+ObjectId::RAW_LENGTH+8);
+    if(entry_offset<PACK_HEADER_SIZE||entry_offset+1+entry_length>pack_size-ObjectId::RAW_LENGTH){
+        throw GitliteException("Corrupt pack entry "+idAt(i).toHex()+" in "+pack_path);
+    }
+    const char* data=reinterpret_cast<const char*>(pack_data+entry_offset+1);
+
+    switch(pack_data[entry_offset]){
+    case ENTRY_FULL:
+        if(offset>=entry_length)return "";
+        return std::string(data+offset,std::min(length,entry_length-offset));
+    case ENTRY_DELTA:{
+        if(entry_length<ObjectId::RAW_LENGTH){
+            throw GitliteException("Corrupt delta entry "+idAt(i).toHex()+" in "+pack_path);
+        }
+        ObjectId base_id=ObjectId::fromRaw(reinterpret_cast<const uint8_t*>(data));
+        long base=find(base_id);
+        if(base<0){
+            throw GitliteException("Missing delta base "+base_id.toHex()+" in "+pack_path);
+        }
+        return Delta::applyRange(std::string(data+ObjectId::RAW_LENGTH,entry_length-ObjectId::RAW_LENGTH),offset,length,
+                                 [&](uint64_t from,uint64_t count){
+            std::string part=readEntryRange(static_cast<size_t>(base),from,count,depth+1);
+            if(part.size()!=count){
+                throw GitliteException("Corrupt delta entry "+idAt(i).toHex()+" in "+pack_path);
+            }
+            return part;
+        });
+    }
+    default:
+        throw GitliteException("Unknown pack entry type in "+pack_path);
+    }
+}
+
+std::string PackFile::readBase(const ObjectId& id,int depth) const {
+    {
+        std::lock_guard<std::mutex> lock(base_cache_mutex);
+        auto it=base_cache_map.find(id);
+        if(it!=base_cache_map.end()){
+            base_cache.splice(base_cache.begin(),base_cache,it->second);
+            return it->second->second;
+        }
+    }
+
+    // 写入时链长不超过MAX_DELTA_DEPTH，这里留足余量，只拦截损坏导致的环
+    if(depth>4*MAX_DELTA_DEPTH){
+        throw GitliteException("Delta chain too deep in "+pack_path);
+    }
+    long i=find(id);
+    if(i<0){
+        throw GitliteException("Missing delta base "+id.toHex()+" in "+pack_path);
+    }
+    std::string content=readEntry(static_cast<size_t>(i),depth);
+    cacheBase(id,content);
+    return content;
+}
+
+void PackFile::cacheBase(const ObjectId& id,const std::string& content) const {
+    if(content.size()>BASE_CACHE_LIMIT/4){
+        return;
+    }
+    std::lock_guard<std::mutex> lock(base_cache_mutex);
+    // 其他线程可能刚解出同一个基准
+    if(base_cache_map.count(id))return;
+    base_cache.emplace_front(id,content);
+    base_cache_map[id]=base_cache.begin();
+    base_cache_bytes+=content.size();
+    while(base_cache_bytes>BASE_CACHE_LIMIT){
+        base_cache_bytes-=base_cache.back().second.size();
+        base_cache_map.erase(base_cache.back().first);
+        base_cache.pop_back();
+    }
+}
+
+void PackFile::listWithPrefix(const std::string& hexPrefix,std::vector<ObjectId>& ids) const {
+    for(size_t i=0;i<count;i++){
+        ObjectId id=idAt(i);
+        if(id.toHex().compare(0,hexPrefix.length(),hexPrefix)==0){
+            ids.push_back(id);
+        }
+    }
+}
+
+PackWriter::PackWriter(const std::string& packDir) : pack_dir(packDir),out(nullptr),offset(0){
+    Utils::createDirectories(pack_dir);
+    tmp_path=Utils::join(pack_dir,"tmp_pack_"+std::to_string(getpid()));
+    out=std::fopen(tmp_path.c_str(),"wb");
+    if(!out){
+        throw GitliteException("Cannot create pack file in "+pack_dir);
+    }
+    uint8_t header[PACK_HEADER_SIZE];
+    std::memcpy(header,PACK_MAGIC,4);
+    writeBE32(header+4,PackFile::VERSION);
+    put(header,sizeof(header));
+}
+
+PackWriter::~PackWriter(){
+    // 没有finish就析构说明中途出错，丢掉临时文件
+    if(out){
+        std::fclose(out);
+        std::remove(tmp_path.c_str());
+    }
+}
+
+void PackWriter::put(const void* data,size_t length){
+    if(std::fwrite(data,1,length,out)!=length){
+        throw GitliteException("Failed to write pack file");
+    }
+    hasher.update(data,length);
+    offset+=length;
+}
+
+void PackWriter::add(const ObjectId& id,const std::string& content){
+    entries.push_back({id,offset,content.size()});
+    uint8_t type=PackFile::ENTRY_FULL;
+    put(&type,1);
+    put(content.data(),content.size());
+}
+
+void PackWriter::addDelta(const ObjectId& id,const ObjectId& base,const std::string& delta){
+    entries.push_back({id,offset,ObjectId::RAW_LENGTH+delta.size()});
+    uint8_t type=PackFile::ENTRY_DELTA;
+    put(&type,1);
+    put(base.data(),ObjectId::RAW_LENGTH);
+    put(delta.data(),delta.size());
+}
+
+std::string PackWriter::finish(){
+    uint8_t checksum[ObjectId::RAW_LENGTH];
+    hasher.finalize(checksum);
+    if(std::fwrite(checksum,1,sizeof(checksum),out)!=sizeof(checksum)||std::fclose(out)!=0){
+        out=nullptr;
+        std::remove(tmp_path.c_str());
+        throw GitliteException("Failed to write pack file");
+    }
+    out=nullptr;
+
+    std::sort(entries.begin(),entries.end(),[](const Entry& a,const Entry& b){return a.id<b.id;});
+    entries.erase(std::unique(entries.begin(),entries.end(),[](const Entry& a,const Entry& b){
+        return a.id==b.id;
+    }),entries.end());
+
+    std::string idx(IDX_HEADER_SIZE+entries.size()*PackFile::ENTRY_SIZE+ObjectId::RAW_LENGTH,'\0');
+    uint8_t* p=reinterpret_cast<uint8_t*>(&idx[0]);
+    std::memcpy(p,IDX_MAGIC,4);
+    writeBE32(p+4,PackFile::VERSION);
+    size_t n=0;
+    for(int b=0;b<256;b++){
+        while(n<entries.size()&&entries[n].id.data()[0]==b)n++;
+        writeBE32(p+8+b*4,static_cast<uint32_t>(n));
+    }
+    uint8_t* e=p+IDX_HEADER_SIZE;
+    for(const auto& entry:entries){
+        std::memcpy(e,entry.id.data(),ObjectId::RAW_LENGTH);
+        writeBE64(e+ObjectId::RAW_LENGTH,entry.offset);
+        writeBE64(e+ObjectId::RAW_LENGTH+8,entry.length);
+        e+=PackFile::ENTRY_SIZE;
+    }
+    std::memcpy(e,checksum,ObjectId::RAW_LENGTH);
+
+    // 先放好pack再放idx：读取方只认有idx的pack
+    std::string name="pack-"+ObjectId::fromRaw(checksum).toHex();
+    std::string pack_path=Utils::join(pack_dir,name+".pack");
+    if(std::rename(tmp_path.c_str(),pack_path.c_str())!=0){
+        std::remove(tmp_path.c_str());
+        throw GitliteException("Failed to install pack file "+name);
+    }
+    std::string idx_tmp=Utils::join(pack_dir,name+".idx.tmp");
+    Utils::writeContents(idx_tmp,idx);
+    if(std::rename(idx_tmp.c_str(),Utils::join(pack_dir,name+".idx").c_str())!=0){
+        throw GitliteException("Failed to install pack index "+name);
+    }
+    return name;
+}
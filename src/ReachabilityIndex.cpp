@@ -0,0 +1,297 @@
+#include"../include/ReachabilityIndex.h"
+#include"../include/Blob.h"
+#include"../include/Commit.h"
+#include"../include/GitliteException.h"
+#include"../include/MappedFile.h"
+#include"../include/Tree.h"
+#include"../include/Utils.h"
+#include<algorithm>
+#include<cstdio>
+#include<cstring>
+#include<functional>
+#include<unordered_set>
+
+namespace {
+    const std::string BITMAP_MAGIC="GLBITMP1";
+
+    uint64_t readBE(const uint8_t* p,int bytes){
+        uint64_t v=0;
+        for(int i=0;i<bytes;i++){
+            v=(v<<8)|p[i];
+        }
+        return v;
+    }
+
+    void appendBE(std::string& out,uint64_t v,int bytes){
+        for(int i=bytes-1;i>=0;i--){
+            out.push_back(static_cast<char>(v>>(8*i)));
+        }
+    }
+
+    void corrupt(){
+        throw GitliteException("Corrupt bitmap index");
+    }
+
+    bool contains(const ReachabilityIndex::ObjectSet& set,uint32_t pos,const ObjectId& id){
+        if(pos!=ReachabilityIndex::NONE){
+            return pos/64<set.bits.size()&&((set.bits[pos/64]>>(pos%64))&1);
+        }
+        return set.extra.count(id)>0;
+    }
+}
+
+uint32_t ReachabilityIndex::Snapshot::position(const ObjectId& id) const {
+    auto it=std::lower_bound(ids.begin(),ids.end(),id);
+    return it!=ids.end()&&*it==id?static_cast<uint32_t>(it-ids.begin()):NONE;
+}
+
+ReachabilityIndex::ReachabilityIndex(const std::string& gitliteDir,const ObjectStore& objectStore)
+    : store(objectStore),index_file(Utils::join(gitliteDir,"bitmaps")){}
+
+ReachabilityIndex::~ReachabilityIndex(){}
+
+bool ReachabilityIndex::exists() const {
+    return Utils::isFile(index_file);
+}
+
+const ReachabilityIndex::Snapshot& ReachabilityIndex::snapshot() const {
+    if(loaded)return *loaded;
+    loaded.reset(new Snapshot());
+    if(!exists())return *loaded;
+
+    // 索引损坏时当作没有索引，全部照常遍历
+    try{
+        MappedFile file(index_file,MappedFile::SEQUENTIAL);
+        std::string_view data=file.view();
+        const uint8_t* p=reinterpret_cast<const uint8_t*>(data.data());
+        if(data.size()<BITMAP_MAGIC.length()+4||data.compare(0,BITMAP_MAGIC.length(),BITMAP_MAGIC)!=0)corrupt();
+        size_t pos=BITMAP_MAGIC.length();
+        uint64_t count=readBE(p+pos,4);
+        pos+=4;
+        if(count>(data.size()-pos)/(ObjectId::RAW_LENGTH+1))corrupt();
+        std::unique_ptr<Snapshot> snap(new Snapshot());
+        snap->ids.reserve(count);
+        for(uint64_t i=0;i<count;i++){
+            snap->ids.push_back(ObjectId::fromRaw(p+pos));
+            pos+=ObjectId::RAW_LENGTH;
+        }
+        snap->types.assign(p+pos,p+pos+count);
+        pos+=count;
+        if(data.size()-pos<4)corrupt();
+        uint64_t bitmaps=readBE(p+pos,4);
+        pos+=4;
+        for(uint64_t i=0;i<bitmaps;i++){
+            if(data.size()-pos<ObjectId::RAW_LENGTH)corrupt();
+            ObjectId commit=ObjectId::fromRaw(p+pos);
+            pos+=ObjectId::RAW_LENGTH;
+            snap->bitmaps.emplace(commit,EwahBitmap::deserialize(data,pos));
+        }
+        loaded=std::move(snap);
+    }catch(const std::exception&){
+        loaded.reset(new Snapshot());
+    }
+    return *loaded;
+}
+
+void ReachabilityIndex::walk(const Snapshot& snap,const std::vector<Object>& roots,const ObjectSet* exclude,
+                             ObjectSet& result,std::vector<uint8_t>* types) const {
+    result.bits.resize(std::max(result.bits.size(),(snap.ids.size()+63)/64),0);
+    std::vector<Object> stack(roots.rbegin(),roots.rend());
+    while(!stack.empty()){
+        Object object=stack.back();
+        stack.pop_back();
+        const ObjectId& id=object.first;
+        if(id.isNull())continue;
+        uint32_t pos=snap.position(id);
+        if(contains(result,pos,id)||(exclude&&contains(*exclude,pos,id))){
+            continue;
+        }
+        // 有位图的commit：它能到达的对象整张并入，不再往下走
+        if(object.second==OBJ_COMMIT){
+            auto it=snap.bitmaps.find(id);
+            if(it!=snap.bitmaps.end()){
+                it->second.orInto(result.bits);
+                continue;
+            }
+        }
+        if(pos!=NONE){
+            result.bits[pos/64]|=uint64_t(1)<<(pos%64);
+            if(types)(*types)[pos]=object.second;
+        }
+        else{
+            result.extra[id]=object.second;
+        }
+
+        switch(object.second){
+        case OBJ_COMMIT:{
+            Commit commit=Commit::load(store,id);
+            for(const auto& parent:commit.getParents()){
+                stack.push_back({parent,OBJ_COMMIT});
+            }
+            if(!commit.getTree().isNull()){
+                stack.push_back({commit.getTree(),OBJ_TREE});
+            }
+            else{
+                for(const auto& blob:commit.getBlobs()){
+                    stack.push_back({blob.second,OBJ_BLOB});
+                }
+            }
+            break;
+        }
+        case OBJ_TREE:
+            for(const auto& entry:Tree::load(store,id)){
+                stack.push_back({entry.id,entry.type==OBJ_TREE?OBJ_TREE:OBJ_BLOB});
+            }
+            break;
+        default:
+            // 分块存储的blob还引用着各个块
+            for(const auto& chunk:Blob::chunkIds(store,id)){
+                stack.push_back({chunk,OBJ_BLOB});
+            }
+            break;
+        }
+    }
+}
+
+ReachabilityIndex::ObjectSet ReachabilityIndex::reachable(const std::vector<ObjectId>& commits,const std::vector<ObjectId>& blobs) const {
+    std::vector<Object> roots;
+    for(const auto& commit:commits){
+        roots.push_back({commit,OBJ_COMMIT});
+    }
+    for(const auto& blob:blobs){
+        roots.push_back({blob,OBJ_BLOB});
+    }
+    ObjectSet result;
+    walk(snapshot(),roots,nullptr,result,nullptr);
+    return result;
+}
+
+std::vector<ReachabilityIndex::Object> ReachabilityIndex::missing(const std::vector<ObjectId>& want,const std::vector<ObjectId>& have) const {
+    const Snapshot& snap=snapshot();
+    ObjectSet have_set=reachable(have);
+    ObjectSet want_set;
+    std::vector<Object> roots;
+    for(const auto& commit:want){
+        roots.push_back({commit,OBJ_COMMIT});
+    }
+    // have里已有的对象不再展开；位图并入时带进来的部分由下面的与非去掉
+    walk(snap,roots,&have_set,want_set,nullptr);
+    for(size_t i=0;i<want_set.bits.size()&&i<have_set.bits.size();i++){
+        want_set.bits[i]&=~have_set.bits[i];
+    }
+
+    std::vector<ObjectId> blobs,trees,commits;
+    auto add=[&](const ObjectId& id,uint8_t type){
+        if(type==OBJ_COMMIT)commits.push_back(id);
+        else if(type==OBJ_TREE)trees.push_back(id);
+        else blobs.push_back(id);
+    };
+    for(size_t w=0;w<want_set.bits.size();w++){
+        uint64_t word=want_set.bits[w];
+        while(word){
+            size_t pos=w*64+__builtin_ctzll(word);
+            word&=word-1;
+            add(snap.ids[pos],snap.types[pos]);
+        }
+    }
+    std::vector<Object> extra(want_set.extra.begin(),want_set.extra.end());
+    std::sort(extra.begin(),extra.end());
+    for(const auto& object:extra){
+        if(!have_set.extra.count(object.first)){
+            add(object.first,object.second);
+        }
+    }
+
+    // blob没有引用别的对象（块清单的块由复制时一并处理）；tree和commit按依赖排序，被引用的先写
+    std::vector<Object> ordered;
+    for(const auto& blob:blobs){
+        ordered.push_back({blob,OBJ_BLOB});
+    }
+    std::unordered_set<ObjectId> pending_trees(trees.begin(),trees.end());
+    std::function<void(const ObjectId&)> visitTree=[&](const ObjectId& id){
+        if(!pending_trees.erase(id))return;
+        for(const auto& entry:Tree::load(store,id)){
+            if(entry.type==OBJ_TREE)visitTree(entry.id);
+        }
+        ordered.push_back({id,OBJ_TREE});
+    };
+    for(const auto& tree:trees){
+        visitTree(tree);
+    }
+    // 历史可能很长，commit用显式栈
+    std::unordered_set<ObjectId> pending_commits(commits.begin(),commits.end());
+    for(const auto& start:commits){
+        if(!pending_commits.count(start))continue;
+        std::vector<std::pair<ObjectId,bool>> stack{{start,false}};
+        while(!stack.empty()){
+            auto top=stack.back();
+            stack.pop_back();
+            if(top.second){
+                ordered.push_back({top.first,OBJ_COMMIT});
+                continue;
+            }
+            if(!pending_commits.erase(top.first))continue;
+            stack.push_back({top.first,true});
+            Commit commit=Commit::load(store,top.first);
+            for(const auto& parent:commit.getParents()){
+                if(pending_commits.count(parent))stack.push_back({parent,false});
+            }
+        }
+    }
+    return ordered;
+}
+
+std::vector<ObjectId> ReachabilityIndex::idsOf(const ObjectSet& set) const {
+    const Snapshot& snap=snapshot();
+    std::vector<ObjectId> ids;
+    for(size_t w=0;w<set.bits.size();w++){
+        uint64_t word=set.bits[w];
+        while(word){
+            ids.push_back(snap.ids[w*64+__builtin_ctzll(word)]);
+            word&=word-1;
+        }
+    }
+    for(const auto& object:set.extra){
+        ids.push_back(object.first);
+    }
+    return ids;
+}
+
+size_t ReachabilityIndex::rebuild(const std::vector<ObjectId>& commits){
+    std::unique_ptr<Snapshot> snap(new Snapshot());
+    snap->ids=store.list();
+    snap->types.assign(snap->ids.size(),OBJ_UNKNOWN);
+
+    // 按时间从旧到新建，后面的分支头遍历到前面已经建好位图的commit时直接并入
+    std::vector<std::pair<std::time_t,ObjectId>> order;
+    for(const auto& commit:commits){
+        if(!commit.isNull())order.push_back({Commit::load(store,commit).getTimestamp(),commit});
+    }
+    std::sort(order.begin(),order.end());
+    order.erase(std::unique(order.begin(),order.end()),order.end());
+    for(const auto& entry:order){
+        ObjectSet set;
+        walk(*snap,{{entry.second,OBJ_COMMIT}},nullptr,set,&snap->types);
+        snap->bitmaps.emplace(entry.second,EwahBitmap::compress(set.bits));
+    }
+
+    std::string data=BITMAP_MAGIC;
+    appendBE(data,snap->ids.size(),4);
+    for(const auto& id:snap->ids){
+        data.append(reinterpret_cast<const char*>(id.data()),ObjectId::RAW_LENGTH);
+    }
+    data.append(reinterpret_cast<const char*>(snap->types.data()),snap->types.size());
+    appendBE(data,snap->bitmaps.size(),4);
+    for(const auto& entry:order){
+        data.append(reinterpret_cast<const char*>(entry.second.data()),ObjectId::RAW_LENGTH);
+        snap->bitmaps.at(entry.second).serialize(data);
+    }
+
+    // 先写临时文件再rename，避免中途失败留下半个索引
+    std::string tmp_file=index_file+".tmp";
+    Utils::writeContents(tmp_file,data);
+    std::rename(tmp_file.c_str(),index_file.c_str());
+    size_t count=snap->bitmaps.size();
+    loaded=std::move(snap);
+    return count;
+}
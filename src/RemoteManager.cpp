@@ -3,8 +3,10 @@
 #include"../include/Utils.h"
 #include"../include/Commit.h"
 #include"../include/Blob.h"
+#include"../include/Tree.h"
 #include<sstream>
 #include<iostream>
+#include<unordered_set>
 
 RemoteManager::RemoteManager(RepositoryCore* repoCore) : core(repoCore) {}
 
@@ -45,73 +47,40 @@ void RemoteManager::push(const std::string& remoteName,const std::string& remote
     }
 
     // 获取本地当前分支头部commit
-    std::string local_branch_head=core->getBranchHead(core->getCurrentBranch());
+    ObjectId local_branch_head=core->getBranchHead(core->getCurrentBranch());
     std::string remote_branch_file=Utils::join(remote_gitlite_dir,"branches",remoteBranchName);
 
     // 读取远程分支头部commit
-    std::string remote_branch_head;
+    ObjectId remote_branch_head;
     if(Utils::exists(remote_branch_file)){
-        remote_branch_head=Utils::readContentsAsString(remote_branch_file);
+        remote_branch_head=ObjectId::fromHex(Utils::readContentsAsString(remote_branch_file));
     }
     
-    // 检查远程分支是否在本地历史中
-    bool found_in_history=false;
-    std::string current_commit=local_branch_head;
-    while(!current_commit.empty()){
-        if(current_commit==remote_branch_head){
-            found_in_history=true;
-            break;
-        }
-        std::string commit_file=Utils::join(".gitlite/objects",current_commit);
-        Commit commit=Commit::fromFile(commit_file);
-        auto parents=commit.getParents();
-        current_commit=parents.empty()?"":parents[0];
-    }
+    const ObjectStore& local_store=core->getObjectStore();
+    ObjectStore remote_store(remote_gitlite_dir);  // 远程仓库可能仍是旧的平铺布局
+
+    // 检查远程分支是否在本地历史中（本地没有这个commit时肯定不在），经过commit图，合并进来的分支也算
+    bool found_in_history=!remote_branch_head.isNull()&&local_store.exists(remote_branch_head)
+                        &&core->getCommitGraph().isAncestor(remote_branch_head,local_branch_head);
 
     // 如果远程分支存在但不在本地历史中，要求先pull
-    if(!remote_branch_head.empty()&&!found_in_history){
+    if(!remote_branch_head.isNull()&&!found_in_history){
         Utils::exitWithMessage("Please pull down remote changes before pushing.");
     }
 
-    // 收集需要复制的commits
-    std::vector<std::string> commits_to_copy;
-    current_commit=local_branch_head;
-    while(!current_commit.empty()&&current_commit!=remote_branch_head){
-        commits_to_copy.push_back(current_commit);
-        std::string commit_file=Utils::join(".gitlite/objects",current_commit);
-        Commit commit=Commit::fromFile(commit_file);
-        auto parents=commit.getParents();
-        current_commit=parents.empty()?"":parents[0];
+    // 从本地分支头可达、从远程分支头不可达的对象就是要复制的，合并进来的旁支也包括在内
+    std::vector<ObjectId> have;
+    if(!remote_branch_head.isNull()){
+        have.push_back(remote_branch_head);
     }
+    auto objects=core->getReachabilityIndex().missing({local_branch_head},have);
 
-    // 复制commits和相关的blobs到远程仓库
-    for(auto it=commits_to_copy.rbegin();it!=commits_to_copy.rend();it++){
-        std::string commit_id=*it;
-        std::string local_commit_path=Utils::join(".gitlite/objects",commit_id);
-        std::string remote_commit_path=Utils::join(remote_gitlite_dir,"objects",commit_id);
-        
-        if(!Utils::exists(remote_commit_path)){
-            // 复制commit文件
-            std::string commit_file=Utils::join(".gitlite/objects",commit_id);
-            Commit commit=Commit::fromFile(commit_file);
-            Utils::writeContents(remote_commit_path,commit.serialize());
-
-            // 复制commit相关的所有blob文件
-            for(const auto& blob:commit.getBlobs()){
-                std::string blob_id=blob.second;
-                std::string local_blob_path=Utils::join(".gitlite/objects",blob_id);
-                std::string remote_blob_path=Utils::join(remote_gitlite_dir,"objects",blob_id);
-
-                if(!Utils::exists(remote_blob_path)){
-                    std::string blob_content=Utils::readContentsAsString(local_blob_path);
-                    Utils::writeContents(remote_blob_path,blob_content);
-                }
-            }
-        }
-    }
+    CommitCatalog remote_catalog(remote_gitlite_dir,remote_store);
+    CommitGraph remote_graph(remote_gitlite_dir,remote_catalog);
+    copyObjects(local_store,remote_store,objects,remote_catalog,remote_graph);
 
     // 更新远程分支指针指向本地分支头
-    Utils::writeContents(remote_branch_file,local_branch_head);
+    Utils::writeContents(remote_branch_file,local_branch_head.toHex());
 }
 
 void RemoteManager::fetch(const std::string& remoteName,const std::string& remoteBranchName){
@@ -136,87 +105,40 @@ void RemoteManager::fetch(const std::string& remoteName,const std::string& remot
         Utils::exitWithMessage("That remote does not have that branch.");
     }
 
-    std::string remote_branch_head=Utils::readContentsAsString(remote_branch_file);
+    ObjectId remote_branch_head=ObjectId::fromHex(Utils::readContentsAsString(remote_branch_file));
     std::string local_tracking_branch=remoteName+"/"+remoteBranchName;  // 本地跟踪分支名
 
-    std::set<std::string> copied_commits; 
-    std::vector<std::string> commits_to_copy; 
-    std::string current_commit=remote_branch_head;
-
-    // 遍历远程分支的commit历史，复制缺失的commits
-    while(!current_commit.empty()&&copied_commits.find(current_commit)==copied_commits.end()){
-        std::string local_commit_path=Utils::join(".gitlite/objects",current_commit);
-        
-        if(Utils::exists(local_commit_path)){
-            copied_commits.insert(current_commit);
-            std::string commit_file=Utils::join(".gitlite/objects",current_commit);
-            Commit commit=Commit::fromFile(commit_file);
-            bool has_new_parent=false;
-            auto parents=commit.getParents();
-            for(const auto& parent : parents){
-                if(copied_commits.find(parent)==copied_commits.end()){
-                    current_commit=parent;
-                    has_new_parent=true;  // 发现新的父commit需要复制
-                    break;
-                }
-            }
-
-            if(!has_new_parent){
-                break;
-            }
+    const ObjectStore& local_store=core->getObjectStore();
+    ObjectStore remote_store(remote_gitlite_dir);
+
+    // 在远程历史里找本地已有的边界commit，它们能到达的对象本地都有
+    std::vector<ObjectId> have;
+    std::unordered_set<ObjectId> visited;
+    std::vector<ObjectId> stack{remote_branch_head};
+    while(!stack.empty()){
+        ObjectId current=stack.back();
+        stack.pop_back();
+        if(current.isNull()||!visited.insert(current).second){
+            continue;
         }
-        else{
-            // 本地没有该commit，需要从远程复制
-            commits_to_copy.push_back(current_commit);
-            copied_commits.insert(current_commit);
-            std::string remote_commit_path=Utils::join(remote_gitlite_dir,"objects",current_commit);
-            if(Utils::exists(remote_commit_path)){
-                Commit remote_commit=Commit::fromFile(remote_commit_path);
-                bool has_new_parent=false;
-                auto parents=remote_commit.getParents();
-                for(const auto& parent : parents){
-                    if(copied_commits.find(parent)==copied_commits.end()){
-                        current_commit=parent;
-                        has_new_parent=true;
-                        break;
-                    }
-                }
-                if(!has_new_parent){
-                    break;
-                }
-            }
-            else{
-                Utils::exitWithMessage("Remote commit not found."); 
-            } 
+        if(local_store.exists(current)){
+            have.push_back(current);
+            continue;
         }
-    }
-        
-    // 复制需要fetch的commits和相关blobs
-    for(auto it=commits_to_copy.rbegin();it!=commits_to_copy.rend();it++){
-        std::string commit_id=*it;
-        std::string local_commit_path=Utils::join(".gitlite/objects",commit_id);
-        std::string remote_commit_path=Utils::join(remote_gitlite_dir,"objects",commit_id);
-
-        if(!Utils::exists(local_commit_path)){
-            // 复制commit文件
-            Commit remote_commit=Commit::fromFile(remote_commit_path);
-            Utils::writeContents(local_commit_path,remote_commit.serialize());
-
-            // 复制commit相关的所有blob文件
-            auto blobs=remote_commit.getBlobs();
-            for(const auto& blob : blobs){
-                std::string blob_id=blob.second;
-                std::string local_blob_path=Utils::join(".gitlite/objects",blob_id);
-                std::string remote_blob_path=Utils::join(remote_gitlite_dir,"objects",blob_id);
-
-                if(!Utils::exists(local_blob_path)){
-                    std::string blob_content=Utils::readContentsAsString(remote_blob_path);
-                    Utils::writeContents(local_blob_path,blob_content);
-                }
-            }
+        if(!remote_store.exists(current)){
+            Utils::exitWithMessage("Remote commit not found.");
+        }
+        Commit commit=Commit::load(remote_store,current);
+        for(const auto& parent:commit.getParents()){
+            stack.push_back(parent);
         }
     }
-    
+
+    // 用远程仓库的位图算出缺少的对象
+    ReachabilityIndex remote_index(remote_gitlite_dir,remote_store);
+    auto objects=remote_index.missing({remote_branch_head},have);
+    copyObjects(remote_store,local_store,objects,core->getCommitCatalog(),core->getCommitGraph());
+
     // 创建本地跟踪分支指向远程分支头
     core->setBranchHead(local_tracking_branch,remote_branch_head);
 }
@@ -227,6 +149,30 @@ void RemoteManager::pull(const std::string& remoteName,const std::string& remote
     // fetch(remoteName,remoteBranchName);
 }
 
+void RemoteManager::copyObjects(const ObjectStore& from,const ObjectStore& to,const std::vector<ReachabilityIndex::Object>& objects,
+                                CommitCatalog& catalog,CommitGraph& graph){
+    for(const auto& object:objects){
+        const ObjectId& id=object.first;
+        if(to.exists(id)){
+            continue;
+        }
+        // 分块的blob只传目标缺少的块；tree和commit原样复制，id不变
+        if(object.second==OBJ_BLOB){
+            Blob::copyObject(from,to,id);
+        }
+        else if(object.second==OBJ_TREE){
+            to.write(id,from.read(id),OBJ_TREE);
+        }
+        else{
+            std::string data=from.read(id);
+            Commit commit=Commit::deserialize(data);
+            to.write(id,data,OBJ_COMMIT);
+            catalog.append(commit);
+            graph.append(commit);
+        }
+    }
+}
+
 // 获取所有远程仓库配置
 std::map<std::string,std::string> RemoteManager::getRemotes(){
     std::map<std::string,std::string> remotes;
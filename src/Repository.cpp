@@ -34,8 +34,8 @@ void Repository::init(){
     core->init();
 }
 
-void Repository::add(const std::string& filename){
-    fileOpManager->add(filename);
+void Repository::add(const std::vector<std::string>& paths){
+    fileOpManager->add(paths);
 }
 
 void Repository::commit(const std::string& message){
@@ -62,6 +62,18 @@ void Repository::find(const std::string& commitMessage){
     commitManager->find(commitMessage);
 }
 
+void Repository::find(const std::string& option,const std::string& query){
+    if(option=="--token"){
+        commitManager->find(query,CommitCatalog::MATCH_TOKENS);
+    }
+    else if(option=="--substring"){
+        commitManager->find(query,CommitCatalog::MATCH_SUBSTRING);
+    }
+    else{
+        Utils::exitWithMessage("Incorrect operands.");
+    }
+}
+
 void Repository::checkoutFile(const std::string& filename){
     fileOpManager->checkoutFile(filename);
 }
@@ -99,6 +111,34 @@ void Repository::pull(const std::string& remoteName,const std::string& branchNam
     mergeManager->merge(remoteName+"/"+branchName);
 }
 
+void Repository::migrate(){
+    core->migrate();
+}
+
+void Repository::repack(){
+    core->repack();
+}
+
+void Repository::reindex(){
+    core->reindex();
+}
+
+void Repository::gc(bool dryRun){
+    core->gc(dryRun);
+}
+
+void Repository::fsck(){
+    core->fsck();
+}
+
+void Repository::config(const std::string& key){
+    core->showConfig(key);
+}
+
+void Repository::config(const std::string& key,const std::string& value){
+    core->setConfig(key,value);
+}
+
 void Repository::addRemote(const std::string& remoteName,const std::string& remotePath){
     remoteManager->addRemote(remoteName,remotePath);
 }
@@ -115,7 +155,7 @@ std::string Repository::getCurrentBranch(){
     return core->getCurrentBranch();
 }
 
-std::string Repository::getCurrentCommitId(){
+ObjectId Repository::getCurrentCommitId(){
     return commitManager->getCurrentCommitId();
 }
 
@@ -140,10 +180,10 @@ void Repository::clearConflictFiles(){
 }
 
 Commit Repository::getHeadCommit(){
-    return commitManager->getHeadCommit();
+    return *commitManager->getHeadCommit();
 }
 
-std::vector<std::string> Repository::getFiles(const std::string& commitId){
+std::vector<std::string> Repository::getFiles(const ObjectId& commitId){
     return commitManager->getFiles(commitId);
 }
 
@@ -2,17 +2,36 @@
 #include"../include/Utils.h"
 #include"../include/GitliteException.h"
 #include"../include/Commit.h"
+#include"../include/Config.h"
+#include"../include/GarbageCollector.h"
+#include"../include/IntegrityChecker.h"
+#include"../include/Tree.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
 #include <cctype>
+#include <cstdio>
+#include <ctime>
+#include <unordered_map>
+#include <unordered_set>
 
 const std::string RepositoryCore::gitlite_dir=".gitlite";
 const std::string RepositoryCore::objects_dir=".gitlite/objects";
 const std::string RepositoryCore::branches_dir=".gitlite/branches";
+const std::string RepositoryCore::index_file=".gitlite/index";
 const std::string RepositoryCore::staging_area_file=".gitlite/staging";
 const std::string RepositoryCore::removed_file=".gitlite/removed";
 const std::string RepositoryCore::head_file=".gitlite/HEAD";
 const std::string RepositoryCore::remotes_file=".gitlite/remotes";
+const std::string RepositoryCore::format_file=".gitlite/format";
 
-RepositoryCore::RepositoryCore() : stagingArea(staging_area_file,removed_file){}
+RepositoryCore::RepositoryCore() : stagingArea(index_file,staging_area_file,removed_file),objectStore(gitlite_dir),commitCache(objectStore),commitCatalog(gitlite_dir,objectStore),commitGraph(gitlite_dir,commitCatalog),reachabilityIndex(gitlite_dir,objectStore){}
+
+RepositoryCore::~RepositoryCore(){
+    if(std::getenv("GITLITE_COMMIT_CACHE_STATS")){
+        std::cerr<<"commit cache: "<<commitCache.getHits()<<" hits, "<<commitCache.getMisses()<<" misses\n";
+    }
+}
 
 bool RepositoryCore::isInitialized(){
     return Utils::isDirectory(gitlite_dir);
@@ -28,14 +47,19 @@ void RepositoryCore::init(){
     Utils::createDirectories(gitlite_dir);
     Utils::createDirectories(objects_dir);
     Utils::createDirectories(branches_dir);
+    ObjectStore::writeFormatVersion(gitlite_dir,ObjectStore::FORMAT_VERSION);
+    Config(gitlite_dir).set("core.compression",Config::defaultValue("core.compression"));
+    objectStore.reload();
 
-    std::map<std::string,std::string> empty_blobs;
-    std::vector<std::string> empty_parents;
+    std::map<std::string,ObjectId> empty_blobs;
+    std::vector<ObjectId> empty_parents;
     std::time_t epoch=0;
     Commit initial_commit("initial commit",epoch,empty_parents,empty_blobs);
 
-    std::string commit_file=Utils::join(objects_dir,initial_commit.getId());
-    Utils::writeContents(commit_file,initial_commit.serialize());
+    objectStore.rebuildIndex();
+    objectStore.write(initial_commit.getId(),initial_commit.serialize(),OBJ_COMMIT);
+    commitCatalog.rebuild();
+    commitGraph.rebuild();
 
     setBranchHead("master",initial_commit.getId());
     setCurrentBranch("master");
@@ -43,6 +67,219 @@ void RepositoryCore::init(){
     clearStagingArea();
 }
 
+void RepositoryCore::migrate(){
+    if(ObjectStore::readFormatVersion(gitlite_dir)>=ObjectStore::FORMAT_VERSION
+     &&Utils::plainFilenamesIn(objects_dir).empty()){
+        Utils::exitWithMessage("Repository is already up to date.");
+    }
+    int moved=objectStore.migrateToFanout();
+    objectStore.rebuildIndex();
+    commitCatalog.rebuild();
+    commitGraph.rebuild();
+    Utils::message("Migrated "+std::to_string(moved)+" objects.");
+}
+
+void RepositoryCore::reindex(){
+    objectStore.rebuildIndex();
+    size_t commits=commitCatalog.rebuild();
+    commitGraph.rebuild();
+    reachabilityIndex.rebuild(branchHeadIds());
+    Utils::message("Reindexed "+std::to_string(commits)+" commits.");
+}
+
+std::vector<PackHint> RepositoryCore::packHints(){
+    // 从commit目录只取id、第一个父commit和时间，按时间从旧到新排列；commit本身逐个读，不同时留在内存里
+    struct CommitInfo{
+        ObjectId id;
+        ObjectId parent;
+        std::time_t timestamp;
+    };
+    std::vector<CommitInfo> commits;
+    getCommitCatalog().forEach([&](const CommitCatalog::Entry& entry){
+        commits.push_back({entry.id,entry.parents[0],entry.timestamp});
+    });
+    std::stable_sort(commits.begin(),commits.end(),[](const CommitInfo& a,const CommitInfo& b){
+        return a.timestamp<b.timestamp;
+    });
+    std::unordered_set<ObjectId> known;
+    for(const auto& info:commits){
+        known.insert(info.id);
+    }
+
+    // 每个blob记下第一次出现的路径，以及父commit中同一路径的blob作为delta基准
+    // 只看相对第一个父commit改动过的文件：没改动的blob在父commit（时间更早，已经处理过）里记过了
+    std::vector<PackHint> hints;
+    std::unordered_set<ObjectId> seen;
+    auto addHint=[&](const std::string& path,const ObjectId& blob,const ObjectId& base){
+        if(!blob.isNull()&&seen.insert(blob).second){
+            hints.push_back({blob,path,base});
+        }
+    };
+    for(const auto& info:commits){
+        Commit commit=Commit::load(objectStore,info.id);
+        bool has_parent=!info.parent.isNull()&&known.count(info.parent);
+        Commit parent=has_parent?Commit::load(objectStore,info.parent):Commit();
+        if(!commit.getTree().isNull()&&(!has_parent||!parent.getTree().isNull())){
+            // 两边都是tree：逐层比较，id相同的子树整个跳过
+            Tree::diff(objectStore,parent.getTree(),commit.getTree(),
+                       [&](const std::string& path,const ObjectId& base,const ObjectId& blob){
+                addHint(path,blob,base);
+            });
+        }
+        else{
+            // 旧格式的commit内嵌文件表，一次只展开这一个
+            for(const auto& blob:commit.getBlobs()){
+                if(seen.count(blob.second))continue;
+                addHint(blob.first,blob.second,has_parent?parent.getBlobId(blob.first):ObjectId());
+            }
+        }
+    }
+    // 同一路径的版本排在一起，路径内保持时间顺序，滑动窗口里就都是相近的内容
+    std::stable_sort(hints.begin(),hints.end(),[](const PackHint& a,const PackHint& b){
+        return a.path<b.path;
+    });
+    return hints;
+}
+
+void RepositoryCore::repack(){
+    int packed=objectStore.repack(packHints());
+    if(packed==0){
+        Utils::exitWithMessage("Nothing to pack.");
+    }
+    reachabilityIndex.rebuild(branchHeadIds());
+    Utils::message("Packed "+std::to_string(packed)+" objects.");
+}
+
+std::vector<ObjectId> RepositoryCore::branchHeadIds(){
+    std::vector<ObjectId> ids;
+    for(const auto& head:allBranchHeads()){
+        ids.push_back(head.second);
+    }
+    return ids;
+}
+
+std::map<std::string,ObjectId> RepositoryCore::allBranchHeads(){
+    std::map<std::string,ObjectId> heads;
+    std::vector<std::string> dirs={""};
+    while(!dirs.empty()){
+        std::string dir=dirs.back();
+        dirs.pop_back();
+        std::string path=dir.empty()?branches_dir:Utils::join(branches_dir,dir);
+        for(const auto& name:Utils::plainFilenamesIn(path)){
+            std::string branch=dir.empty()?name:Utils::join(dir,name);
+            std::string hex=Utils::readContentsAsString(Utils::join(path,name));
+            if(!ObjectId::isValidHex(hex)){
+                Utils::exitWithMessage("Invalid branch file: "+branch);
+            }
+            heads[branch]=ObjectId::fromHex(hex);
+        }
+        for(const auto& sub:Utils::subdirectoriesIn(path)){
+            dirs.push_back(dir.empty()?sub:Utils::join(dir,sub));
+        }
+    }
+    return heads;
+}
+
+void RepositoryCore::gc(bool dryRun){
+    // 根：所有分支（包括branches下子目录里的远程跟踪分支）指向的commit，以及暂存区里的blob
+    std::vector<ObjectId> root_commits=branchHeadIds();
+    std::vector<ObjectId> root_blobs;
+    for(const auto& entry:stagingArea.getStagingMap()){
+        root_blobs.push_back(entry.second);
+    }
+
+    GarbageCollector collector(objectStore);
+    std::unordered_set<ObjectId> reachable;
+    try{
+        // 有位图时从位图取可达集合，只需遍历建索引之后的新commit；没有时并行遍历全部历史
+        if(reachabilityIndex.exists()){
+            auto ids=reachabilityIndex.idsOf(reachabilityIndex.reachable(root_commits,root_blobs));
+            reachable.insert(ids.begin(),ids.end());
+        }
+        else{
+            reachable=collector.mark(root_commits,root_blobs);
+        }
+    }catch(const GitliteException& e){
+        // 标记不完整时什么都不能删
+        Utils::exitWithMessage(std::string(e.what())+"; nothing was removed.");
+    }
+
+    long grace=std::atol(Config(gitlite_dir).get("gc.graceperiod",Config::defaultValue("gc.graceperiod")).c_str());
+    auto plan=collector.plan(reachable,std::time(nullptr)-grace);
+    std::unordered_set<ObjectId> unique(plan.packed);
+    unique.insert(plan.loose.begin(),plan.loose.end());
+    std::vector<ObjectId> doomed(unique.begin(),unique.end());
+    std::sort(doomed.begin(),doomed.end());
+
+    if(dryRun){
+        for(const auto& id:doomed){
+            Utils::message("Would remove "+id.toHex());
+        }
+        Utils::message("Would remove "+std::to_string(doomed.size())+" unreachable objects.");
+    }
+    else{
+        // 打包提示要在删对象之前生成，其中不可达的commit还要读出来
+        std::vector<PackHint> hints;
+        if(!plan.packed.empty()){
+            hints=packHints();
+        }
+        collector.removeLoose(plan);
+        if(!plan.packed.empty()){
+            objectStore.repack(hints,plan.packed);
+        }
+        objectStore.rebuildIndex();
+        commitCache.clear();
+        // 只从目录里去掉删除的commit，不用重新扫描对象库
+        commitCatalog.remove(unique);
+        commitGraph.rebuild();
+        reachabilityIndex.rebuild(root_commits);
+        Utils::message("Removed "+std::to_string(doomed.size())+" unreachable objects.");
+    }
+    if(plan.recent>0){
+        Utils::message("Kept "+std::to_string(plan.recent)+" unreachable objects within the grace period.");
+    }
+}
+
+void RepositoryCore::fsck(){
+    IntegrityChecker checker(objectStore);
+    auto report=checker.check(allBranchHeads(),stagingArea.getStagingMap());
+    for(const auto& line:report.problems){
+        Utils::message(line);
+    }
+    for(const auto& line:report.dangling){
+        Utils::message(line);
+    }
+
+    double mb=report.bytes/(1024.0*1024.0);
+    char stats[192];
+    std::snprintf(stats,sizeof(stats),"Checked %zu objects (%zu commits, %zu trees, %zu blobs), %.1f MB in %.2f s (%.1f MB/s, %zu threads).",
+                  report.objects,report.commits,report.trees,report.blobs,mb,report.seconds,
+                  report.seconds>0?mb/report.seconds:0.0,report.threads);
+    Utils::message(stats);
+    if(report.problems.empty()){
+        Utils::message("No problems found.");
+    }
+    else{
+        Utils::message(std::to_string(report.problems.size())+" problems found.");
+    }
+}
+
+void RepositoryCore::showConfig(const std::string& key){
+    if(!Config::isKnownKey(key)){
+        Utils::exitWithMessage("Unknown config key: "+key);
+    }
+    Utils::message(Config(gitlite_dir).get(key,Config::defaultValue(key)));
+}
+
+void RepositoryCore::setConfig(const std::string& key,const std::string& value){
+    std::string error=Config::validate(key,value);
+    if(!error.empty()){
+        Utils::exitWithMessage(error);
+    }
+    Config(gitlite_dir).set(key,value);
+    objectStore.reload();
+}
+
 std::string RepositoryCore::getCurrentBranch(){
     if(!Utils::exists(head_file)){return "";}
     return Utils::readContentsAsString(head_file);
@@ -54,23 +291,24 @@ void RepositoryCore::setCurrentBranch(const std::string& branch){
     Utils::writeContents(head_file,branch);  // 写入HEAD文件
 }
 
-// 获取分支指向的commit ID
-std::string RepositoryCore::getBranchHead(const std::string& branch){
+// 获取分支指向的commit ID，分支不存在时返回空ID
+ObjectId RepositoryCore::getBranchHead(const std::string& branch){
     if(branch.empty()){Utils::exitWithMessage("branch name is empty");}
-    if(!Utils::exists(Utils::join(branches_dir,branch))){return "";} 
+    if(!Utils::exists(Utils::join(branches_dir,branch))){return ObjectId();} 
     
     std::string id=Utils::readContentsAsString(Utils::join(branches_dir,branch));  // 读取分支文件
-    return id;
+    return ObjectId::fromHex(id);
 }
 
 // 设置分支指向的commit
-void RepositoryCore::setBranchHead(const std::string& branch,const std::string& commit_id){
+void RepositoryCore::setBranchHead(const std::string& branch,const ObjectId& commit_id){
     if(branch.empty()){Utils::exitWithMessage("branch name is empty");}
-    if(commit_id.empty()){Utils::exitWithMessage("commit id is empty");}
-    if(!Utils::exists(Utils::join(objects_dir,commit_id))){Utils::exitWithMessage("commit does not exist");}
+    if(commit_id.isNull()){Utils::exitWithMessage("commit id is empty");}
+
+    if(!objectStore.exists(commit_id)){Utils::exitWithMessage("commit does not exist");}
 
+    std::string id=commit_id.toHex();
     std::string branch_file=Utils::join(branches_dir,branch);  // 分支文件路径
-    std::string id=commit_id;
 
     Utils::writeContents(branch_file,id);  // 写入分支文件
 }
@@ -81,4 +319,24 @@ void RepositoryCore::clearStagingArea(){
 
 StagingArea& RepositoryCore::getStagingArea(){
     return stagingArea;
-}
\ No newline at end of file
+}
+
+const ObjectStore& RepositoryCore::getObjectStore() const {
+    return objectStore;
+}
+
+std::shared_ptr<const Commit> RepositoryCore::getCommit(const ObjectId& commitId){
+    return commitCache.get(commitId);
+}
+
+CommitCatalog& RepositoryCore::getCommitCatalog(){
+    return commitCatalog;
+}
+
+CommitGraph& RepositoryCore::getCommitGraph(){
+    return commitGraph;
+}
+
+ReachabilityIndex& RepositoryCore::getReachabilityIndex(){
+    return reachabilityIndex;
+}
@@ -0,0 +1,409 @@
+#include "../include/Sha1Kernel.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/** SHA-1 compression kernels.
+ *
+ * All kernels share the signature of CompressFunc and must produce
+ * identical results; compressPortable is the straightforward reference
+ * and the others are checked against it.  The choice is made once, on
+ * first use, from the CPU features reported by cpuid.
+ */
+
+namespace SHA1 {
+
+    static inline uint32_t rol(uint32_t x, int n) {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    static inline uint32_t loadBigEndian(const uint8_t* p) {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+               (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    /* PORTABLE REFERENCE */
+
+    static uint32_t kt(int t) {
+        if (t < 20)
+            return 0x5a827999;
+        else if (t < 40)
+            return 0x6ed9eba1;
+        else if (t < 60)
+            return 0x8f1bbcdc;
+        else
+            return 0xca62c1d6;
+    }
+
+    static uint32_t ft(int t, uint32_t B, uint32_t C, uint32_t D) {
+        if (t < 20)
+            return (B & C) | ((~B) & D);
+        else if (t < 40)
+            return B ^ C ^ D;
+        else if (t < 60)
+            return (B & C) | (B & D) | (C & D);
+        else
+            return B ^ C ^ D;
+    }
+
+    void compressPortable(uint32_t state[5], const uint8_t* blocks, size_t count) {
+        uint32_t Word[80];
+        for (size_t n = 0; n < count; n++, blocks += 64) {
+            for (int i = 0; i < 16; i++) {
+                Word[i] = loadBigEndian(blocks + 4 * i);
+            }
+            for (int i = 16; i < 80; i++) {
+                Word[i] = rol(Word[i-3] ^ Word[i-8] ^ Word[i-14] ^ Word[i-16], 1);
+            }
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+            for (int j = 0; j < 80; j++) {
+                uint32_t temp = rol(a, 5) + ft(j, b, c, d) + e + kt(j) + Word[j];
+                e = d;
+                d = c;
+                c = rol(b, 30);
+                b = a;
+                a = temp;
+            }
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+    }
+
+    /* UNROLLED SCALAR ROUNDS */
+
+    #define SHA1_F1(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+    #define SHA1_F2(b, c, d) ((b) ^ (c) ^ (d))
+    #define SHA1_F3(b, c, d) (((b) & (c)) | ((d) & ((b) | (c))))
+
+    // 原地轮函数：每轮后寄存器名字轮换一位，五轮后回到原位
+    #define SHA1_ROUND(f, k, a, b, c, d, e, w) \
+        do { (e) += rol((a), 5) + f((b), (c), (d)) + (k) + (w); (b) = rol((b), 30); } while (0)
+
+    #define SHA1_ROUND5(f, k, t, W) \
+        SHA1_ROUND(f, k, a, b, c, d, e, W(t));     \
+        SHA1_ROUND(f, k, e, a, b, c, d, W((t)+1)); \
+        SHA1_ROUND(f, k, d, e, a, b, c, W((t)+2)); \
+        SHA1_ROUND(f, k, c, d, e, a, b, W((t)+3)); \
+        SHA1_ROUND(f, k, b, c, d, e, a, W((t)+4))
+
+    #define SHA1_ROUNDS80(W, K1, K2, K3, K4) \
+        SHA1_ROUND5(SHA1_F1, K1, 0, W);  SHA1_ROUND5(SHA1_F1, K1, 5, W);  \
+        SHA1_ROUND5(SHA1_F1, K1, 10, W); SHA1_ROUND5(SHA1_F1, K1, 15, W); \
+        SHA1_ROUND5(SHA1_F2, K2, 20, W); SHA1_ROUND5(SHA1_F2, K2, 25, W); \
+        SHA1_ROUND5(SHA1_F2, K2, 30, W); SHA1_ROUND5(SHA1_F2, K2, 35, W); \
+        SHA1_ROUND5(SHA1_F3, K3, 40, W); SHA1_ROUND5(SHA1_F3, K3, 45, W); \
+        SHA1_ROUND5(SHA1_F3, K3, 50, W); SHA1_ROUND5(SHA1_F3, K3, 55, W); \
+        SHA1_ROUND5(SHA1_F2, K4, 60, W); SHA1_ROUND5(SHA1_F2, K4, 65, W); \
+        SHA1_ROUND5(SHA1_F2, K4, 70, W); SHA1_ROUND5(SHA1_F2, K4, 75, W)
+
+    // 16个字的环形消息扩展，t-3、t-8、t-14、t-16分别对应(t+13)、(t+8)、(t+2)、t
+    #define SHA1_SCALAR_W(t) ((t) < 16                                              \
+        ? (W[(t) & 15] = loadBigEndian(block + 4 * ((t) & 15)))                     \
+        : (W[(t) & 15] = rol(W[((t) + 13) & 15] ^ W[((t) + 8) & 15] ^               \
+                             W[((t) + 2) & 15] ^ W[(t) & 15], 1)))
+
+    void compressScalar(uint32_t state[5], const uint8_t* blocks, size_t count) {
+        uint32_t W[16];
+        for (size_t n = 0; n < count; n++) {
+            const uint8_t* block = blocks + 64 * n;
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+            SHA1_ROUNDS80(SHA1_SCALAR_W, 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6);
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+    }
+
+    // 常量已经加进WK时使用
+    #define SHA1_WK(t) (WK[(t)])
+
+    __attribute__((always_inline)) static inline void roundsWithSchedule(uint32_t state[5], const uint32_t* WK) {
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        SHA1_ROUNDS80(SHA1_WK, 0u, 0u, 0u, 0u);
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+
+    /* SIMD MESSAGE SCHEDULE */
+
+    // 四个字一组计算W[t..t+3]；第4个字依赖同组的W[t]，先按0计算再补上rol1(W[t])
+    __attribute__((target("ssse3")))
+    static inline __m128i rol1x4(__m128i x) {
+        return _mm_or_si128(_mm_slli_epi32(x, 1), _mm_srli_epi32(x, 31));
+    }
+
+    __attribute__((target("ssse3")))
+    static void scheduleSsse3(const uint8_t* block, uint32_t* WK) {
+        const __m128i swap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+        const __m128i K[4] = {
+            _mm_set1_epi32(0x5a827999), _mm_set1_epi32(0x6ed9eba1),
+            _mm_set1_epi32(0x8f1bbcdc), _mm_set1_epi32(static_cast<int>(0xca62c1d6))
+        };
+        __m128i W[20];
+        for (int i = 0; i < 4; i++) {
+            W[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i)), swap);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(WK + 4 * i), _mm_add_epi32(W[i], K[0]));
+        }
+        for (int i = 4; i < 20; i++) {
+            __m128i w3 = _mm_srli_si128(W[i-1], 4);                 // W[t-3..t-1],0
+            __m128i w14 = _mm_alignr_epi8(W[i-3], W[i-4], 8);       // W[t-14..t-11]
+            __m128i x = _mm_xor_si128(_mm_xor_si128(W[i-4], w14), _mm_xor_si128(W[i-2], w3));
+            __m128i r = rol1x4(x);
+            r = _mm_xor_si128(r, rol1x4(_mm_slli_si128(r, 12)));
+            W[i] = r;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(WK + 4 * i), _mm_add_epi32(r, K[i / 5]));
+        }
+    }
+
+    __attribute__((target("ssse3")))
+    void compressSsse3(uint32_t state[5], const uint8_t* blocks, size_t count) {
+        alignas(16) uint32_t WK[80];
+        for (size_t n = 0; n < count; n++) {
+            scheduleSsse3(blocks + 64 * n, WK);
+            roundsWithSchedule(state, WK);
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i rol1x8(__m256i x) {
+        return _mm256_or_si256(_mm256_slli_epi32(x, 1), _mm256_srli_epi32(x, 31));
+    }
+
+    // 低128位是第一个块，高128位是第二个块；移位与alignr都按128位通道进行
+    __attribute__((target("avx2")))
+    static void scheduleAvx2(const uint8_t* first, const uint8_t* second, uint32_t* WK1, uint32_t* WK2) {
+        const __m256i swap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                             12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+        const __m256i K[4] = {
+            _mm256_set1_epi32(0x5a827999), _mm256_set1_epi32(0x6ed9eba1),
+            _mm256_set1_epi32(0x8f1bbcdc), _mm256_set1_epi32(static_cast<int>(0xca62c1d6))
+        };
+        __m256i W[20];
+        for (int i = 0; i < 20; i++) {
+            __m256i r;
+            if (i < 4) {
+                __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 16 * i));
+                __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + 16 * i));
+                r = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), swap);
+            } else {
+                __m256i w3 = _mm256_srli_si256(W[i-1], 4);
+                __m256i w14 = _mm256_alignr_epi8(W[i-3], W[i-4], 8);
+                __m256i x = _mm256_xor_si256(_mm256_xor_si256(W[i-4], w14), _mm256_xor_si256(W[i-2], w3));
+                r = rol1x8(x);
+                r = _mm256_xor_si256(r, rol1x8(_mm256_slli_si256(r, 12)));
+            }
+            W[i] = r;
+            __m256i wk = _mm256_add_epi32(r, K[i / 5]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(WK1 + 4 * i), _mm256_castsi256_si128(wk));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(WK2 + 4 * i), _mm256_extracti128_si256(wk, 1));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void compressAvx2(uint32_t state[5], const uint8_t* blocks, size_t count) {
+        alignas(32) uint32_t WK1[80];
+        alignas(32) uint32_t WK2[80];
+        size_t n = 0;
+        for (; n + 2 <= count; n += 2) {
+            scheduleAvx2(blocks + 64 * n, blocks + 64 * (n + 1), WK1, WK2);
+            roundsWithSchedule(state, WK1);
+            roundsWithSchedule(state, WK2);
+        }
+        if (n < count) {
+            compressSsse3(state, blocks + 64 * n, count - n);
+        }
+    }
+
+    /* SHA-NI */
+
+    // 每4轮一组：E加上当前消息后执行sha1rnds4，同时为后面的组做消息扩展
+    #define SHANI_GROUP(func, Ecur, Enext, Mcur, Mmsg2, Mmsg1, Mxor, doMsg2, doMsg1, doXor) \
+        do {                                                    \
+            Ecur = _mm_sha1nexte_epu32(Ecur, Mcur);             \
+            Enext = ABCD;                                       \
+            if (doMsg2) Mmsg2 = _mm_sha1msg2_epu32(Mmsg2, Mcur);\
+            ABCD = _mm_sha1rnds4_epu32(ABCD, Ecur, func);       \
+            if (doMsg1) Mmsg1 = _mm_sha1msg1_epu32(Mmsg1, Mcur);\
+            if (doXor) Mxor = _mm_xor_si128(Mxor, Mcur);        \
+        } while (0)
+
+    __attribute__((target("sha,sse4.1")))
+    void compressShaNi(uint32_t state[5], const uint8_t* blocks, size_t count) {
+        const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+        __m128i ABCD = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+        __m128i E0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+        ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+
+        for (size_t n = 0; n < count; n++, blocks += 64) {
+            __m128i ABCD_SAVE = ABCD;
+            __m128i E0_SAVE = E0;
+            __m128i E1;
+            __m128i MSG0, MSG1, MSG2, MSG3;
+
+            // 0-3
+            MSG0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 0)), MASK);
+            E0 = _mm_add_epi32(E0, MSG0);
+            E1 = ABCD;
+            ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+
+            // 4-7
+            MSG1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16)), MASK);
+            SHANI_GROUP(0, E1, E0, MSG1, MSG2, MSG0, MSG3, false, true, false);
+
+            // 8-11
+            MSG2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 32)), MASK);
+            SHANI_GROUP(0, E0, E1, MSG2, MSG3, MSG1, MSG0, false, true, true);
+
+            // 12-15
+            MSG3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 48)), MASK);
+            SHANI_GROUP(0, E1, E0, MSG3, MSG0, MSG2, MSG1, true, true, true);
+
+            // 16-63
+            SHANI_GROUP(0, E0, E1, MSG0, MSG1, MSG3, MSG2, true, true, true);
+            SHANI_GROUP(1, E1, E0, MSG1, MSG2, MSG0, MSG3, true, true, true);
+            SHANI_GROUP(1, E0, E1, MSG2, MSG3, MSG1, MSG0, true, true, true);
+            SHANI_GROUP(1, E1, E0, MSG3, MSG0, MSG2, MSG1, true, true, true);
+            SHANI_GROUP(1, E0, E1, MSG0, MSG1, MSG3, MSG2, true, true, true);
+            SHANI_GROUP(1, E1, E0, MSG1, MSG2, MSG0, MSG3, true, true, true);
+            SHANI_GROUP(2, E0, E1, MSG2, MSG3, MSG1, MSG0, true, true, true);
+            SHANI_GROUP(2, E1, E0, MSG3, MSG0, MSG2, MSG1, true, true, true);
+            SHANI_GROUP(2, E0, E1, MSG0, MSG1, MSG3, MSG2, true, true, true);
+            SHANI_GROUP(2, E1, E0, MSG1, MSG2, MSG0, MSG3, true, true, true);
+            SHANI_GROUP(2, E0, E1, MSG2, MSG3, MSG1, MSG0, true, true, true);
+            SHANI_GROUP(3, E1, E0, MSG3, MSG0, MSG2, MSG1, true, true, true);
+
+            // 64-79：后面的组不再需要扩展出新消息
+            SHANI_GROUP(3, E0, E1, MSG0, MSG1, MSG3, MSG2, true, true, true);
+            SHANI_GROUP(3, E1, E0, MSG1, MSG2, MSG0, MSG3, true, false, true);
+            SHANI_GROUP(3, E0, E1, MSG2, MSG3, MSG1, MSG0, true, false, false);
+            SHANI_GROUP(3, E1, E0, MSG3, MSG0, MSG2, MSG1, false, false, false);
+
+            E0 = _mm_sha1nexte_epu32(E0, E0_SAVE);
+            ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+        }
+
+        ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), ABCD);
+        state[4] = static_cast<uint32_t>(_mm_extract_epi32(E0, 3));
+    }
+
+    /* CPU DETECTION */
+
+    struct CpuFeatures {
+        bool ssse3 = false;
+        bool sse41 = false;
+        bool avx2 = false;
+        bool sha = false;
+    };
+
+    static CpuFeatures detectCpu() {
+        CpuFeatures f;
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            return f;
+        }
+        f.ssse3 = (ecx & bit_SSSE3) != 0;
+        f.sse41 = (ecx & bit_SSE4_1) != 0;
+        bool osxsave = (ecx & bit_OSXSAVE) != 0;
+        bool avx = (ecx & bit_AVX) != 0;
+
+        if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            f.sha = (ebx & bit_SHA) != 0;
+            // AVX2还要求操作系统保存了YMM寄存器状态
+            if (avx && osxsave) {
+                unsigned int lo, hi;
+                __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+                f.avx2 = (ebx & bit_AVX2) != 0 && (lo & 0x6) == 0x6;
+            }
+        }
+        return f;
+    }
+
+#endif
+
+    /* DISPATCH */
+
+    struct Kernel {
+        const char* name;
+        CompressFunc func;
+    };
+
+    static Kernel chooseKernel() {
+        const char* forced = std::getenv("GITLITE_SHA1_IMPL");
+        std::string want = forced ? forced : "";
+
+        Kernel portable = {"portable", compressPortable};
+        Kernel scalar = {"scalar", compressScalar};
+        if (want == "portable") return portable;
+        if (want == "scalar") return scalar;
+
+#if defined(__x86_64__) || defined(__i386__)
+        CpuFeatures cpu = detectCpu();
+        Kernel ssse3 = {"ssse3", compressSsse3};
+        Kernel avx2 = {"avx2", compressAvx2};
+        Kernel shani = {"shani", compressShaNi};
+
+        // 强制指定但CPU不支持时退回自动选择
+        if (want == "ssse3" && cpu.ssse3) return ssse3;
+        if (want == "avx2" && cpu.avx2 && cpu.ssse3) return avx2;
+        if (want == "shani" && cpu.sha && cpu.sse41) return shani;
+
+        if (cpu.sha && cpu.sse41 && cpu.ssse3) return shani;
+        if (cpu.avx2 && cpu.ssse3) return avx2;
+        if (cpu.ssse3) return ssse3;
+#endif
+        return scalar;
+    }
+
+    static const Kernel& selectedKernel() {
+        static const Kernel kernel = chooseKernel();
+        return kernel;
+    }
+
+    CompressFunc selectCompress() {
+        return selectedKernel().func;
+    }
+
+    std::string compressName() {
+        return selectedKernel().name;
+    }
+
+    bool selfCheck() {
+        // 全0、全1和伪随机的块；块数覆盖单块、两块一组（AVX2）和奇数块的尾部
+        const size_t max_blocks = 7;
+        uint8_t data[3][max_blocks * 64];
+        uint32_t seed = 0x9e3779b9;
+        for (size_t i = 0; i < sizeof(data[0]); i++) {
+            seed = seed * 1664525 + 1013904223;
+            data[0][i] = 0;
+            data[1][i] = 0xff;
+            data[2][i] = static_cast<uint8_t>(seed >> 24);
+        }
+        CompressFunc selected = selectCompress();
+        for (const auto& blocks : data) {
+            for (size_t count = 1; count <= max_blocks; count++) {
+                uint32_t expected[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+                uint32_t actual[5];
+                std::memcpy(actual, expected, sizeof(actual));
+                compressPortable(expected, blocks, count);
+                selected(actual, blocks, count);
+                if (std::memcmp(expected, actual, sizeof(actual)) != 0) return false;
+            }
+        }
+        return true;
+    }
+}
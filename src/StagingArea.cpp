@@ -1,10 +1,245 @@
 #include "../include/StagingArea.h"
+#include "../include/Blob.h"
+#include "../include/GitliteException.h"
 #include "../include/Utils.h"
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sys/stat.h>
+#include <algorithm>
 
-StagingArea::StagingArea(const std::string& stagingFilePath,const std::string& removedFilePath)
-    : staging_file_path(stagingFilePath),removed_file_path(removedFilePath){
-    loadStagingMap();    
-    loadRemovedFiles();  
+namespace {
+    const std::string INDEX_MAGIC="GLINDEX3";
+    const std::string INDEX_MAGIC_V2="GLINDEX2";     // 没有代数
+    const std::string INDEX_MAGIC_V1="GLINDEX1";     // 没有代数，缓存条目也不带取stat的时间
+    const uint8_t FLAG_STAGED=1;
+    const uint8_t FLAG_REMOVED=2;
+    const uint8_t FLAG_CACHED=4;
+    const size_t STAT_SIZE=4*8;
+    const size_t RECORDED_SIZE=8;
+    const size_t BATCH_HEADER=4+8;
+    const size_t BATCH_CHECKSUM=4;
+
+    uint64_t readBE(const uint8_t* p,int bytes){
+        uint64_t v=0;
+        for(int i=0;i<bytes;i++){
+            v=(v<<8)|p[i];
+        }
+        return v;
+    }
+
+    void appendBE(std::string& out,uint64_t v,int bytes){
+        for(int i=bytes-1;i>=0;i--){
+            out.push_back(static_cast<char>(v>>(8*i)));
+        }
+    }
+
+    int64_t nanoseconds(const struct timespec& ts){
+        return static_cast<int64_t>(ts.tv_sec)*1000000000+ts.tv_nsec;
+    }
+
+    // 用和文件时间戳同样粗的时钟，同一时刻写入和修改的文件不会被当成先后发生
+    int64_t now(){
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME_COARSE,&ts);
+        return nanoseconds(ts);
+    }
+
+    void appendStat(std::string& out,const ObjectId& id,const StagingArea::FileStat& stat){
+        out.append(reinterpret_cast<const char*>(id.data()),ObjectId::RAW_LENGTH);
+        appendBE(out,static_cast<uint64_t>(stat.mtime),8);
+        appendBE(out,static_cast<uint64_t>(stat.ctime),8);
+        appendBE(out,stat.size,8);
+        appendBE(out,stat.inode,8);
+    }
+
+    StagingArea::FileStat readStat(const uint8_t* p){
+        StagingArea::FileStat stat;
+        stat.mtime=static_cast<int64_t>(readBE(p,8));
+        stat.ctime=static_cast<int64_t>(readBE(p+8,8));
+        stat.size=readBE(p+16,8);
+        stat.inode=readBE(p+24,8);
+        stat.checked=0;
+        return stat;
+    }
+
+    // 日志批次的校验：写入时间和记录的sha1的前4字节
+    uint32_t checksum(const char* data,size_t length){
+        SHA1::SHA hasher;
+        uint8_t digest[ObjectId::RAW_LENGTH];
+        hasher.update(data,length);
+        hasher.finalize(digest);
+        return static_cast<uint32_t>(readBE(digest,4));
+    }
+
+    void corrupt(const std::string& path){
+        throw GitliteException("Corrupt index file: "+path);
+    }
+}
+
+StagingArea::StagingArea(const std::string& indexFilePath,const std::string& stagingFilePath,const std::string& removedFilePath)
+    : index_stat(),pending_records(0),log_offset(0),log_records(0),log_damaged(false),generation(0),
+      index_file_path(indexFilePath),log_file_path(indexFilePath+".log"),
+      staging_file_path(stagingFilePath),removed_file_path(removedFilePath){
+    load();
+}
+
+void StagingArea::load(){
+    staging_map.clear();
+    removed_files.clear();
+    stat_cache.clear();
+    index_stat=FileStat();
+    pending.clear();
+    pending_records=0;
+    log_offset=0;
+    log_records=0;
+    log_damaged=false;
+    generation=0;
+    if(statFile(index_file_path,index_stat)){
+        loadIndex();
+        replayLog();
+    }
+    else{
+        // 旧仓库：下次保存时改写成索引
+        loadStagingMap();
+        loadRemovedFiles();
+    }
+}
+
+void StagingArea::loadIndex(){
+    std::string content=Utils::readContentsAsString(index_file_path);
+    const uint8_t* p=reinterpret_cast<const uint8_t*>(content.data());
+    if(content.size()<INDEX_MAGIC.length()+4){
+        corrupt(index_file_path);
+    }
+    // 旧版本的索引照常读入：没有代数时日志全部重放；
+    // GLINDEX1的缓存条目没有取stat的时间，都当作racy的，下次用到时重新计算
+    bool has_generation=content.compare(0,INDEX_MAGIC.length(),INDEX_MAGIC)==0;
+    bool has_recorded=has_generation||content.compare(0,INDEX_MAGIC_V2.length(),INDEX_MAGIC_V2)==0;
+    if(!has_recorded&&content.compare(0,INDEX_MAGIC_V1.length(),INDEX_MAGIC_V1)!=0){
+        corrupt(index_file_path);
+    }
+    size_t cached_size=ObjectId::RAW_LENGTH+STAT_SIZE+(has_recorded?RECORDED_SIZE:0);
+    size_t pos=INDEX_MAGIC.length();
+    uint64_t count=readBE(p+pos,4);
+    pos+=4;
+    if(has_generation){
+        if(content.size()-pos<8)corrupt(index_file_path);
+        generation=readBE(p+pos,8);
+        pos+=8;
+    }
+    for(uint64_t i=0;i<count;i++){
+        uint64_t length;
+        if(pos>=content.size()){
+            corrupt(index_file_path);
+        }
+        uint8_t flags=p[pos++];
+        if(!Utils::readVarint(content,pos,length)||length>content.size()-pos){
+            corrupt(index_file_path);
+        }
+        std::string path=content.substr(pos,length);
+        pos+=length;
+        if(flags&FLAG_STAGED){
+            if(content.size()-pos<ObjectId::RAW_LENGTH)corrupt(index_file_path);
+            staging_map[path]=ObjectId::fromRaw(p+pos);
+            pos+=ObjectId::RAW_LENGTH;
+        }
+        if(flags&FLAG_REMOVED){
+            removed_files.insert(path);
+        }
+        if(flags&FLAG_CACHED){
+            if(content.size()-pos<cached_size)corrupt(index_file_path);
+            CachedFile cached;
+            cached.id=ObjectId::fromRaw(p+pos);
+            cached.stat=readStat(p+pos+ObjectId::RAW_LENGTH);
+            cached.recorded=has_recorded?static_cast<int64_t>(readBE(p+pos+ObjectId::RAW_LENGTH+STAT_SIZE,8)):0;
+            pos+=cached_size;
+            stat_cache.emplace(std::move(path),cached);
+        }
+    }
+    if(pos!=content.size()){
+        corrupt(index_file_path);
+    }
+}
+
+void StagingArea::replayLog(){
+    if(!Utils::exists(log_file_path)){
+        log_offset=0;
+        return;
+    }
+    std::string content=Utils::readContentsAsString(log_file_path);
+    const uint8_t* p=reinterpret_cast<const uint8_t*>(content.data());
+    size_t pos=log_offset;
+    while(pos<content.size()){
+        // 写到一半的批次：长度不够或校验不对，后面的都不要
+        if(content.size()-pos<BATCH_HEADER+BATCH_CHECKSUM){
+            log_damaged=true;
+            break;
+        }
+        uint64_t length=readBE(p+pos,4);
+        if(length>content.size()-pos-BATCH_HEADER-BATCH_CHECKSUM
+         ||checksum(content.data()+pos+4,8+length)!=readBE(p+pos+BATCH_HEADER+length,4)){
+            log_damaged=true;
+            break;
+        }
+        size_t record=pos+BATCH_HEADER;
+        size_t batch_end=record+length;
+        // 合并前写的批次：主文件已经包含这些改动，合并中断时才会留下，跳过
+        if(readBE(p+pos+4,8)<generation){
+            pos=batch_end+BATCH_CHECKSUM;
+            continue;
+        }
+        while(record<batch_end){
+            Op op=static_cast<Op>(p[record++]);
+            uint64_t path_length;
+            if(!Utils::readVarint(std::string_view(content.data(),batch_end),record,path_length)
+             ||path_length>batch_end-record){
+                corrupt(log_file_path);
+            }
+            std::string path=content.substr(record,path_length);
+            record+=path_length;
+            switch(op){
+            case OP_STAGE:
+                if(batch_end-record<ObjectId::RAW_LENGTH)corrupt(log_file_path);
+                staging_map[path]=ObjectId::fromRaw(p+record);
+                record+=ObjectId::RAW_LENGTH;
+                break;
+            case OP_UNSTAGE:
+                staging_map.erase(path);
+                break;
+            case OP_REMOVE:
+                removed_files.insert(path);
+                break;
+            case OP_UNREMOVE:
+                removed_files.erase(path);
+                break;
+            case OP_CACHE:
+            case OP_CACHE_V1:{
+                // 旧版本的记录没有取stat的时间，当作racy的
+                size_t size=ObjectId::RAW_LENGTH+STAT_SIZE+(op==OP_CACHE?RECORDED_SIZE:0);
+                if(batch_end-record<size)corrupt(log_file_path);
+                CachedFile& cached=stat_cache[path];
+                cached.id=ObjectId::fromRaw(p+record);
+                cached.stat=readStat(p+record+ObjectId::RAW_LENGTH);
+                cached.recorded=op==OP_CACHE?static_cast<int64_t>(readBE(p+record+ObjectId::RAW_LENGTH+STAT_SIZE,8)):0;
+                record+=size;
+                break;
+            }
+            case OP_UNCACHE:
+                stat_cache.erase(path);
+                break;
+            case OP_CLEAR:
+                staging_map.clear();
+                removed_files.clear();
+                break;
+            default:
+                corrupt(log_file_path);
+            }
+            log_records++;
+        }
+        pos=batch_end+BATCH_CHECKSUM;
+    }
+    log_offset=pos;
 }
 
 static bool isBlankLine(const std::string& s){
@@ -31,12 +266,14 @@ void StagingArea::loadStagingMap(){
             std::string line=content.substr(line_start,pos-line_start);  
             
             if(!line.empty()){
-                size_t colon_pos=line.find(':');
+                size_t colon_pos=line.rfind(':');  // id里没有冒号，文件名里可能有
                 if(colon_pos!=std::string::npos){ 
                     std::string filename=line.substr(0,colon_pos);   
                     std::string blob_id=line.substr(colon_pos+1);    
 
-                    staging_map[filename]=blob_id;
+                    if(ObjectId::isValidHex(blob_id)){
+                        staging_map[filename]=ObjectId::fromHex(blob_id);
+                    }
                 }
             }
 
@@ -74,7 +311,7 @@ void StagingArea::loadRemovedFiles(){
     }
 }
 
-const std::map<std::string,std::string>& StagingArea::getStagingMap() const {
+const std::map<std::string,ObjectId>& StagingArea::getStagingMap() const {
     return staging_map;
 }
 
@@ -82,60 +319,198 @@ const std::set<std::string>& StagingArea::getRemovedFiles() const {
     return removed_files;
 }
 
-void StagingArea::addStagedFile(const std::string& filename,const std::string& blobId){
+void StagingArea::addStagedFile(const std::string& filename,const ObjectId& blobId){
     staging_map[filename]=blobId; 
+    journal(OP_STAGE,filename,blobId);
 }
 
 void StagingArea::removeStagedFile(const std::string& filename){
-    staging_map.erase(filename); 
+    if(staging_map.erase(filename)){
+        journal(OP_UNSTAGE,filename);
+    }
 }
 
 void StagingArea::addRemovedFile(const std::string& filename){
-    removed_files.insert(filename); 
+    if(removed_files.insert(filename).second){
+        journal(OP_REMOVE,filename);
+    }
 }
 
 void StagingArea::removeRemovedFile(const std::string& filename){
-    removed_files.erase(filename); 
+    if(removed_files.erase(filename)){
+        journal(OP_UNREMOVE,filename);
+    }
 }
 
-void StagingArea::save() const {
-    std::string staging_content;
-    for(const auto& entry : staging_map){
-        std::string name=entry.first;
-        std::string id=entry.second;
-        
-        if(name.empty()||id.empty()){continue;}
+void StagingArea::journal(Op op,const std::string& path,const ObjectId& id,const FileStat* stat){
+    pending.push_back(static_cast<char>(op));
+    Utils::appendVarint(pending,path.length());
+    pending+=path;
+    if(op==OP_STAGE){
+        pending.append(reinterpret_cast<const char*>(id.data()),ObjectId::RAW_LENGTH);
+    }
+    else if(op==OP_CACHE){
+        appendStat(pending,id,*stat);
+        appendBE(pending,static_cast<uint64_t>(stat->checked),8);
+    }
+    pending_records++;
+}
 
-        staging_content+=name;
-        staging_content+=":";
-        staging_content+=id;
-        staging_content+="\n";
+bool StagingArea::statFile(const std::string& path,FileStat& stat){
+    // 先取时间再stat：之后对文件的修改，修改时间都不会早于checked
+    stat.checked=now();
+    struct stat st;
+    if(::stat(path.c_str(),&st)!=0||!S_ISREG(st.st_mode)){
+        return false;
     }
-    Utils::writeContents(staging_file_path,staging_content);
+    stat.mtime=nanoseconds(st.st_mtim);
+    stat.ctime=nanoseconds(st.st_ctim);
+    stat.size=static_cast<uint64_t>(st.st_size);
+    stat.inode=static_cast<uint64_t>(st.st_ino);
+    return true;
+}
+
+ObjectId StagingArea::fileBlobId(const std::string& path){
+    FileStat stat;
+    if(!statFile(path,stat)){
+        if(stat_cache.erase(path)){
+            journal(OP_UNCACHE,path);
+        }
+        return ObjectId();
+    }
+    ObjectId id;
+    if(cachedBlobId(path,stat,id)){
+        return id;
+    }
+    id=Blob::generateIdFromFile(path);
+    recordBlobId(path,stat,id);
+    return id;
+}
 
-    std::string removed_content;
-    for (const auto& filename : removed_files){
-        std::string name=filename;
-        
-        if(name.empty()){continue;}
-        
-        removed_content+=name;
-        removed_content+="\n";
+bool StagingArea::cachedBlobId(const std::string& path,const FileStat& stat,ObjectId& id) const {
+    auto it=stat_cache.find(path);
+    // 修改时间早于算blob id前取stat的时间，之后再改内容修改时间一定会变，缓存可信；
+    // 否则是racy的（同一时刻算完哈希后又改了内容，stat可能看不出来），重新计算后再记一次
+    if(it!=stat_cache.end()&&it->second.stat==stat&&stat.mtime<it->second.recorded){
+        id=it->second.id;
+        return true;
+    }
+    return false;
+}
+
+void StagingArea::recordBlobId(const std::string& path,const FileStat& stat,const ObjectId& id){
+    CachedFile& cached=stat_cache[path];
+    cached.stat=stat;
+    cached.id=id;
+    cached.recorded=stat.checked;
+    journal(OP_CACHE,path,id,&stat);
+}
+
+void StagingArea::writeIndex() const {
+    std::set<std::string> paths;
+    for(const auto& entry:staging_map){
+        if(!entry.first.empty()&&!entry.second.isNull())paths.insert(entry.first);
+    }
+    for(const auto& name:removed_files){
+        if(!name.empty())paths.insert(name);
+    }
+    for(const auto& entry:stat_cache){
+        paths.insert(entry.first);
+    }
+
+    // 新的代数比日志里所有批次的都大；旧版本的批次在这个位置写的是写入时间，所以不小于当前时间
+    uint64_t next_generation=std::max(generation,static_cast<uint64_t>(now()))+1;
+    std::string content=INDEX_MAGIC;
+    appendBE(content,paths.size(),4);
+    appendBE(content,next_generation,8);
+    for(const auto& path:paths){
+        auto staged=staging_map.find(path);
+        auto cached=stat_cache.find(path);
+        bool is_staged=staged!=staging_map.end()&&!staged->second.isNull();
+        uint8_t flags=(is_staged?FLAG_STAGED:0)|(removed_files.count(path)?FLAG_REMOVED:0)
+                     |(cached!=stat_cache.end()?FLAG_CACHED:0);
+        content.push_back(static_cast<char>(flags));
+        Utils::appendVarint(content,path.length());
+        content+=path;
+        if(is_staged){
+            content.append(reinterpret_cast<const char*>(staged->second.data()),ObjectId::RAW_LENGTH);
+        }
+        if(cached!=stat_cache.end()){
+            // 带上条目自己的取stat时间，racy的条目读回来仍然是racy的
+            appendStat(content,cached->second.id,cached->second.stat);
+            appendBE(content,static_cast<uint64_t>(cached->second.recorded),8);
+        }
+    }
+
+    // 先写临时文件再rename，中途失败不会丢掉暂存区；rename之后才删日志，删之前中断时留下的批次代数较小，重放时跳过
+    std::string tmp_file=index_file_path+".tmp";
+    Utils::writeContents(tmp_file,content);
+    if(std::rename(tmp_file.c_str(),index_file_path.c_str())!=0){
+        throw std::invalid_argument("cannot write "+index_file_path);
+    }
+    generation=next_generation;
+    std::remove(log_file_path.c_str());
+    log_offset=0;
+    log_records=0;
+    log_damaged=false;
+    // 已经改写成索引，旧的两个文件不再需要
+    std::remove(staging_file_path.c_str());
+    std::remove(removed_file_path.c_str());
+}
+
+void StagingArea::save() const {
+    bool has_index=Utils::exists(index_file_path);
+    if(has_index&&pending_records==0&&!log_damaged){
+        return;
+    }
+    size_t entries=staging_map.size()+removed_files.size()+stat_cache.size();
+    if(!has_index||log_damaged||log_records+pending_records>std::max(COMPACT_THRESHOLD,entries)){
+        writeIndex();
+    }
+    else{
+        // 这次的改动作为一批追加到日志
+        std::string batch;
+        appendBE(batch,pending.size(),4);
+        appendBE(batch,generation,8);
+        batch+=pending;
+        appendBE(batch,checksum(batch.data()+4,batch.size()-4),4);
+        std::ofstream out(log_file_path,std::ios::binary|std::ios::app);
+        out.write(batch.data(),batch.size());
+        if(!out){
+            throw std::invalid_argument("cannot write "+log_file_path);
+        }
+        log_offset+=batch.size();
+        log_records+=pending_records;
+    }
+    pending.clear();
+    pending_records=0;
+}
+
+void StagingArea::saveStats() const {
+    if(pending_records>0){
+        save();
     }
-    Utils::writeContents(removed_file_path,removed_content); 
 }
 
 void StagingArea::clear(){
     staging_map.clear();    
     removed_files.clear();  
+    journal(OP_CLEAR,"");
     save();              
 }
 
 void StagingArea::reload(){
-    staging_map.clear();     
-    removed_files.clear();
-    loadStagingMap();     
-    loadRemovedFiles();
+    // 主文件没被改写（合并会换成新文件）、也没有没保存的改动时，只重放日志新增的部分
+    FileStat current;
+    if(pending_records==0&&statFile(index_file_path,current)&&current==index_stat){
+        FileStat log;
+        uint64_t log_size=statFile(log_file_path,log)?log.size:0;
+        if(log_size>=log_offset){
+            replayLog();
+            return;
+        }
+    }
+    load();
 }
 
 bool StagingArea::isStaged(const std::string& filename) const {
@@ -144,4 +519,4 @@ bool StagingArea::isStaged(const std::string& filename) const {
 
 bool StagingArea::isRemoved(const std::string& filename) const {
     return removed_files.count(filename)>0; 
-}
\ No newline at end of file
+}
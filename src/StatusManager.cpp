@@ -4,6 +4,7 @@
 #include "../include/FileOperationManager.h"
 #include "../include/Utils.h"
 #include "../include/Blob.h"
+#include "../include/DirectoryWalker.h"
 #include <iostream>
 #include <cctype>
 
@@ -30,7 +31,7 @@ std::set<std::string> StatusManager::getAllBranches(){
 
 std::map<std::string,std::string> StatusManager::getModifiedFiles(){
     std::map<std::string,std::string> modified_files;
-    std::string current_commit_id=commitManager->getCurrentCommitId();  
+    ObjectId current_commit_id=commitManager->getCurrentCommitId();  
     auto tracked_files=commitManager->getTrackedFiles(current_commit_id); 
     StagingArea& staging_area=core->getStagingArea();
     const auto& staging_map=staging_area.getStagingMap();    
@@ -47,31 +48,29 @@ std::map<std::string,std::string> StatusManager::getModifiedFiles(){
             continue;  
         }
 
-        if(Utils::exists(filename)){
-            std::string commit_blob_id=commitManager->getFileBlobId(filename,current_commit_id);
-            std::string current_content=Utils::readContentsAsString(filename);
-            std::string current_blob_id=Blob::generateId(current_content);
-
-            if(commit_blob_id!=current_blob_id){
-                modified_files[filename]="modified";
-            }
-        }
-        else{
+        // stat信息没变的文件直接用索引里缓存的blob id，不再读文件算哈希
+        ObjectId current_blob_id=staging_area.fileBlobId(filename);
+        if(current_blob_id.isNull()){
             modified_files[filename]="deleted";
-        }  
+        }
+        else if(current_blob_id!=tracked.second){
+            modified_files[filename]="modified";
+        }
     }
+    // 把重新算过的文件写回索引，下次status就不用再算
+    staging_area.saveStats();
     
     return modified_files;
 }
 
 std::set<std::string> StatusManager::getUntrackedFiles(){
     std::set<std::string> untracked_files;
-    std::string current_commit_id=commitManager->getCurrentCommitId();
+    ObjectId current_commit_id=commitManager->getCurrentCommitId();
     auto tracked_files=commitManager->getTrackedFiles(current_commit_id);
     StagingArea& staging_area=core->getStagingArea();
     const auto& staging_map=staging_area.getStagingMap();
 
-    auto working_files=Utils::plainFilenamesIn(".");
+    auto working_files=DirectoryWalker::listFiles(".");
     for(const auto& file:working_files){
 
         if(!tracked_files.count(file)&&!staging_map.count(file)){
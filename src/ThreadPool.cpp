@@ -0,0 +1,146 @@
+#include"../include/ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t threads) : running(0),stopping(false){
+    if(threads==0)threads=defaultThreads();
+    workers.reserve(threads);
+    for(size_t i=0;i<threads;i++){
+        workers.emplace_back(&ThreadPool::workerLoop,this);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping=true;
+    }
+    task_ready.notify_all();
+    for(auto& worker:workers){
+        worker.join();
+    }
+}
+
+size_t ThreadPool::defaultThreads(){
+    unsigned n=std::thread::hardware_concurrency();
+    return n==0?1:n;
+}
+
+void ThreadPool::workerLoop(){
+    while(true){
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task_ready.wait(lock,[this]{return stopping||!tasks.empty();});
+            if(tasks.empty())return;
+            task=std::move(tasks.front());
+            tasks.pop_front();
+            running++;
+        }
+        try{
+            task();
+        }catch(...){
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!error)error=std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+            if(tasks.empty()&&running==0){
+                all_done.notify_all();
+            }
+        }
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    task_ready.notify_one();
+}
+
+void ThreadPool::wait(){
+    std::unique_lock<std::mutex> lock(mutex);
+    all_done.wait(lock,[this]{return tasks.empty()&&running==0;});
+    if(error){
+        std::exception_ptr e=error;
+        error=nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+namespace {
+    // parallelFor里每个线程名下还没做的区间[begin,end)，自己从前面取，别的线程从后面偷
+    struct StealRange{
+        std::mutex mutex;
+        size_t begin=0;
+        size_t end=0;
+
+        bool takeFront(size_t grain,size_t& from,size_t& to){
+            std::lock_guard<std::mutex> lock(mutex);
+            if(begin>=end)return false;
+            from=begin;
+            to=end-begin>grain?begin+grain:end;
+            begin=to;
+            return true;
+        }
+
+        //偷走后一半，剩得不多时整段拿走
+        bool stealBack(size_t grain,size_t& from,size_t& to){
+            std::lock_guard<std::mutex> lock(mutex);
+            if(begin>=end)return false;
+            size_t half=end-begin>grain?(end-begin)/2:end-begin;
+            from=end-half;
+            to=end;
+            end=from;
+            return true;
+        }
+
+        size_t remaining(){
+            std::lock_guard<std::mutex> lock(mutex);
+            return end-begin;
+        }
+    };
+}
+
+void ThreadPool::parallelFor(size_t count,const std::function<void(size_t,size_t)>& body){
+    if(count==0)return;
+    // 每个线程先分到连续的一段，按grain从前往后做；做完了就找剩得最多的线程偷走它的后一半
+    // 对象大小差别很大（比如fsck里的大文件和小commit）时，先做完的线程不会闲着
+    size_t n=workers.size()<count?workers.size():count;
+    size_t grain=count/(n*8);
+    if(grain==0)grain=1;
+    std::vector<StealRange> ranges(n);
+    for(size_t w=0;w<n;w++){
+        ranges[w].begin=count*w/n;
+        ranges[w].end=count*(w+1)/n;
+    }
+
+    for(size_t w=0;w<n;w++){
+        submit([&ranges,&body,n,grain,w]{
+            StealRange& own=ranges[w];
+            size_t from,to;
+            while(true){
+                if(own.takeFront(grain,from,to)){
+                    body(from,to);
+                    continue;
+                }
+                size_t victim=n,most=0;
+                for(size_t v=0;v<n;v++){
+                    size_t left=v==w?0:ranges[v].remaining();
+                    if(left>most){
+                        most=left;
+                        victim=v;
+                    }
+                }
+                if(victim==n)return;
+                if(!ranges[victim].stealBack(grain,from,to))continue;
+                // 偷来的区间先挂到自己名下，别的线程还能再从这里偷
+                std::lock_guard<std::mutex> lock(own.mutex);
+                own.begin=from;
+                own.end=to;
+            }
+        });
+    }
+    wait();
+}
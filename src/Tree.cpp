@@ -0,0 +1,231 @@
+#include"../include/Tree.h"
+#include"../include/Blob.h"
+#include"../include/GitliteException.h"
+#include"../include/Utils.h"
+#include<algorithm>
+#include<cstring>
+
+const char Tree::MAGIC[4]={'\0','G','L','T'};
+
+namespace {
+    using Changes=std::map<std::string,ObjectId>;
+
+    //对[begin,end)中的改动更新base这个目录，路径从offset开始是相对这个目录的部分
+    //目录变空时返回空ID（根目录除外）
+    ObjectId updateDir(const ObjectStore& store,const ObjectId& base,Changes::const_iterator begin,Changes::const_iterator end,size_t offset,bool root){
+        std::map<std::string,Tree::Entry> entries;
+        if(!base.isNull()){
+            for(auto& entry:Tree::load(store,base)){
+                std::string name=entry.name;
+                entries.emplace(std::move(name),std::move(entry));
+            }
+        }
+
+        // 改动按完整路径排序，同一个子目录下的路径是连续的一段
+        for(auto it=begin;it!=end;){
+            const std::string& path=it->first;
+            size_t slash=path.find('/',offset);
+            if(slash==std::string::npos){
+                std::string name=path.substr(offset);
+                if(it->second.isNull()){
+                    entries.erase(name);
+                }
+                else{
+                    entries[name]={name,OBJ_BLOB,it->second};
+                }
+                ++it;
+                continue;
+            }
+
+            std::string name=path.substr(offset,slash-offset);
+            auto group_end=it;
+            while(group_end!=end&&group_end->first.compare(offset,slash+1-offset,path,offset,slash+1-offset)==0){
+                ++group_end;
+            }
+            auto existing=entries.find(name);
+            ObjectId sub_base=existing!=entries.end()&&existing->second.type==OBJ_TREE?existing->second.id:ObjectId();
+            ObjectId sub=updateDir(store,sub_base,it,group_end,slash+1,false);
+            if(sub.isNull()){
+                entries.erase(name);
+            }
+            else{
+                entries[name]={name,OBJ_TREE,sub};
+            }
+            it=group_end;
+        }
+
+        if(entries.empty()&&!root){
+            return ObjectId();
+        }
+        std::vector<Tree::Entry> sorted;
+        sorted.reserve(entries.size());
+        for(auto& entry:entries){
+            sorted.push_back(std::move(entry.second));
+        }
+        return Tree::write(store,sorted);
+    }
+
+    void flattenInto(const ObjectStore& store,const ObjectId& id,const std::string& prefix,std::vector<BlobTable::Entry>& out){
+        for(const auto& entry:Tree::load(store,id)){
+            if(entry.type==OBJ_TREE){
+                flattenInto(store,entry.id,prefix+entry.name+"/",out);
+            }
+            else{
+                out.emplace_back(prefix+entry.name,entry.id);
+            }
+        }
+    }
+
+    void diffInto(const ObjectStore& store,const ObjectId& oldId,const ObjectId& newId,const std::string& prefix,
+                  const std::function<void(const std::string&,const ObjectId&,const ObjectId&)>& visit){
+        if(oldId==newId)return;
+        std::vector<Tree::Entry> old_entries,new_entries;
+        if(!oldId.isNull())old_entries=Tree::load(store,oldId);
+        if(!newId.isNull())new_entries=Tree::load(store,newId);
+        // 两边都按名字排序，像归并一样并排走；同名的文件和目录分开比较
+        size_t i=0,j=0;
+        while(i<old_entries.size()||j<new_entries.size()){
+            const Tree::Entry* o=nullptr;
+            const Tree::Entry* n=nullptr;
+            if(j==new_entries.size()||(i<old_entries.size()&&old_entries[i].name<new_entries[j].name)){
+                o=&old_entries[i++];
+            }
+            else if(i==old_entries.size()||new_entries[j].name<old_entries[i].name){
+                n=&new_entries[j++];
+            }
+            else{
+                o=&old_entries[i++];
+                n=&new_entries[j++];
+            }
+            const std::string& name=o?o->name:n->name;
+            ObjectId old_blob=o&&o->type!=OBJ_TREE?o->id:ObjectId();
+            ObjectId new_blob=n&&n->type!=OBJ_TREE?n->id:ObjectId();
+            ObjectId old_tree=o&&o->type==OBJ_TREE?o->id:ObjectId();
+            ObjectId new_tree=n&&n->type==OBJ_TREE?n->id:ObjectId();
+            if(old_blob!=new_blob){
+                visit(prefix+name,old_blob,new_blob);
+            }
+            if(old_tree!=new_tree){
+                diffInto(store,old_tree,new_tree,prefix+name+"/",visit);
+            }
+        }
+    }
+}
+
+bool Tree::isTreeData(std::string_view data){
+    return data.size()>sizeof(MAGIC)&&std::memcmp(data.data(),MAGIC,sizeof(MAGIC))==0;
+}
+
+std::string Tree::serialize(const std::vector<Entry>& entries){
+    std::string out(MAGIC,sizeof(MAGIC));
+    out.push_back(static_cast<char>(VERSION));
+    Utils::appendVarint(out,entries.size());
+    for(const auto& entry:entries){
+        out.push_back(static_cast<char>(entry.type));
+        Utils::appendVarint(out,entry.name.size());
+        out+=entry.name;
+        out.append(reinterpret_cast<const char*>(entry.id.data()),ObjectId::RAW_LENGTH);
+    }
+    return out;
+}
+
+std::vector<Tree::Entry> Tree::parse(std::string_view data){
+    if(!isTreeData(data)||static_cast<uint8_t>(data[sizeof(MAGIC)])!=VERSION){
+        throw GitliteException("Not a tree object");
+    }
+    size_t pos=sizeof(MAGIC)+1;
+    uint64_t count;
+    if(!Utils::readVarint(data,pos,count)||count>data.size()-pos){
+        throw GitliteException("Corrupt tree object");
+    }
+    std::vector<Entry> entries;
+    entries.reserve(count);
+    for(uint64_t i=0;i<count;i++){
+        uint64_t length;
+        if(pos>=data.size()){
+            throw GitliteException("Corrupt tree object");
+        }
+        ObjectType type=static_cast<ObjectType>(data[pos++]);
+        if((type!=OBJ_BLOB&&type!=OBJ_TREE)
+         ||!Utils::readVarint(data,pos,length)
+         ||length>data.size()-pos
+         ||data.size()-pos-length<ObjectId::RAW_LENGTH){
+            throw GitliteException("Corrupt tree object");
+        }
+        std::string name(data.substr(pos,length));
+        pos+=length;
+        entries.push_back({std::move(name),type,ObjectId::fromRaw(reinterpret_cast<const uint8_t*>(data.data()+pos))});
+        pos+=ObjectId::RAW_LENGTH;
+    }
+    return entries;
+}
+
+std::vector<Tree::Entry> Tree::load(const ObjectStore& store,const ObjectId& id){
+    return parse(store.read(id));
+}
+
+ObjectId Tree::write(const ObjectStore& store,const std::vector<Entry>& entries){
+    std::string data=serialize(entries);
+    ObjectId id=Blob::generateId(data);
+    if(!store.exists(id)){
+        store.write(id,data,OBJ_TREE);
+    }
+    return id;
+}
+
+ObjectId Tree::update(const ObjectStore& store,const ObjectId& base,const std::map<std::string,ObjectId>& changes){
+    return updateDir(store,base,changes.begin(),changes.end(),0,true);
+}
+
+ObjectId Tree::lookup(const ObjectStore& store,const ObjectId& root,std::string_view path){
+    ObjectId dir=root;
+    while(!dir.isNull()){
+        size_t slash=path.find('/');
+        std::string_view name=path.substr(0,slash);
+        auto entries=load(store,dir);
+        auto it=std::lower_bound(entries.begin(),entries.end(),name,[](const Entry& entry,std::string_view key){
+            return std::string_view(entry.name)<key;
+        });
+        if(it==entries.end()||it->name!=name){
+            return ObjectId();
+        }
+        if(slash==std::string_view::npos){
+            return it->type==OBJ_BLOB?it->id:ObjectId();
+        }
+        if(it->type!=OBJ_TREE){
+            return ObjectId();
+        }
+        dir=it->id;
+        path.remove_prefix(slash+1);
+    }
+    return ObjectId();
+}
+
+void Tree::diff(const ObjectStore& store,const ObjectId& oldRoot,const ObjectId& newRoot,
+                const std::function<void(const std::string&,const ObjectId&,const ObjectId&)>& visit){
+    diffInto(store,oldRoot,newRoot,"",visit);
+}
+
+BlobTable Tree::flatten(const ObjectStore& store,const ObjectId& id){
+    std::vector<BlobTable::Entry> files;
+    flattenInto(store,id,"",files);
+    // 目录按名字排序和完整路径的字典序不完全一致（比如"a-b"和"a/c"），交给BlobTable重排
+    return BlobTable(std::move(files));
+}
+
+void Tree::copy(const ObjectStore& from,const ObjectStore& to,const ObjectId& id){
+    if(to.exists(id)){
+        return;
+    }
+    std::string data=from.read(id);
+    // 先复制子对象再写这个tree，保持"有tree就有它下面的对象"
+    for(const auto& entry:parse(data)){
+        if(entry.type==OBJ_TREE){
+            copy(from,to,entry.id);
+        }
+        else{
+            Blob::copyObject(from,to,entry.id);
+        }
+    }
+    to.write(id,data,OBJ_TREE);
+}
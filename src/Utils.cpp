@@ -1,9 +1,12 @@
 #include "../include/Utils.h"
+#include "../include/Sha1Kernel.h"
+#include "../include/MappedFile.h"
 #include <cstdlib>
 #include <iostream>
 #include <sys/stat.h>
 #include <cstring>
 #include <dirent.h>
+#include <unistd.h>
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
@@ -18,116 +21,126 @@
 
 namespace SHA1 {
     void SHA::reset() {
-        A = 0x67452301;
-        B = 0xEFCDAB89;
-        C = 0x98BADCFE;
-        D = 0x10325476;
-        E = 0xC3D2E1F0;
+        state[0] = 0x67452301;
+        state[1] = 0xEFCDAB89;
+        state[2] = 0x98BADCFE;
+        state[3] = 0x10325476;
+        state[4] = 0xC3D2E1F0;
+        bufferLength = 0;
+        totalLength = 0;
     }
-    
-    std::string SHA::padding(std::string message) {
-        int originalLength = message.length();
-        int newLength = ((originalLength + 8) + 63) / 64 * 64;
-        std::string newMessage = message;
-        newMessage.resize(newLength, 0);
-        newMessage[originalLength] = static_cast<char>(0x80);
-        int bitLength = originalLength * 8;
-        for(int i = newLength - 1; i >= newLength - 8; i--) {
-            newMessage[i] = bitLength % 256;
-            bitLength /= 256;
-        }
-        return newMessage;
-    }
-    
-    SHA::WORD SHA::charToWord(char ch) {
-        return (BYTE)ch;
+
+    SHA::SHA() {
+        reset();
     }
-    
-    SHA::WORD SHA::shiftLeft(WORD x, int n) {
-        return (x >> (32 - n)) | (x << n);
+
+    // 压缩函数由SHA1Kernel在启动时按CPU特性选择
+    void SHA::processBlocks(const BYTE* blocks, size_t count) {
+        static const CompressFunc compress = selectCompress();
+        compress(state, blocks, count);
     }
-    
-    void SHA::getWord(std::string& message, int index) {
-        for(int i = 0; i < 16; i++) {
-            Word[i] = (charToWord(message[index + 4*i]) << 24) + 
-                     (charToWord(message[index + 4*i + 1]) << 16) + 
-                     (charToWord(message[index + 4*i + 2]) << 8) + 
-                     charToWord(message[index + 4*i + 3]);
+
+    void SHA::update(const void* data, size_t length) {
+        const BYTE* bytes = static_cast<const BYTE*>(data);
+        totalLength += length;
+
+        // 先补齐上次剩下的半个块
+        if(bufferLength > 0) {
+            size_t take = std::min(length, sizeof(buffer) - bufferLength);
+            std::memcpy(buffer + bufferLength, bytes, take);
+            bufferLength += take;
+            bytes += take;
+            length -= take;
+            if(bufferLength < sizeof(buffer)) {
+                return;
+            }
+            processBlocks(buffer, 1);
+            bufferLength = 0;
         }
-        for(int i = 16; i < 80; i++) {
-            Word[i] = shiftLeft(Word[i-3] ^ Word[i-8] ^ Word[i-14] ^ Word[i-16], 1);
+
+        // 整块直接从调用方的内存处理，不做拷贝
+        size_t whole = length / sizeof(buffer);
+        if(whole > 0) {
+            processBlocks(bytes, whole);
+            bytes += whole * sizeof(buffer);
+            length -= whole * sizeof(buffer);
+        }
+
+        if(length > 0) {
+            std::memcpy(buffer, bytes, length);
+            bufferLength = length;
         }
     }
-    
-    SHA::SHA() : Word(80) {
-        reset();
+
+    void SHA::update(const std::string& data) {
+        update(data.data(), data.size());
     }
-    
-    SHA::WORD SHA::kt(int t) {
-        if (t < 20)
-            return 0x5a827999;
-        else if (t < 40)
-            return 0x6ed9eba1;
-        else if (t < 60)
-            return 0x8f1bbcdc;
-        else
-            return 0xca62c1d6;
+
+    void SHA::finalize(uint8_t digest[20]) {
+        uint64_t bitLength = totalLength * 8;
+
+        // 填充：0x80，若干0，最后8字节为大端的比特长度
+        buffer[bufferLength++] = 0x80;
+        if(bufferLength > 56) {
+            std::memset(buffer + bufferLength, 0, sizeof(buffer) - bufferLength);
+            processBlocks(buffer, 1);
+            bufferLength = 0;
+        }
+        std::memset(buffer + bufferLength, 0, 56 - bufferLength);
+        for(int i = 63; i >= 56; i--) {
+            buffer[i] = static_cast<BYTE>(bitLength & 0xff);
+            bitLength >>= 8;
+        }
+        processBlocks(buffer, 1);
+
+        for(int i = 0; i < 5; i++) {
+            digest[4 * i] = static_cast<BYTE>(state[i] >> 24);
+            digest[4 * i + 1] = static_cast<BYTE>(state[i] >> 16);
+            digest[4 * i + 2] = static_cast<BYTE>(state[i] >> 8);
+            digest[4 * i + 3] = static_cast<BYTE>(state[i]);
+        }
+        reset();
     }
-    
-    SHA::WORD SHA::ft(int t, WORD B, WORD C, WORD D) {
-        if (t < 20)
-            return (B & C) | ((~B) & D);
-        else if (t < 40)
-            return B ^ C ^ D;
-        else if (t < 60)
-            return (B & C) | (B & D) | (C & D);
-        else
-            return B ^ C ^ D;
+
+    std::string SHA::finalize() {
+        static const char hex[] = "0123456789abcdef";
+        BYTE raw[20];
+        finalize(raw);
+        std::string digest(40, '0');
+        for(int i = 0; i < 20; i++) {
+            digest[2 * i] = hex[raw[i] >> 4];
+            digest[2 * i + 1] = hex[raw[i] & 0xf];
+        }
+        return digest;
     }
     
-    std::string SHA::sha(std::string message) {
+    std::string SHA::sha(const std::string& message) {
         reset();
-        message = padding(message);
-        int byteLength = message.length();
-        for(int i = 0; i < byteLength; i += 64) {
-            getWord(message, i);
-            WORD a = A, b = B, c = C, d = D, e = E;
-            for(int j = 0; j < 80; j++) {
-                WORD temp = shiftLeft(a, 5) + ft(j, b, c, d) + e + kt(j) + Word[j];
-                e = d;
-                d = c;
-                c = shiftLeft(b, 30);
-                b = a;
-                a = temp;
-            }
-            A += a;
-            B += b;
-            C += c;
-            D += d;
-            E += e;
-        }
-        std::stringstream ss;
-        ss << std::hex;
-        ss << std::setw(8) << std::setfill('0') << A;
-        ss << std::setw(8) << std::setfill('0') << B;
-        ss << std::setw(8) << std::setfill('0') << C;
-        ss << std::setw(8) << std::setfill('0') << D;
-        ss << std::setw(8) << std::setfill('0') << E;
-        return ss.str();
+        update(message);
+        return finalize();
     }
     
     SHA sha;
     
-    std::string sha1(std::string message) {
-        return sha.sha(message);
+    std::string sha1(const std::string& message) {
+        SHA hasher;
+        return hasher.sha(message);
     }
     
-    std::string sha1(std::string s1, std::string s2) {
-        return sha1(s1 + s2);
+    std::string sha1(const std::string& s1, const std::string& s2) {
+        SHA hasher;
+        hasher.update(s1);
+        hasher.update(s2);
+        return hasher.finalize();
     }
     
-    std::string sha1(std::string s1, std::string s2, std::string s3, std::string s4) {
-        return sha1(s1 + s2 + s3 + s4);
+    std::string sha1(const std::string& s1, const std::string& s2, const std::string& s3, const std::string& s4) {
+        SHA hasher;
+        hasher.update(s1);
+        hasher.update(s2);
+        hasher.update(s3);
+        hasher.update(s4);
+        return hasher.finalize();
     }
 }
 
@@ -149,8 +162,24 @@ std::string Utils::sha1(const std::string& s1, const std::string& s2,
 
 /** Returns the SHA-1 hash of the concatenation of the strings in VALS. */
 std::string Utils::sha1(const std::vector<unsigned char>& data) {
-    std::string str(data.begin(), data.end());
-    return SHA1::sha1(str);
+    SHA1::SHA hasher;
+    hasher.update(data.data(), data.size());
+    return hasher.finalize();
+}
+
+/** Returns the SHA-1 hash of the contents of FILE, read in fixed-size
+ *  chunks so that memory use does not depend on the file size.  FILE must
+ *  be a normal file.  Throws IllegalArgumentException in case of problems. */
+std::string Utils::sha1File(const std::string& filepath) {
+    if (!isFile(filepath)) {
+        throw std::invalid_argument("must be a normal file");
+    }
+
+    // Hash straight out of the mapping; small files are read in one go.
+    MappedFile file(filepath, MappedFile::SEQUENTIAL);
+    SHA1::SHA hasher;
+    hasher.update(file.data(), file.size());
+    return hasher.finalize();
 }
 
 /* FILE DELETION */
@@ -174,6 +203,26 @@ bool Utils::restrictedDelete(const std::string& filepath) {
     return false;
 }
 
+/** Deletes the working-tree file FILEPATH (a path relative to the
+ *  working directory, possibly in a subdirectory), then removes the
+ *  parent directories it leaves empty.  Returns true if the file was
+ *  deleted. */
+bool Utils::removeWorkingFile(const std::string& filepath) {
+    if (remove(filepath.c_str()) != 0) {
+        return false;
+    }
+    // 子目录里的文件删掉后，逐级删除变空的父目录；rmdir遇到非空目录会失败，就此停下
+    std::string dir = filepath;
+    size_t pos;
+    while ((pos = dir.find_last_of('/')) != std::string::npos && pos > 0) {
+        dir.erase(pos);
+        if (rmdir(dir.c_str()) != 0) {
+            break;
+        }
+    }
+    return true;
+}
+
  /* READING AND WRITING FILE CONTENTS */
 /** Return the entire contents of FILE as a byte array.  FILE must
  *  be a normal file.  Throws IllegalArgumentException
@@ -202,8 +251,21 @@ std::vector<unsigned char> Utils::readContents(const std::string& filepath) {
  *  be a normal file.  Throws IllegalArgumentException
  *  in case of problems. */
 std::string Utils::readContentsAsString(const std::string& filepath) {
-    auto contents = readContents(filepath);
-    return std::string(contents.begin(), contents.end());
+    if (!isFile(filepath)) {
+        throw std::invalid_argument("must be a normal file");
+    }
+
+    std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        throw std::invalid_argument("cannot open file");
+    }
+
+    // Read straight into the string instead of copying through a vector.
+    std::string contents(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(&contents[0], contents.size());
+    contents.resize(static_cast<size_t>(file.gcount()));
+    return contents;
 }
 
 /** Write the result of concatenating the bytes in CONTENTS to FILE,
@@ -265,6 +327,33 @@ std::vector<std::string> Utils::plainFilenamesIn(const std::string& dirPath) {
     return files;
 }
 
+/** Returns a list of the names of all subdirectories of the directory DIR
+ *  (excluding "." and ".."), in order as C++ Strings.  Returns an empty
+ *  list if DIR does not denote a directory. */
+std::vector<std::string> Utils::subdirectoriesIn(const std::string& dirPath) {
+    std::vector<std::string> dirs;
+
+    DIR* dir = opendir(dirPath.c_str());
+    if (dir == nullptr) {
+        return dirs;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        if (entry->d_type == DT_DIR) {
+            dirs.push_back(name);
+        }
+    }
+
+    closedir(dir);
+    std::sort(dirs.begin(), dirs.end());
+    return dirs;
+}
+
 /* OTHER FILE UTILITIES */
 
 /** Return the concatenation of FIRST and SECOND into a File path,
@@ -288,6 +377,34 @@ std::vector<unsigned char> Utils::serialize(const std::string& obj) {
     return std::vector<unsigned char>(obj.begin(), obj.end());
 }
 
+/** Appends VALUE to OUT as a little-endian base-128 varint: seven bits
+ *  per byte, with the high bit set on every byte except the last. */
+void Utils::appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/** Reads a varint written by appendVarint from IN starting at POS and
+ *  advances POS past it.  Returns false if the input is truncated or the
+ *  value does not fit in 64 bits. */
+bool Utils::readVarint(std::string_view in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size()) {
+            return false;
+        }
+        uint8_t b = static_cast<uint8_t>(in[pos++]);
+        value |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /** Print a message composed from MSG and ARGS as for the String.format
  *  method, followed by a newline. */
 void Utils::message(const std::string& msg) {